@@ -7,6 +7,19 @@
 
 #include "alignment.h"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <numeric>
+
+#include "../utils/binaryio.h"
+#include "../utils/inputstream.h"
+#include "../utils/mappedfile.h"
+#include "../utils/outputstream.h"
+
 using namespace std;
 using namespace cmaple;
 
@@ -45,6 +58,14 @@ void cmaple::Alignment::read(std::istream& aln_stream,
                              const std::string& n_ref_seq,
                              const InputType format,
                              const cmaple::SeqRegion::SeqType seqtype) {
+  readStream(aln_stream, n_ref_seq, format, seqtype, "");
+}
+
+void cmaple::Alignment::readStream(std::istream& aln_stream,
+                                   const std::string& n_ref_seq,
+                                   const InputType format,
+                                   const cmaple::SeqRegion::SeqType seqtype,
+                                   const std::string& aln_filename) {
   if (cmaple::verbose_mode >= cmaple::VB_MED) {
     std::cout << "Reading an alignment" << std::endl;
   }
@@ -77,16 +98,30 @@ void cmaple::Alignment::read(std::istream& aln_stream,
   // Read the input alignment
   try {
     // in FASTA or PHYLIP format
-    if (aln_format != IN_MAPLE) {
+    if (aln_format != IN_MAPLE && aln_format != IN_BINARY) {
       readFastaOrPhylip(aln_stream, n_ref_seq);
-      // in MAPLE format
+      // in MAPLE or binary format
     } else {
       if (n_ref_seq.length() && cmaple::verbose_mode > cmaple::VB_QUIET) {
         outWarning(
             "Ignore the input reference as it must be already "
-            "specified in the MAPLE format");
+            "specified in the MAPLE/binary format");
+      }
+      if (aln_format == IN_BINARY) {
+        if (aln_filename.length()) {
+          const MappedFile aln_file(aln_filename);
+          readBinary(aln_file.data(), aln_file.data() + aln_file.size());
+        } else {
+          const std::string content((std::istreambuf_iterator<char>(aln_stream)),
+                                    std::istreambuf_iterator<char>());
+          readBinary(content.data(), content.data() + content.size());
+          resetStream(aln_stream);
+        }
+      } else if (aln_filename.length()) {
+        readMapleMapped(aln_filename);
+      } else {
+        readMaple(aln_stream);
       }
-      readMaple(aln_stream);
     }
 
     // sort sequences by their distances to the reference sequence
@@ -113,8 +148,8 @@ void cmaple::Alignment::read(const std::string& aln_filename,
   }
   assert(aln_filename.length() > 0);
 
-  // Create a stream from the input alignment
-  ifstream aln_stream;
+  // Create a stream from the input alignment (decompressed if needed)
+  InputFileStream aln_stream;
   try {
     aln_stream.exceptions(ios::failbit | ios::badbit);
     aln_stream.open(aln_filename);
@@ -123,15 +158,18 @@ void cmaple::Alignment::read(const std::string& aln_filename,
     throw ios::failure(err_msg + aln_filename);
   }
 
-  // Initialize an alignment instance from the input stream
-  read(aln_stream, n_ref_seq, format, seqtype);
+  // Initialize an alignment instance from the input stream (or the mapped
+  // file if it is not compressed)
+  readStream(aln_stream, n_ref_seq, format, seqtype,
+             aln_stream.isCompressed() ? "" : aln_filename);
 
   // close aln_stream
   aln_stream.close();
 }
 
 void cmaple::Alignment::write(std::ostream& aln_stream,
-                              const InputType& format) {
+                              const InputType& format,
+                              const bool compress) {
   assert(data.size() > 0);
   assert(format != IN_AUTO && format != IN_UNKNOWN);
     
@@ -142,13 +180,16 @@ void cmaple::Alignment::write(std::ostream& aln_stream,
 
   switch (format) {
     case IN_MAPLE:
-      writeMAPLE(aln_stream);
+      writeMAPLE(aln_stream, compress);
+      break;
+    case IN_BINARY:
+      writeBinary(aln_stream, compress);
       break;
     case IN_FASTA:
-      writeFASTA(aln_stream);
+      writeFASTA(aln_stream, compress);
       break;
     case IN_PHYLIP:
-      writePHYLIP(aln_stream);
+      writePHYLIP(aln_stream, compress);
       break;
     case IN_AUTO:
     case IN_UNKNOWN:
@@ -178,11 +219,16 @@ void cmaple::Alignment::write(const std::string& aln_filename,
         " already exists. Please set overwrite = true to overwrite it.");
   }
 
-  // Open a stream to write the output
-  std::ofstream aln_stream = ofstream(aln_filename);
+  // Open a stream to write the output (compressed if the filename ends with
+  // ".gz")
+  const bool compress = isGzipFilename(aln_filename);
+  std::ofstream aln_stream =
+      ofstream(aln_filename, format == IN_BINARY || compress
+                                 ? ios::out | ios::binary
+                                 : ios::out);
 
   // Write alignment to the stream
-  write(aln_stream, format);
+  write(aln_stream, format, compress);
 
   // Close the stream
   aln_stream.close();
@@ -212,6 +258,537 @@ auto cmaple::operator>>(std::istream& in_stream,
   return in_stream;
 }
 
+namespace {
+/**
+ Number of distinct characters that may appear in a sequence after
+ processSeq(): 'A'-'Z', '0'-'9', '-', '?', '.', '*', '~'
+ */
+constexpr size_t NUM_SEQ_CHARS = 41;
+
+/**
+ Get the index of a character of a processed sequence in [0, NUM_SEQ_CHARS)
+ */
+inline size_t getCharIndex(const char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return static_cast<size_t>(c - 'A');
+  }
+  if (c >= '0' && c <= '9') {
+    return 26 + static_cast<size_t>(c - '0');
+  }
+  switch (c) {
+    case '-':
+      return 36;
+    case '?':
+      return 37;
+    case '.':
+      return 38;
+    case '*':
+      return 39;
+    case '~':
+      return 40;
+    default:
+      throw std::invalid_argument(std::string("Invalid character '") + c +
+                                  "' in the sequences!");
+  }
+}
+
+/**
+ Get the character of an index (the inverse of getCharIndex())
+ */
+inline char getIndexChar(const size_t index) {
+  static constexpr char chars[NUM_SEQ_CHARS + 1] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-?.*~";
+  return chars[index];
+}
+
+/**
+ Get the indexes of the characters in ascending (ASCII) order, i.e., the order
+ in which generateRef() used to browse them
+ */
+const std::array<size_t, NUM_SEQ_CHARS>& getSortedCharIndexes() {
+  static const std::array<size_t, NUM_SEQ_CHARS> sorted_indexes = [] {
+    std::array<size_t, NUM_SEQ_CHARS> indexes;
+    for (size_t i = 0; i < NUM_SEQ_CHARS; ++i) {
+      indexes[i] = i;
+    }
+    std::sort(indexes.begin(), indexes.end(),
+              [](const size_t a, const size_t b) {
+                return getIndexChar(a) < getIndexChar(b);
+              });
+    return indexes;
+  }();
+  return sorted_indexes;
+}
+
+/**
+ Get the threshold from which a (non-gap) character is picked as the
+ reference at a site
+ */
+inline cmaple::PositionType getRefThreshold(const size_t num_seqs) {
+  // generateRef() used to only check the threshold after counting a
+  // character, hence the max
+  return std::max(
+      static_cast<cmaple::PositionType>(static_cast<double>(num_seqs) * 0.5),
+      static_cast<cmaple::PositionType>(1));
+}
+
+/**
+ Pick the reference character of a site from the numbers of times each
+ character appears at that site (NUM_SEQ_CHARS entries): the non-gap
+ character that appears in at least threshold sequences, or else the most
+ popular non-gap character, or else default_char.
+ Return '\0' if several characters reach the threshold: the one that reaches
+ it first in the sequences wins, which the counts cannot tell.
+ */
+char pickRefChar(const cmaple::PositionType* const site_counts,
+                 const cmaple::PositionType threshold,
+                 const char default_char) {
+  const size_t gap_index = getCharIndex('-');
+  char ref_char = default_char;
+  cmaple::PositionType num_reached = 0;
+  size_t max_index = gap_index;
+  for (const size_t index : getSortedCharIndexes()) {
+    if (index == gap_index) {
+      continue;
+    }
+    if (site_counts[index] >= threshold) {
+      ++num_reached;
+      ref_char = getIndexChar(index);
+    }
+    if (site_counts[index] &&
+        (max_index == gap_index ||
+         site_counts[index] > site_counts[max_index])) {
+      max_index = index;
+    }
+  }
+
+  if (num_reached > 1) {
+    return '\0';
+  }
+  // if no character reaches the threshold, pick the most popular one
+  if (!num_reached && max_index != gap_index) {
+    ref_char = getIndexChar(max_index);
+  }
+  return ref_char;
+}
+
+/**
+ Get the line starting at current and move current to the next line; lines
+ may end with "\n", "\r\n", or "\r" (as in safeGetline())
+ */
+inline std::string_view getNextLine(const char*& current,
+                                    const char* const end) {
+  const char* line_end = current;
+  while (line_end < end && *line_end != '\n' && *line_end != '\r') {
+    ++line_end;
+  }
+  const std::string_view line(
+      current, static_cast<std::string_view::size_type>(line_end - current));
+
+  // skip the line ending
+  current = line_end;
+  if (current < end) {
+    if (*current == '\r' && current + 1 < end && current[1] == '\n') {
+      ++current;
+    }
+    ++current;
+  }
+  return line;
+}
+
+/**
+ Count the lines between begin and end (see getNextLine())
+ */
+cmaple::PositionType countLines(const char* begin, const char* const end) {
+  cmaple::PositionType num_lines = 0;
+  for (; begin < end; ++begin) {
+    if (*begin == '\n' ||
+        (*begin == '\r' && (begin + 1 == end || begin[1] != '\n'))) {
+      ++num_lines;
+    }
+  }
+  return num_lines;
+}
+
+/**
+ Find the start of the next record (a '>' at the start of a line) from
+ current; return end if there is none
+ */
+const char* findNextRecord(const char* current, const char* const end) {
+  while (current < end) {
+    current = static_cast<const char*>(
+        memchr(current, '>', static_cast<size_t>(end - current)));
+    if (!current) {
+      return end;
+    }
+    if (current[-1] == '\n' || current[-1] == '\r') {
+      return current;
+    }
+    ++current;
+  }
+  return end;
+}
+
+/**
+ Magic bytes and version of the binary alignment format
+ */
+constexpr char BINARY_MAGIC[8] = {'C', 'M', 'A', 'P', 'L', 'E', 'B', '\0'};
+constexpr uint32_t BINARY_VERSION = 1;
+
+/**
+ Get the number of bits needed to store values in [0, num_values)
+ */
+inline unsigned getNumBits(const size_t num_values) {
+  unsigned num_bits = 1;
+  while ((size_t{1} << num_bits) < num_values) {
+    ++num_bits;
+  }
+  return num_bits;
+}
+
+/**
+ Append values of a fixed number of bits, packed (least significant first)
+ */
+class BitPacker {
+ public:
+  BitPacker(std::string& out, const unsigned num_bits)
+      : out_(out), num_bits_(num_bits) {}
+
+  void put(const uint32_t value) {
+    buffer_ |= static_cast<uint64_t>(value) << num_buffered_;
+    for (num_buffered_ += num_bits_; num_buffered_ >= 8; num_buffered_ -= 8) {
+      out_.push_back(static_cast<char>(buffer_ & 0xFF));
+      buffer_ >>= 8;
+    }
+  }
+
+  /**
+   Write the last (incomplete) byte
+   */
+  void flush() {
+    if (num_buffered_) {
+      out_.push_back(static_cast<char>(buffer_ & 0xFF));
+    }
+    buffer_ = 0;
+    num_buffered_ = 0;
+  }
+
+ private:
+  std::string& out_;
+  const unsigned num_bits_;
+  uint64_t buffer_ = 0;
+  unsigned num_buffered_ = 0;
+};
+
+/**
+ Read values of a fixed number of bits written by a BitPacker
+ */
+class BitUnpacker {
+ public:
+  BitUnpacker(const char* const data, const unsigned num_bits)
+      : data_(reinterpret_cast<const unsigned char*>(data)),
+        num_bits_(num_bits),
+        mask_((uint64_t{1} << num_bits) - 1) {}
+
+  uint32_t get() {
+    for (; num_buffered_ < num_bits_; num_buffered_ += 8) {
+      buffer_ |= static_cast<uint64_t>(*data_++) << num_buffered_;
+    }
+    const uint32_t value = static_cast<uint32_t>(buffer_ & mask_);
+    buffer_ >>= num_bits_;
+    num_buffered_ -= num_bits_;
+    return value;
+  }
+
+ private:
+  const unsigned char* data_;
+  const unsigned num_bits_;
+  const uint64_t mask_;
+  uint64_t buffer_ = 0;
+  unsigned num_buffered_ = 0;
+};
+
+/**
+ Get the number of bytes of num_values packed values of num_bits bits
+ */
+inline size_t getPackedSize(const size_t num_values, const unsigned num_bits) {
+  return (num_values * num_bits + 7) / 8;
+}
+
+/**
+ Count the characters of sequences to detect their type
+ */
+struct SeqTypeCounter {
+  size_t num_nuc = 0;
+  size_t num_ungap = 0;
+  size_t num_bin = 0;
+  size_t num_alpha = 0;
+  size_t num_digit = 0;
+
+  void count(const std::string& sequence) {
+    for (const char c : sequence) {
+      if (c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'U') {
+        ++num_nuc;
+        ++num_ungap;
+        continue;
+      }
+      if (c == '?' || c == '-' || c == '.') {
+        continue;
+      }
+      if (c != 'N' && c != 'X' && c != '~') {
+        num_ungap++;
+        if (isdigit(c)) {
+          num_digit++;
+          if (c == '0' || c == '1') {
+            num_bin++;
+          }
+        }
+      }
+      if (isalpha(c)) {
+        num_alpha++;
+      }
+    }
+  }
+
+  cmaple::SeqRegion::SeqType detect() const {
+    if (static_cast<double>(num_nuc) / num_ungap > 0.9) {
+      if (cmaple::verbose_mode >= cmaple::VB_DEBUG) {
+        std::cout << "DNA data detected." << std::endl;
+      }
+      return cmaple::SeqRegion::SEQ_DNA;
+    }
+    /*if (((double)num_bin) / num_ungap > 0.9)
+    {
+        if (cmaple::verbose_mode >= cmaple::VB_DEBUG)
+            std::cout << "Binary data detected." << std::endl;
+        return SEQ_BINARY;
+    }*/
+    if ((static_cast<double>(num_alpha) + num_nuc) / num_ungap > 0.9) {
+      if (cmaple::verbose_mode >= cmaple::VB_DEBUG) {
+        std::cout << "Protein data detected." << std::endl;
+      }
+      return cmaple::SeqRegion::SEQ_PROTEIN;
+    }
+    /*if (((double)(num_alpha + num_digit + num_nuc)) / num_ungap > 0.9)
+    {
+        if (cmaple::verbose_mode >= cmaple::VB_DEBUG)
+            std::cout << "Morphological data detected." << std::endl;
+        return SEQ_MORPH;
+    }*/
+    return cmaple::SeqRegion::SEQ_UNKNOWN;
+  }
+};
+
+/**
+ Target size of the blocks rendered by the alignment writers
+ */
+constexpr size_t WRITE_BLOCK_SIZE = 1 << 20;
+
+/**
+ Split items (e.g. sequences) into consecutive blocks of about
+ WRITE_BLOCK_SIZE bytes, given the (estimated) output size of each item
+ @return the first item of each block, followed by the number of items
+ */
+template <typename SizeFunc>
+std::vector<size_t> splitIntoBlocks(const size_t num_items,
+                                    SizeFunc item_size) {
+  std::vector<size_t> block_starts = {0};
+  size_t block_size = 0;
+  for (size_t i = 0; i < num_items; ++i) {
+    block_size += item_size(i);
+    if (block_size >= WRITE_BLOCK_SIZE && i + 1 < num_items) {
+      block_starts.push_back(i + 1);
+      block_size = 0;
+    }
+  }
+  block_starts.push_back(num_items);
+  return block_starts;
+}
+
+/**
+ Render blocks into per-thread buffers in parallel, and write them to a
+ stream in order, one write per block. If compress is TRUE, each block is
+ compressed (by the thread that rendered it) into a separate gzip member
+ @param[in] render A function (block, buffer) that appends the content of a
+ block to an empty buffer
+ */
+template <typename RenderFunc>
+void writeBlocksInOrder(std::ostream& out,
+                        const size_t num_blocks,
+                        RenderFunc render,
+                        const bool compress) {
+  const int64_t num_blocks_signed = static_cast<int64_t>(num_blocks);
+  std::exception_ptr block_exception = nullptr;
+  // only accessed in the ordered sections
+  bool failed = false;
+#pragma omp parallel if (num_blocks > 1)
+  {
+    // the buffers of this thread, reused for all its blocks
+    std::string buffer;
+    std::string compressed;
+#pragma omp for ordered schedule(dynamic)
+    for (int64_t i = 0; i < num_blocks_signed; ++i) {
+      bool rendered = false;
+      try {
+        buffer.clear();
+        render(static_cast<size_t>(i), buffer);
+        if (compress) {
+          compressed.clear();
+          appendGzipMember(buffer.data(), buffer.size(), compressed);
+        }
+        rendered = true;
+      } catch (...) {
+#pragma omp critical
+        if (!block_exception) {
+          block_exception = std::current_exception();
+        }
+      }
+
+#pragma omp ordered
+      {
+        // stop writing at the first failed block
+        failed = failed || !rendered;
+        if (!failed) {
+          const std::string& block = compress ? compressed : buffer;
+          try {
+            out.write(block.data(),
+                      static_cast<std::streamsize>(block.size()));
+          } catch (...) {
+            failed = true;
+#pragma omp critical
+            if (!block_exception) {
+              block_exception = std::current_exception();
+            }
+          }
+        }
+      }
+    }
+  }  // omp parallel
+  if (block_exception) {
+    std::rethrow_exception(block_exception);
+  }
+}
+
+/**
+ Stable LSD radix sort of items by their (non-negative) integer keys, 8 bits
+ per pass. Each pass counts the digits of contiguous chunks of items in
+ parallel, then scatters the chunks in parallel, so that equal keys keep
+ their order
+ @return the indexes of the items, sorted by their keys
+ */
+std::vector<NumSeqsType> radixSortByKeys(std::vector<uint32_t> keys) {
+  constexpr size_t RADIX = 256;
+  constexpr size_t MIN_CHUNK_SIZE = 1 << 14;
+  const size_t num_items = keys.size();
+  std::vector<NumSeqsType> indexes(num_items);
+  std::iota(indexes.begin(), indexes.end(), 0);
+  if (num_items < 2) {
+    return indexes;
+  }
+
+  const uint32_t max_key = *std::max_element(keys.begin(), keys.end());
+#ifdef _OPENMP
+  const size_t max_num_chunks = static_cast<size_t>(omp_get_max_threads());
+#else
+  const size_t max_num_chunks = 1;
+#endif
+  const int num_chunks = static_cast<int>(
+      std::max(static_cast<size_t>(1),
+               std::min(max_num_chunks, num_items / MIN_CHUNK_SIZE)));
+  std::vector<size_t> chunk_starts(static_cast<size_t>(num_chunks) + 1);
+  for (size_t c = 0; c <= static_cast<size_t>(num_chunks); ++c) {
+    chunk_starts[c] = num_items * c / static_cast<size_t>(num_chunks);
+  }
+
+  std::vector<uint32_t> next_keys(num_items);
+  std::vector<NumSeqsType> next_indexes(num_items);
+  std::vector<std::array<size_t, RADIX>> offsets(
+      static_cast<size_t>(num_chunks));
+  // skip the passes over the leading zero digits of all keys
+  for (unsigned shift = 0; shift < 32 && (max_key >> shift); shift += 8) {
+    // count the digits in each chunk
+#pragma omp parallel for if (num_chunks > 1)
+    for (int c = 0; c < num_chunks; ++c) {
+      std::array<size_t, RADIX>& counts = offsets[static_cast<size_t>(c)];
+      counts.fill(0);
+      for (size_t i = chunk_starts[static_cast<size_t>(c)];
+           i < chunk_starts[static_cast<size_t>(c) + 1]; ++i) {
+        ++counts[(keys[i] >> shift) & (RADIX - 1)];
+      }
+    }
+
+    // the output offset of each (digit, chunk)
+    size_t offset = 0;
+    for (size_t digit = 0; digit < RADIX; ++digit) {
+      for (std::array<size_t, RADIX>& chunk_offsets : offsets) {
+        const size_t count = chunk_offsets[digit];
+        chunk_offsets[digit] = offset;
+        offset += count;
+      }
+    }
+
+    // scatter the chunks
+#pragma omp parallel for if (num_chunks > 1)
+    for (int c = 0; c < num_chunks; ++c) {
+      std::array<size_t, RADIX>& chunk_offsets =
+          offsets[static_cast<size_t>(c)];
+      for (size_t i = chunk_starts[static_cast<size_t>(c)];
+           i < chunk_starts[static_cast<size_t>(c) + 1]; ++i) {
+        const size_t position =
+            chunk_offsets[(keys[i] >> shift) & (RADIX - 1)]++;
+        next_keys[position] = keys[i];
+        next_indexes[position] = indexes[i];
+      }
+    }
+    keys.swap(next_keys);
+    indexes.swap(next_indexes);
+  }
+
+  return indexes;
+}
+
+/**
+ Hash the mutations of a sequence
+ */
+uint64_t hashMutations(const Sequence& sequence) {
+  // FNV-1a over the fields of the mutations
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  const auto combine = [&hash](const uint64_t value) {
+    hash = (hash ^ value) * 0x100000001b3ULL;
+  };
+  for (const Mutation& mutation : sequence) {
+    combine(mutation.type);
+    combine(static_cast<uint64_t>(mutation.position));
+    combine(static_cast<uint64_t>(mutation.getLength()));
+  }
+  return hash;
+}
+
+/**
+ Check whether two sequences have the same mutations
+ */
+bool haveSameMutations(const Sequence& sequence1, const Sequence& sequence2) {
+  return std::equal(
+      sequence1.begin(), sequence1.end(), sequence2.begin(), sequence2.end(),
+      [](const Mutation& mutation1, const Mutation& mutation2) {
+        return mutation1.type == mutation2.type &&
+               mutation1.position == mutation2.position &&
+               mutation1.getLength() == mutation2.getLength();
+      });
+}
+
+/**
+ Append a non-negative integer in decimal to a buffer
+ */
+template <typename IntType>
+inline void appendInt(std::string& buffer, const IntType value) {
+  char digits[24];
+  const std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  buffer.append(digits, result.ptr);
+}
+}  // namespace
+
 void cmaple::Alignment::reset() {
   setSeqType(cmaple::SeqRegion::SEQ_AUTO);
   data.clear();
@@ -255,42 +832,63 @@ void cmaple::Alignment::processSeq(string& sequence,
   }
 }
 
+bool cmaple::Alignment::readFastaSeq(std::istream& aln_stream,
+                                     std::string& seq_name,
+                                     std::string& sequence,
+                                     PositionType& line_num) {
+  string line;
+  sequence.clear();
+
+  // find the header of the next sequence
+  bool found = false;
+  while (!found && !aln_stream.eof()) {
+    ++line_num;
+    safeGetline(aln_stream, line);
+    if (line == "") {
+      continue;
+    }
+
+    if (line[0] != '>') {
+      throw std::logic_error(
+          "First line must begin with '>' to define sequence name");
+    }
+
+    string::size_type pos = line.find_first_of("\n\r");
+    seq_name = line.substr(1, pos - 1);
+    trimString(seq_name);
+    found = true;
+  }
+  if (!found) {
+    return false;
+  }
+
+  // read sequence contents until the next header
+  for (int next_char = aln_stream.peek();
+       next_char != EOF && next_char != '>'; next_char = aln_stream.peek()) {
+    ++line_num;
+    safeGetline(aln_stream, line);
+    processSeq(sequence, line, line_num);
+  }
+
+  return true;
+}
+
 void cmaple::Alignment::readFasta(std::istream& aln_stream,
                                   StrVector& sequences,
                                   StrVector& seq_names,
                                   bool check_min_seqs) {
-  ostringstream err_str(ios_base::out);
-  PositionType line_num = 1;
-  string line;
+  PositionType line_num = 0;
+  string seq_name;
+  string sequence;
 
   // set the failbit and badbit
   aln_stream.exceptions(ios::failbit | ios::badbit);
   // remove the failbit
   aln_stream.exceptions(ios::badbit);
 
-  {
-    for (; !aln_stream.eof(); ++line_num) {
-      safeGetline(aln_stream, line);
-      if (line == "") {
-        continue;
-      }
-
-      if (line[0] == '>') {  // next sequence
-        string::size_type pos = line.find_first_of("\n\r");
-        seq_names.push_back(line.substr(1, pos - 1));
-        trimString(seq_names.back());
-        sequences.push_back("");
-        continue;
-      }
-
-      // read sequence contents
-      if (sequences.empty()) {
-        throw std::logic_error(
-            "First line must begin with '>' to define sequence name");
-      }
-
-      processSeq(sequences.back(), line, line_num);
-    }
+  while (readFastaSeq(aln_stream, seq_name, sequence, line_num)) {
+    seq_names.push_back(std::move(seq_name));
+    sequences.push_back(std::move(sequence));
   }
 
   // set the failbit again
@@ -303,6 +901,10 @@ void cmaple::Alignment::readFasta(std::istream& aln_stream,
                            convertIntToString(MIN_NUM_TAXA) + " sequences");
   }
 
+  shortenSeqNames(seq_names);
+}
+
+void cmaple::Alignment::shortenSeqNames(StrVector& seq_names) {
   // now try to cut down sequence name if possible
   std::vector<std::string>::size_type i = 0;
   PositionType step = 0;
@@ -487,46 +1089,57 @@ auto cmaple::Alignment::generateRef(StrVector& sequences) -> string {
   // init dummy variables
   const char NULL_CHAR = '\0';
   const char GAP = '-';
+  const PositionType seq_length =
+      static_cast<PositionType>(sequences[0].length());
   string ref_str(sequences[0].length(), NULL_CHAR);
   const char DEFAULT_CHAR = cmaple::Alignment::convertState2Char(0, seq_type_);
-
-  // determine a character for each site one by one
-  PositionType threshold = static_cast<PositionType>(sequences.size() * 0.5);
-  for (std::basic_string<char>::size_type i = 0; i < ref_str.length(); ++i) {
-    // Init a map to count the number of times each character appears
-    std::map<char, PositionType> num_appear;
-
-    for (std::vector<std::string>::size_type j = 0; j < sequences.size(); ++j) {
-      // update num_appear for the current character
-      PositionType count = num_appear[sequences[j][i]] + 1;
-      num_appear[sequences[j][i]] = count;
-
-      // stop counting if a non-gap character appear in more than 1/2 sequences
-      // at the current site
-      if (count >= threshold && sequences[j][i] != GAP) {
-        ref_str[i] = sequences[j][i];
-        break;
+  const PositionType threshold = getRefThreshold(sequences.size());
+
+  // count the characters tile by tile: each thread takes a tile of sites and
+  // scans every sequence over it (so that each row is read contiguously and
+  // the counts of the tile stay in cache)
+  constexpr PositionType TILE_LENGTH = 1024;
+  const PositionType num_tiles = (seq_length + TILE_LENGTH - 1) / TILE_LENGTH;
+#pragma omp parallel if (num_tiles > 1)
+  {
+    std::vector<PositionType> char_counts(
+        static_cast<size_t>(TILE_LENGTH) * NUM_SEQ_CHARS);
+#pragma omp for schedule(dynamic)
+    for (PositionType tile = 0; tile < num_tiles; ++tile) {
+      const size_t tile_start = static_cast<size_t>(tile) * TILE_LENGTH;
+      const size_t tile_end =
+          std::min(tile_start + TILE_LENGTH, static_cast<size_t>(seq_length));
+      std::fill(char_counts.begin(), char_counts.end(), 0);
+
+      for (const std::string& sequence : sequences) {
+        PositionType* site_counts = char_counts.data();
+        for (size_t i = tile_start; i < tile_end;
+             ++i, site_counts += NUM_SEQ_CHARS) {
+          ++site_counts[getCharIndex(sequence[i])];
+        }
       }
-    }
 
-    // manually determine the most popular charater for the current site (if no
-    // character dominates all the others)
-    if (ref_str[i] == NULL_CHAR) {
-      for (const std::pair<const char, PositionType>& character : num_appear) {
-        if (character.first != GAP &&
-            (ref_str[i] == NULL_CHAR ||
-             character.second > num_appear[ref_str[i]])) {
-          ref_str[i] = character.first;
+      // determine a character for each site of the tile
+      const PositionType* site_counts = char_counts.data();
+      for (size_t i = tile_start; i < tile_end;
+           ++i, site_counts += NUM_SEQ_CHARS) {
+        ref_str[i] = pickRefChar(site_counts, threshold, DEFAULT_CHAR);
+
+        // several characters reach the threshold -> pick the first one that
+        // reaches it
+        if (ref_str[i] == NULL_CHAR) {
+          std::array<PositionType, NUM_SEQ_CHARS> num_appear{};
+          for (const std::string& sequence : sequences) {
+            const char c = sequence[i];
+            if (c != GAP && ++num_appear[getCharIndex(c)] >= threshold) {
+              ref_str[i] = c;
+              break;
+            }
+          }
         }
       }
     }
-
-    // if not found -> all characters in this site are gaps -> choose the
-    // default state
-    if (ref_str[i] == NULL_CHAR) {
-      ref_str[i] = DEFAULT_CHAR;
-    }
-  }
+  }  // omp parallel
     
   assert(ref_str.length() == sequences[0].length());
 
@@ -557,8 +1170,8 @@ auto cmaple::Alignment::readRefSeq(const std::string& ref_filename,
   }
   StrVector str_sequences(0);
   StrVector seq_names(0);
-  // Create a stream from the input alignment
-  ifstream ref_stream;
+  // Create a stream from the input alignment (decompressed if needed)
+  InputFileStream ref_stream;
   try {
     ref_stream.exceptions(ios::failbit | ios::badbit);
     ref_stream.open(ref_filename);
@@ -628,109 +1241,113 @@ void cmaple::Alignment::extractMutations(const StrVector& str_sequences,
   }
 
   data.clear();
-  Sequence* sequence = nullptr;
-  std::vector<char>::size_type seq_length = ref_sequence.length();
 
   // extract mutations of sequences one by one
   for (std::vector<std::string>::size_type i = 0; i < str_sequences.size(); ++i) {
-    // validate the sequence length
-    string str_sequence = str_sequences[i];
-    if (seq_length != str_sequence.length()) {
-      throw std::logic_error(
-          "The sequence length of " + seq_names[static_cast<std::vector<std::string>
-                                                    ::size_type>(i)] + " (" +
-          convertIntToString(static_cast<int>(str_sequence.length())) +
-          ") is different from that of the reference sequence (" +
-          convertIntToString(static_cast<int>(ref_sequence.length())) + ")!");
-    }
+    extractMutations(str_sequences[i], seq_names[i], ref_sequence);
+  }
+}
+
+void cmaple::Alignment::extractMutations(const std::string& str_sequence,
+                                         const std::string& seq_name,
+                                         const std::string& ref_sequence) {
+  std::vector<char>::size_type seq_length = ref_sequence.length();
 
-    // init new sequence instance for the inference process afterwards
-    data.push_back(string(seq_names[static_cast<std::vector<std::string>::size_type>(i)]));
-    sequence = &data.back();
+  // validate the sequence length
+  if (seq_length != str_sequence.length()) {
+    throw std::logic_error(
+        "The sequence length of " + seq_name + " (" +
+        convertIntToString(static_cast<int>(str_sequence.length())) +
+        ") is different from that of the reference sequence (" +
+        convertIntToString(static_cast<int>(ref_sequence.length())) + ")!");
+  }
 
-    // init dummy variables
-    int state = 0;
-    PositionType length = 0;
-    for (std::basic_string<char>::size_type pos = 0; pos < seq_length; ++pos) {
-      switch (state) {
-        case 0:  // previous character is neither 'N' nor '-'
+  // init new sequence instance for the inference process afterwards
+  data.push_back(string(seq_name));
+  Sequence* const sequence = &data.back();
+
+  // init dummy variables
+  int state = 0;
+  PositionType length = 0;
+  for (std::basic_string<char>::size_type pos = 0; pos < seq_length; ++pos) {
+    switch (state) {
+      case 0:  // previous character is neither 'N' nor '-'
+        if (str_sequence[pos] != ref_sequence[pos]) {
+          length = 1;
+
+          // starting a sequence of 'N'
+          if (toupper(str_sequence[pos]) == 'N' &&
+              getSeqType() == cmaple::SeqRegion::SEQ_DNA) {
+            state = 1;
+            // starting a sequence of '-'
+          } else if (str_sequence[pos] == '-') {
+            state = 2;
+            // output a mutation
+          } else {
+            addMutation(sequence, str_sequence[pos], static_cast<PositionType>(pos));
+          }
+        }
+        break;
+      case 1:  // previous character is 'N'
+        // inscrease the length if the current character is still 'N'
+        if (toupper(str_sequence[pos]) == 'N' &&
+            str_sequence[pos] != ref_sequence[pos]) {
+          ++length;
+        } else {
+          // output the previous sequence of 'N'
+          addMutation(sequence, str_sequence[pos - 1], (static_cast<PositionType>(pos)) - length, length);
+
+          // reset state
+          state = 0;
+
+          // handle new character different from the reference
           if (str_sequence[pos] != ref_sequence[pos]) {
             length = 1;
+            // starting a sequence of '-'
+            if (str_sequence[pos] == '-') {
+              state = 2;
+              // output a mutation
+            } else {
+              addMutation(sequence, str_sequence[pos], static_cast<PositionType>(pos));
+              state = 0;
+            }
+          }
+        }
+        break;
+      case 2:  // previous character is '-'
+        // inscrease the length if the current character is still '-'
+        if (toupper(str_sequence[pos]) == '-' &&
+            str_sequence[pos] != ref_sequence[pos]) {
+          ++length;
+        } else {
+          // output the previous sequence of '-'
+          addMutation(sequence, str_sequence[pos - 1], (static_cast<PositionType>(pos)) - length, length);
 
+          // reset state
+          state = 0;
+
+          // handle new character different from the reference
+          if (str_sequence[pos] != ref_sequence[pos]) {
+            length = 1;
             // starting a sequence of 'N'
             if (toupper(str_sequence[pos]) == 'N' &&
                 getSeqType() == cmaple::SeqRegion::SEQ_DNA) {
               state = 1;
-              // starting a sequence of '-'
-            } else if (str_sequence[pos] == '-') {
-              state = 2;
               // output a mutation
             } else {
               addMutation(sequence, str_sequence[pos], static_cast<PositionType>(pos));
+              state = 0;
             }
           }
-          break;
-        case 1:  // previous character is 'N'
-          // inscrease the length if the current character is still 'N'
-          if (toupper(str_sequence[pos]) == 'N' &&
-              str_sequence[pos] != ref_sequence[pos]) {
-            ++length;
-          } else {
-            // output the previous sequence of 'N'
-            addMutation(sequence, str_sequence[pos - 1], (static_cast<PositionType>(pos)) - length, length);
-
-            // reset state
-            state = 0;
-
-            // handle new character different from the reference
-            if (str_sequence[pos] != ref_sequence[pos]) {
-              length = 1;
-              // starting a sequence of '-'
-              if (str_sequence[pos] == '-') {
-                state = 2;
-                // output a mutation
-              } else {
-                addMutation(sequence, str_sequence[pos], static_cast<PositionType>(pos));
-                state = 0;
-              }
-            }
-          }
-          break;
-        case 2:  // previous character is '-'
-          // inscrease the length if the current character is still '-'
-          if (toupper(str_sequence[pos]) == '-' &&
-              str_sequence[pos] != ref_sequence[pos]) {
-            ++length;
-          } else {
-            // output the previous sequence of '-'
-            addMutation(sequence, str_sequence[pos - 1], (static_cast<PositionType>(pos)) - length, length);
-
-            // reset state
-            state = 0;
-
-            // handle new character different from the reference
-            if (str_sequence[pos] != ref_sequence[pos]) {
-              length = 1;
-              // starting a sequence of 'N'
-              if (toupper(str_sequence[pos]) == 'N' &&
-                  getSeqType() == cmaple::SeqRegion::SEQ_DNA) {
-                state = 1;
-                // output a mutation
-              } else {
-                addMutation(sequence, str_sequence[pos], static_cast<PositionType>(pos));
-                state = 0;
-              }
-            }
-          }
-          break;
-      }
+        }
+        break;
     }
+  }
 
-    //  output the last sequence of 'N' or '-' (if any)
-    if (state != 0) {
-      addMutation(sequence, str_sequence[str_sequence.length() - 1],
-                  (static_cast<PositionType>(str_sequence.length())) - length, length);
-    }
+  //  output the last sequence of 'N' or '-' (if any)
+  if (state != 0) {
+    addMutation(sequence, str_sequence[str_sequence.length() - 1],
+                (static_cast<PositionType>(str_sequence.length())) - length, length);
   }
 }
 
@@ -808,20 +1425,7 @@ void cmaple::Alignment::readMaple(std::istream& aln_stream) {
             "MAPLE file must start by >REF. Please check and try again!");
       }
 
-      // transform ref_sequence to uppercase
-      transform(line.begin(), line.end(), line.begin(), ::toupper);
-
-      // detect the seq_type from the ref_sequences
-      const cmaple::SeqRegion::SeqType current_seq_type = getSeqType();
-      if (current_seq_type == cmaple::SeqRegion::SEQ_AUTO ||
-          current_seq_type == cmaple::SeqRegion::SEQ_UNKNOWN) {
-        StrVector tmp_str_vec;
-        tmp_str_vec.push_back(line);
-        setSeqType(detectSequenceType(tmp_str_vec));
-      }
-
-      // parse the reference sequence into vector of state
-      parseRefSeq(line, true);
+      parseMapleRef(line);
 
       // reset the seq_name
       seq_name = "";
@@ -860,76 +1464,535 @@ void cmaple::Alignment::readMaple(std::istream& aln_stream) {
     }
     // Read a Mutation
     else {
-      // validate the input
-      char separator = '\t';
-      long num_items = std::count(line.begin(), line.end(), separator) + 1;
-      if (num_items < 2 || num_items > 3) {
-        throw std::logic_error(
-            "Invalid input. Each difference must be presented be <Type>    "
-            "<Position>  [<Length>]. Please check and try again!");
-      }
+      parseMapleMutation(line, line_num + 1, mutations);
+    }
+  }
+
+  // Record the sequence of  the last taxon
+  if (seq_name.length()) {
+    data.emplace_back(std::move(seq_name), std::move(mutations));
+  }
 
-      // extract mutation info
-      stringstream ssin(line);
-      string tmp;
+  validateMapleData();
 
-      // extract <Type>
-      ssin >> tmp;
-      StateType state;
-      try
-      {
-        state = convertChar2State(toupper(tmp[0]));
+  resetStream(aln_stream);
+}
+
+void cmaple::Alignment::readMapleMapped(const std::string& aln_filename) {
+  if (cmaple::verbose_mode >= cmaple::VB_MAX) {
+    cout << "Reading an alignment in MAPLE format from a memory-mapped file"
+         << endl;
+  }
+
+  const MappedFile aln_file(aln_filename);
+  const char* current = aln_file.data();
+  const char* const end = current + aln_file.size();
+
+  // extract reference sequence first
+  string seq_name;
+  PositionType line_num = 1;
+  for (; current < end; ++line_num) {
+    std::string line(getNextLine(current, end));
+    if (line == "") {
+      continue;
+    }
+
+    // read the first line (">REF")
+    if (line[0] == '>') {
+      seq_name = line.substr(1);
+
+      // transform seq_name to upper case
+      transform(seq_name.begin(), seq_name.end(), seq_name.begin(), ::toupper);
+
+      if (seq_name != REF_NAME && seq_name != "REFERENCE") {
+        throw std::logic_error(
+            "MAPLE file must start by >REF. Please check and try again!");
       }
-      catch(std::invalid_argument& e)
-      {
-        throw std::invalid_argument("Line " + convertIntToString(line_num + 1) + ": " + e.what());
+    }
+    // read the reference sequence
+    else {
+      // make sure the first line was found
+      if (seq_name != REF_NAME && seq_name != "REFERENCE") {
+        throw std::logic_error(
+            "MAPLE file must start by >REF. Please check and try again!");
       }
 
-      // extract <Position>
-      ssin >> tmp;
-      PositionType pos = convert_positiontype(tmp.c_str());
-      if (pos <= 0 || pos > static_cast<PositionType>(ref_seq.size())) {
+      parseMapleRef(line);
+      ++line_num;
+      break;
+    }
+  }
+
+  // split the other records into chunks at record boundaries
+  constexpr std::ptrdiff_t CHUNK_SIZE = 1 << 22;
+  std::vector<const char*> chunk_starts = {current};
+  while (end - chunk_starts.back() > CHUNK_SIZE) {
+    const char* const next_start =
+        findNextRecord(chunk_starts.back() + CHUNK_SIZE, end);
+    if (next_start == end) {
+      break;
+    }
+    chunk_starts.push_back(next_start);
+  }
+  chunk_starts.push_back(end);
+  const PositionType num_chunks =
+      static_cast<PositionType>(chunk_starts.size() - 1);
+
+  // the number of the first line of each chunk (for error messages)
+  std::vector<PositionType> line_nums(chunk_starts.size(), 0);
+#pragma omp parallel for if (num_chunks > 1)
+  for (PositionType i = 0; i < num_chunks; ++i) {
+    line_nums[static_cast<size_t>(i) + 1] =
+        countLines(chunk_starts[static_cast<size_t>(i)],
+                   chunk_starts[static_cast<size_t>(i) + 1]);
+  }
+  line_nums[0] = line_num;
+  std::partial_sum(line_nums.begin(), line_nums.end(), line_nums.begin());
+
+  // parse the chunks in parallel
+  std::vector<std::vector<Sequence>> chunk_sequences(
+      static_cast<size_t>(num_chunks));
+  std::vector<std::exception_ptr> chunk_exceptions(
+      static_cast<size_t>(num_chunks));
+#pragma omp parallel for schedule(dynamic) if (num_chunks > 1)
+  for (PositionType i = 0; i < num_chunks; ++i) {
+    const size_t chunk = static_cast<size_t>(i);
+    try {
+      parseMapleRecords(chunk_starts[chunk], chunk_starts[chunk + 1],
+                        line_nums[chunk], chunk_sequences[chunk]);
+    } catch (...) {
+      chunk_exceptions[chunk] = std::current_exception();
+    }
+  }
+
+  // report the first error in the file (if any)
+  for (const std::exception_ptr& chunk_exception : chunk_exceptions) {
+    if (chunk_exception) {
+      std::rethrow_exception(chunk_exception);
+    }
+  }
+
+  // concatenate the chunks in their original order
+  size_t num_seqs = 0;
+  for (const std::vector<Sequence>& sequences : chunk_sequences) {
+    num_seqs += sequences.size();
+  }
+  data.reserve(num_seqs);
+  for (std::vector<Sequence>& sequences : chunk_sequences) {
+    std::move(sequences.begin(), sequences.end(), std::back_inserter(data));
+  }
+
+  validateMapleData();
+}
+
+void cmaple::Alignment::parseMapleRef(std::string& ref_line) {
+  // transform ref_sequence to uppercase
+  transform(ref_line.begin(), ref_line.end(), ref_line.begin(), ::toupper);
+
+  // detect the seq_type from the ref_sequences
+  const cmaple::SeqRegion::SeqType current_seq_type = getSeqType();
+  if (current_seq_type == cmaple::SeqRegion::SEQ_AUTO ||
+      current_seq_type == cmaple::SeqRegion::SEQ_UNKNOWN) {
+    StrVector tmp_str_vec;
+    tmp_str_vec.push_back(ref_line);
+    setSeqType(detectSequenceType(tmp_str_vec));
+  }
+
+  // parse the reference sequence into vector of state
+  parseRefSeq(ref_line, true);
+}
+
+void cmaple::Alignment::parseMapleMutation(const std::string_view line,
+                                           const PositionType line_num,
+                                           std::vector<Mutation>& mutations) {
+  // validate the input
+  char separator = '\t';
+  long num_items = std::count(line.begin(), line.end(), separator) + 1;
+  if (num_items < 2 || num_items > 3) {
+    throw std::logic_error(
+        "Invalid input. Each difference must be presented be <Type>    "
+        "<Position>  [<Length>]. Please check and try again!");
+  }
+
+  // extract the (whitespace-separated) items one by one
+  std::string_view::size_type item_end = 0;
+  const auto next_item = [&line, &item_end]() {
+    std::string_view::size_type item_start = item_end;
+    while (item_start < line.length() && isspace(line[item_start])) {
+      ++item_start;
+    }
+    item_end = item_start;
+    while (item_end < line.length() && !isspace(line[item_end])) {
+      ++item_end;
+    }
+    return line.substr(item_start, item_end - item_start);
+  };
+
+  // extract <Type>
+  const std::string_view type = next_item();
+  StateType state;
+  try
+  {
+    state = convertChar2State(
+        static_cast<char>(toupper(type.length() ? type[0] : '\0')));
+  }
+  catch(std::invalid_argument& e)
+  {
+    throw std::invalid_argument("Line " + convertIntToString(line_num) + ": " + e.what());
+  }
+
+  // extract <Position>
+  const std::string pos_str(next_item());
+  PositionType pos = convert_positiontype(pos_str.c_str());
+  if (pos <= 0 || pos > static_cast<PositionType>(ref_seq.size())) {
+    throw std::logic_error(
+        "<Position> must be greater than 0 and less than the reference "
+        "sequence length (" +
+        convertPosTypeToString(static_cast<PositionType>(ref_seq.size())) + ")!");
+  }
+
+  // extract <Length>
+  PositionType length = 1;
+  if (item_end < line.length()) {
+    // (keep <Position> if nothing follows but spaces, as reading it from a
+    // stream used to do)
+    const std::string_view length_item = next_item();
+    const std::string tmp(length_item.length() ? length_item : pos_str);
+    if (state == TYPE_N || state == TYPE_DEL) {
+      length = convert_positiontype(tmp.c_str());
+      if (length <= 0) {
+        throw std::logic_error("<Length> must be greater than 0!");
+      }
+      if (length + pos - 1 > static_cast<PositionType>(ref_seq.size())) {
         throw std::logic_error(
-            "<Position> must be greater than 0 and less than the reference "
+            "<Length> + <Position> must be less than the reference "
             "sequence length (" +
             convertPosTypeToString(static_cast<PositionType>(ref_seq.size())) + ")!");
       }
+    } else if (cmaple::verbose_mode >= cmaple::VB_MED) {
+#pragma omp critical
+      outWarning("Ignoring <Length> of " + tmp +
+                 ". <Length> is only appliable for 'N' or '-'.");
+    }
+  }
+
+  // add a new mutation into mutations
+  if (state == TYPE_N || state == TYPE_DEL) {
+    mutations.emplace_back(state, pos - 1, length);
+  } else {
+    mutations.emplace_back(state, pos - 1);
+  }
+}
+
+void cmaple::Alignment::parseMapleRecords(const char* begin,
+                                          const char* const end,
+                                          PositionType line_num,
+                                          std::vector<Sequence>& sequences) {
+  string seq_name;
+  vector<Mutation> mutations;
+  for (; begin < end; ++line_num) {
+    const std::string_view line = getNextLine(begin, end);
+    if (line.empty()) {
+      continue;
+    }
+
+    // Read sequence name
+    if (line[0] == '>') {
+      // record the sequence of the previous taxon
+      if (seq_name.length()) {
+        sequences.emplace_back(std::move(seq_name), std::move(mutations));
+
+        // reset dummy variables
+        seq_name.clear();
+        mutations.clear();
+      }
+
+      // Read new sequence name
+      seq_name = line.substr(1);
+      if (!seq_name.length()) {
+        throw std::logic_error("Empty sequence name found at line " +
+                               convertIntToString(line_num) +
+                               ". Please check and try again!");
+      }
+    }
+    // Read a Mutation
+    else {
+      parseMapleMutation(line, line_num, mutations);
+    }
+  }
+
+  // Record the sequence of the last taxon
+  if (seq_name.length()) {
+    sequences.emplace_back(std::move(seq_name), std::move(mutations));
+  }
+}
+
+void cmaple::Alignment::writeBinary(std::ostream& aln_stream,
+                                     const bool compress) {
+  assert(data.size() > 0);
 
-      // extract <Length>
-      PositionType length = 1;
-      if (ssin.good()) {
-        ssin >> tmp;
-        if (state == TYPE_N || state == TYPE_DEL) {
-          length = convert_positiontype(tmp.c_str());
-          if (length <= 0) {
-            throw std::logic_error("<Length> must be greater than 0!");
+  // the states of the mutations; each mutation stores the index (code) of
+  // its state
+  std::vector<StateType> code_states;
+  std::vector<int32_t> state_codes(TYPE_INVALID + 1, -1);
+  for (const Sequence& sequence : data) {
+    for (const Mutation& mutation : sequence) {
+      assert(mutation.type < TYPE_INVALID);
+      if (state_codes[mutation.type] < 0) {
+        state_codes[mutation.type] = 0;
+        code_states.push_back(mutation.type);
+      }
+    }
+  }
+  std::sort(code_states.begin(), code_states.end());
+  for (size_t i = 0; i < code_states.size(); ++i) {
+    state_codes[code_states[i]] = static_cast<int32_t>(i);
+  }
+  const unsigned code_bits = getNumBits(code_states.size());
+  const unsigned ref_bits = getNumBits(num_states);
+
+  // encode the names and records of the sequences, and index them
+  std::string names;
+  std::string records;
+  std::vector<uint64_t> name_offsets = {0};
+  std::vector<uint64_t> record_offsets = {0};
+  for (const Sequence& sequence : data) {
+    names += sequence.seq_name;
+    name_offsets.push_back(names.size());
+
+    putVarint(records, sequence.size());
+    PositionType pre_position = 0;
+    for (const Mutation& mutation : sequence) {
+      putZigzag(records, static_cast<int64_t>(mutation.position) - pre_position);
+      pre_position = mutation.position;
+    }
+    BitPacker codes(records, code_bits);
+    for (const Mutation& mutation : sequence) {
+      codes.put(static_cast<uint32_t>(state_codes[mutation.type]));
+    }
+    codes.flush();
+    for (const Mutation& mutation : sequence) {
+      if (mutation.type == TYPE_N || mutation.type == TYPE_DEL) {
+        putVarint(records, static_cast<uint64_t>(mutation.getLength()));
+      }
+    }
+    record_offsets.push_back(records.size());
+  }
+
+  // header
+  std::string header(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  putFixed(header, BINARY_VERSION, 4);
+  putFixed(header, static_cast<uint64_t>(seq_type_), 1);
+  putFixed(header, num_states, 1);
+  putFixed(header, code_states.size(), 2);
+  for (const StateType state : code_states) {
+    putFixed(header, state, 2);
+  }
+  putFixed(header, ref_seq.size(), 4);
+  putFixed(header, data.size(), 4);
+  putFixed(header, names.size(), 8);
+  putFixed(header, records.size(), 8);
+  // offsets in the index take 4 bytes unless a part exceeds 4 GB
+  const int offset_bytes =
+      std::max(names.size(), records.size()) >> 32 ? 8 : 4;
+  putFixed(header, static_cast<uint64_t>(offset_bytes), 1);
+
+  // packed reference
+  BitPacker ref_states(header, ref_bits);
+  for (const StateType state : ref_seq) {
+    ref_states.put(state);
+  }
+  ref_states.flush();
+
+  // index
+  for (const uint64_t offset : name_offsets) {
+    putFixed(header, offset, offset_bytes);
+  }
+  for (const uint64_t offset : record_offsets) {
+    putFixed(header, offset, offset_bytes);
+  }
+
+  if (!compress) {
+    aln_stream.write(header.data(),
+                     static_cast<std::streamsize>(header.size()));
+    aln_stream.write(names.data(), static_cast<std::streamsize>(names.size()));
+    aln_stream.write(records.data(),
+                     static_cast<std::streamsize>(records.size()));
+    return;
+  }
+
+  // compress slices of (the concatenation of) the parts in parallel
+  const std::array<const std::string*, 3> parts = {&header, &names, &records};
+  const size_t total_size = header.size() + names.size() + records.size();
+  writeBlocksInOrder(
+      aln_stream, (total_size + WRITE_BLOCK_SIZE - 1) / WRITE_BLOCK_SIZE,
+      [&](const size_t block, std::string& buffer) {
+        size_t start = block * WRITE_BLOCK_SIZE;
+        size_t remaining = std::min(WRITE_BLOCK_SIZE, total_size - start);
+        for (const std::string* const part : parts) {
+          if (start >= part->size()) {
+            start -= part->size();
+            continue;
           }
-          if (length + pos - 1 > static_cast<PositionType>(ref_seq.size())) {
-            throw std::logic_error(
-                "<Length> + <Position> must be less than the reference "
-                "sequence length (" +
-                convertPosTypeToString(static_cast<PositionType>(ref_seq.size())) + ")!");
+          const size_t length = std::min(remaining, part->size() - start);
+          buffer.append(*part, start, length);
+          remaining -= length;
+          start = 0;
+          if (!remaining) {
+            break;
           }
-        } else if (cmaple::verbose_mode >= cmaple::VB_MED) {
-          outWarning("Ignoring <Length> of " + tmp +
-                     ". <Length> is only appliable for 'N' or '-'.");
         }
+      },
+      true);
+}
+
+void cmaple::Alignment::readBinary(const char* const begin,
+                                   const char* const end) {
+  if (cmaple::verbose_mode >= cmaple::VB_MAX) {
+    cout << "Reading an alignment in the binary format" << endl;
+  }
+
+  BinaryReader reader(begin, end);
+  if (memcmp(reader.getBytes(sizeof(BINARY_MAGIC)), BINARY_MAGIC,
+             sizeof(BINARY_MAGIC))) {
+    throw std::logic_error("The alignment is not in the binary format!");
+  }
+  const uint64_t version = reader.getFixed(4);
+  if (version != BINARY_VERSION) {
+    throw std::logic_error(
+        "Unsupported version " + convertIntToString(static_cast<int>(version)) +
+        " of the binary alignment. Please re-create it with this version of "
+        "CMAPLE!");
+  }
+
+  // header
+  const uint64_t seq_type = reader.getFixed(1);
+  if (seq_type != cmaple::SeqRegion::SEQ_DNA &&
+      seq_type != cmaple::SeqRegion::SEQ_PROTEIN) {
+    throw std::logic_error("Corrupted binary alignment (sequence type)!");
+  }
+  setSeqType(static_cast<cmaple::SeqRegion::SeqType>(seq_type));
+  if (reader.getFixed(1) != num_states) {
+    throw std::logic_error("Corrupted binary alignment (number of states)!");
+  }
+  std::vector<StateType> code_states(reader.getFixed(2));
+  for (StateType& state : code_states) {
+    state = static_cast<StateType>(reader.getFixed(2));
+    if (state >= TYPE_INVALID) {
+      throw std::logic_error("Corrupted binary alignment (states)!");
+    }
+  }
+  const PositionType ref_length = static_cast<PositionType>(reader.getFixed(4));
+  const size_t num_seqs = reader.getFixed(4);
+  const uint64_t names_size = reader.getFixed(8);
+  const uint64_t records_size = reader.getFixed(8);
+  const int offset_bytes = static_cast<int>(reader.getFixed(1));
+  if (offset_bytes != 4 && offset_bytes != 8) {
+    throw std::logic_error("Corrupted binary alignment (offset size)!");
+  }
+  const unsigned code_bits = getNumBits(code_states.size());
+  const unsigned ref_bits = getNumBits(num_states);
+
+  // reference
+  if (ref_length <= 0) {
+    throw std::logic_error("Reference sequence is not found!");
+  }
+  ref_seq.resize(static_cast<size_t>(ref_length));
+  BitUnpacker ref_states(
+      reader.getBytes(getPackedSize(ref_seq.size(), ref_bits)), ref_bits);
+  for (StateType& state : ref_seq) {
+    state = static_cast<StateType>(ref_states.get());
+    if (state >= num_states) {
+      throw std::logic_error("Corrupted binary alignment (reference)!");
+    }
+  }
+
+  // index, names, records
+  const size_t offset_size = static_cast<size_t>(offset_bytes);
+  const char* const index = reader.getBytes((num_seqs + 1) * 2 * offset_size);
+  const char* const names = reader.getBytes(names_size);
+  const char* const records = reader.getBytes(records_size);
+  const auto get_offset = [offset_bytes, offset_size](const char* const entry,
+                                                     const uint64_t size) {
+    BinaryReader entry_reader(entry, entry + offset_size);
+    const uint64_t offset = entry_reader.getFixed(offset_bytes);
+    if (offset > size) {
+      throw std::logic_error("Corrupted binary alignment (index)!");
+    }
+    return offset;
+  };
+
+  // decode the sequences in parallel
+  data.resize(num_seqs);
+  const PositionType num_seqs_signed = static_cast<PositionType>(num_seqs);
+  std::exception_ptr seq_exception = nullptr;
+#pragma omp parallel for schedule(dynamic, 1024) if (num_seqs > 1024)
+  for (PositionType i = 0; i < num_seqs_signed; ++i) {
+    try {
+      const size_t seq_index = static_cast<size_t>(i);
+      const char* const name_entry = index + seq_index * offset_size;
+      const char* const record_entry =
+          index + (num_seqs + 1 + seq_index) * offset_size;
+      const uint64_t name_start = get_offset(name_entry, names_size);
+      const uint64_t name_end =
+          get_offset(name_entry + offset_size, names_size);
+      const uint64_t record_start = get_offset(record_entry, records_size);
+      const uint64_t record_end =
+          get_offset(record_entry + offset_size, records_size);
+      if (name_start >= name_end || record_start > record_end) {
+        throw std::logic_error("Corrupted binary alignment (index)!");
       }
 
-      // add a new mutation into mutations
-      if (state == TYPE_N || state == TYPE_DEL) {
-        mutations.emplace_back(state, pos - 1, length);
-      } else {
-        mutations.emplace_back(state, pos - 1);
+      BinaryReader record(records + record_start, records + record_end);
+      std::vector<Mutation> mutations(record.getVarint());
+      PositionType position = 0;
+      for (Mutation& mutation : mutations) {
+        position += static_cast<PositionType>(record.getZigzag());
+        if (position < 0 || position >= ref_length) {
+          throw std::logic_error("Corrupted binary alignment (positions)!");
+        }
+        mutation.position = position;
+      }
+      BitUnpacker codes(
+          record.getBytes(getPackedSize(mutations.size(), code_bits)),
+          code_bits);
+      for (Mutation& mutation : mutations) {
+        const uint32_t code = codes.get();
+        if (code >= code_states.size()) {
+          throw std::logic_error("Corrupted binary alignment (states)!");
+        }
+        mutation.type = code_states[code];
+      }
+      for (Mutation& mutation : mutations) {
+        if (mutation.type == TYPE_N || mutation.type == TYPE_DEL) {
+          const uint64_t length = record.getVarint();
+          if (!length ||
+              length > static_cast<uint64_t>(ref_length - mutation.position)) {
+            throw std::logic_error("Corrupted binary alignment (lengths)!");
+          }
+          mutation = Mutation(mutation.type, mutation.position,
+                              static_cast<LengthTypeLarge>(length));
+        }
+      }
+
+      data[seq_index] = Sequence(
+          std::string(names + name_start, names + name_end),
+          std::move(mutations));
+    } catch (...) {
+#pragma omp critical
+      if (!seq_exception) {
+        seq_exception = std::current_exception();
       }
     }
   }
-
-  // Record the sequence of  the last taxon
-  if (seq_name.length()) {
-    data.emplace_back(std::move(seq_name), std::move(mutations));
+  if (seq_exception) {
+    std::rethrow_exception(seq_exception);
   }
 
+  validateMapleData();
+}
+
+void cmaple::Alignment::validateMapleData() const {
   // validate the input
   assert(ref_seq.size() > 0);
   if (ref_seq.size() == 0) {
@@ -939,8 +2002,6 @@ void cmaple::Alignment::readMaple(std::istream& aln_stream) {
     throw std::logic_error("The number of taxa must be at least " +
                            convertIntToString(MIN_NUM_TAXA));
   }
-
-  resetStream(aln_stream);
 }
 
 auto cmaple::Alignment::convertState2Char(
@@ -1190,40 +2251,72 @@ auto cmaple::Alignment::computeSeqDistance(Sequence& sequence,
 }
 
 void cmaple::Alignment::sortSeqsByDistances() {
-  // init dummy variables
   const RealNumType hamming_weight = 1000;
-  std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
-  auto* distances = new PositionType[num_seqs];
-  auto* sequence_indexes = new PositionType[num_seqs];
-
-  // calculate the distances of each sequence
-  for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i) {
-    // dummy variables
-    sequence_indexes[i] = static_cast<PositionType>(i);
-
-    // calculate and record the distance of the current sequence
-    distances[i] = computeSeqDistance(data[i], hamming_weight);
+  const std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
 
-    // NHANLT: debug
-    // distances[i] *= 1000;
+  // calculate the distances of the sequences in parallel
+  std::vector<uint32_t> distances(num_seqs);
+  const int64_t num_seqs_signed = static_cast<int64_t>(num_seqs);
+  std::exception_ptr seq_exception = nullptr;
+#pragma omp parallel for schedule(dynamic, 1024) if (num_seqs > 1024)
+  for (int64_t i = 0; i < num_seqs_signed; ++i) {
+    try {
+      const size_t seq_index = static_cast<size_t>(i);
+      distances[seq_index] = static_cast<uint32_t>(
+          computeSeqDistance(data[seq_index], hamming_weight));
+    } catch (...) {
+#pragma omp critical
+      if (!seq_exception) {
+        seq_exception = std::current_exception();
+      }
+    }
+  }
+  if (seq_exception) {
+    std::rethrow_exception(seq_exception);
   }
 
-  // NHANLT: debug
-
-  // sort distances
-  quicksort(distances, 0, static_cast<PositionType>(num_seqs) - 1, sequence_indexes);
+  // sort the sequences by distances; sequences at the same distance keep
+  // their input order
+  const std::vector<NumSeqsType> sequence_indexes =
+      radixSortByKeys(std::move(distances));
 
   // re-order sequences by distances
   vector<Sequence> tmp_sequences(std::move(data));
   data.reserve(num_seqs);
+  for (const NumSeqsType sequence_index : sequence_indexes) {
+    data.push_back(std::move(tmp_sequences[sequence_index]));
+  }
+}
+
+std::vector<NumSeqsType> cmaple::Alignment::findIdenticalSeqs() const {
+  const std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
+
+  // hash the mutations of the sequences in parallel
+  std::vector<uint64_t> hashes(num_seqs);
+  const int64_t num_seqs_signed = static_cast<int64_t>(num_seqs);
+#pragma omp parallel for schedule(dynamic, 1024) if (num_seqs > 1024)
+  for (int64_t i = 0; i < num_seqs_signed; ++i) {
+    const size_t seq_index = static_cast<size_t>(i);
+    hashes[seq_index] = hashMutations(data[seq_index]);
+  }
+
+  // the first sequence of each hash is the representative of its group; a
+  // sequence that only shares the hash of a different sequence (a collision)
+  // is kept on its own
+  std::vector<NumSeqsType> representatives(num_seqs);
+  std::unordered_map<uint64_t, NumSeqsType> first_seqs;
+  first_seqs.reserve(num_seqs);
   for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i) {
-    data.push_back(std::move(tmp_sequences[static_cast<std::vector<cmaple::Sequence>
-                                            ::size_type>(sequence_indexes[i])]));
+    const NumSeqsType seq_index = static_cast<NumSeqsType>(i);
+    const auto [first_seq, inserted] =
+        first_seqs.emplace(hashes[i], seq_index);
+    representatives[i] =
+        !inserted && haveSameMutations(data[first_seq->second], data[i])
+            ? first_seq->second
+            : seq_index;
   }
 
-  // delete distances, sequence_indexes
-  delete[] distances;
-  delete[] sequence_indexes;
+  return representatives;
 }
 
 auto cmaple::Alignment::getRefSeqStr() -> std::string {
@@ -1238,106 +2331,150 @@ auto cmaple::Alignment::getRefSeqStr() -> std::string {
   return ref_sequence;
 }
 
-auto cmaple::Alignment::getSeqString(const std::string& ref_seq_str,
-                                            Sequence* sequence) -> std::string {
-  // clone the sequence
-  std::string sequence_str = ref_seq_str;
-  // apply mutations in sequence_str
-  Mutation* mutation = &sequence->front();
-  for (std::vector<cmaple::Mutation>::size_type j = 0; j < sequence->size(); ++j, ++mutation) {
-    char state =
-        cmaple::Alignment::convertState2Char(mutation->type, seq_type_);
-
-    // replace characters in sequence_str
-    for (PositionType pos = mutation->position;
-         pos < mutation->position + mutation->getLength(); ++pos) {
-      sequence_str[static_cast<std::basic_string<char>::size_type>(pos)] = state;
-    }
+void cmaple::Alignment::appendSeqString(const std::string& ref_seq_str,
+                                        const Sequence& sequence,
+                                        std::string& buffer) const {
+  // copy the reference
+  const std::basic_string<char>::size_type offset = buffer.size();
+  buffer += ref_seq_str;
+
+  // apply mutations in the copy
+  char* const sequence_str = &buffer[offset];
+  for (const Mutation& mutation : sequence) {
+    const char state =
+        cmaple::Alignment::convertState2Char(mutation.type, seq_type_);
+    memset(sequence_str + mutation.position, state,
+           static_cast<size_t>(mutation.getLength()));
   }
-
-  return sequence_str;
 }
 
-void cmaple::Alignment::writeMAPLE(std::ostream& aln_stream) {
+void cmaple::Alignment::writeMAPLE(std::ostream& aln_stream,
+                                   const bool compress) {
   assert(data.size() > 0);
-    
-  // write reference sequence to the output file
-  aln_stream << ">" << REF_NAME << endl;
-  aln_stream << getRefSeqStr() << endl;
 
-  // Write sequences one by one
-  const std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
-  Sequence* sequence = &data.front();
-  for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i, ++sequence) {
-    // write the sequence name
-    aln_stream << ">" << sequence->seq_name << endl;
+  // Render the sequences in blocks (the first one starts with the reference
+  // sequence), in parallel, and write the blocks in order
+  const std::vector<size_t> block_starts =
+      splitIntoBlocks(data.size(), [this](const size_t i) {
+        return data[i].seq_name.size() + 2 + 12 * data[i].size();
+      });
+  writeBlocksInOrder(
+      aln_stream, block_starts.size() - 1,
+      [&](const size_t block, std::string& buffer) {
+        if (!block) {
+          buffer += ">";
+          buffer += REF_NAME;
+          buffer += '\n';
+          buffer += getRefSeqStr();
+          buffer += '\n';
+        }
 
-    // write mutations
-    Mutation* mutation = &sequence->front();
-    for (std::vector<cmaple::Mutation>::size_type j = 0; j < sequence->size(); ++j, ++mutation) {
-      const StateType type = mutation->type;
-      aln_stream << cmaple::Alignment::convertState2Char(type, seq_type_) << "\t"
-          << (mutation->position + 1);
-      if (type == TYPE_N || type == TYPE_DEL) {
-          aln_stream << "\t" << mutation->getLength();
-      }
-      aln_stream << endl;
-    }
-  }
+        for (size_t i = block_starts[block]; i < block_starts[block + 1];
+             ++i) {
+          const Sequence& sequence = data[i];
+          // write the sequence name
+          buffer += '>';
+          buffer += sequence.seq_name;
+          buffer += '\n';
+
+          // write mutations
+          for (const Mutation& mutation : sequence) {
+            const StateType type = mutation.type;
+            buffer += cmaple::Alignment::convertState2Char(type, seq_type_);
+            buffer += '\t';
+            appendInt(buffer, mutation.position + 1);
+            if (type == TYPE_N || type == TYPE_DEL) {
+              buffer += '\t';
+              appendInt(buffer, mutation.getLength());
+            }
+            buffer += '\n';
+          }
+        }
+      },
+      compress);
 }
 
-void cmaple::Alignment::writeFASTA(std::ostream& aln_stream) {
+void cmaple::Alignment::writeFASTA(std::ostream& aln_stream,
+                                   const bool compress) {
   assert(data.size() > 0);
-    
+
   // Get reference sequence
   const std::string ref_sequence = getRefSeqStr();
 
-  // Write sequences one by one
-  const std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
-  Sequence* sequence = &data.front();
-  for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i, ++sequence) {
-    // write the sequence name
-    aln_stream << ">" << sequence->seq_name << endl;
-
-    // write the sequence
-    aln_stream << getSeqString(ref_sequence, sequence) << std::endl;
-  }
+  // Render the sequences in blocks, in parallel, and write the blocks in
+  // order
+  const std::vector<size_t> block_starts =
+      splitIntoBlocks(data.size(), [&](const size_t i) {
+        return data[i].seq_name.size() + ref_sequence.size() + 3;
+      });
+  writeBlocksInOrder(
+      aln_stream, block_starts.size() - 1,
+      [&](const size_t block, std::string& buffer) {
+        for (size_t i = block_starts[block]; i < block_starts[block + 1];
+             ++i) {
+          // write the sequence name
+          buffer += '>';
+          buffer += data[i].seq_name;
+          buffer += '\n';
+
+          // write the sequence
+          appendSeqString(ref_sequence, data[i], buffer);
+          buffer += '\n';
+        }
+      },
+      compress);
 }
 
-void cmaple::Alignment::writePHYLIP(std::ostream& aln_stream) {
+void cmaple::Alignment::writePHYLIP(std::ostream& aln_stream,
+                                    const bool compress) {
   assert(data.size() > 0);
-    
-  // Write the header <num_seqs> <seq_length>
+
   const std::vector<cmaple::StateType>::size_type seq_length = ref_seq.size();
   const std::vector<cmaple::Sequence>::size_type num_seqs = data.size();
-  aln_stream << num_seqs << "\t" << seq_length << std::endl;
 
   // Get reference sequence
   const std::string ref_sequence = getRefSeqStr();
 
   // Get max length of sequence names
   std::basic_string<char>::size_type max_name_length = 9;
-  Sequence* sequence = &data.front();
-  for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i, ++sequence) {
-    if (sequence->seq_name.length() > max_name_length) {
-      max_name_length = sequence->seq_name.length();
+  for (const Sequence& sequence : data) {
+    if (sequence.seq_name.length() > max_name_length) {
+      max_name_length = sequence.seq_name.length();
     }
   }
 
   // Add one extra space
   ++max_name_length;
 
-  // Write sequences one by one
-  sequence = &data.front();
-  for (std::vector<cmaple::Sequence>::size_type i = 0; i < num_seqs; ++i, ++sequence) {
-    // write the sequence name
-    std::string seq_name = sequence->seq_name;
-    seq_name.resize(max_name_length, ' ');
-    aln_stream << seq_name;
+  // Render the sequences in blocks (the first one starts with the header
+  // <num_seqs> <seq_length>), in parallel, and write the blocks in order
+  const std::vector<size_t> block_starts =
+      splitIntoBlocks(num_seqs, [&](const size_t) {
+        return max_name_length + seq_length + 1;
+      });
+  writeBlocksInOrder(
+      aln_stream, block_starts.size() - 1,
+      [&](const size_t block, std::string& buffer) {
+        if (!block) {
+          appendInt(buffer, num_seqs);
+          buffer += '\t';
+          appendInt(buffer, seq_length);
+          buffer += '\n';
+        }
 
-    // write the sequence
-    aln_stream << getSeqString(ref_sequence, sequence) << std::endl;
-  }
+        for (size_t i = block_starts[block]; i < block_starts[block + 1];
+             ++i) {
+          // write the sequence name
+          const std::string& seq_name = data[i].seq_name;
+          buffer += seq_name;
+          buffer.append(max_name_length - seq_name.length(), ' ');
+
+          // write the sequence
+          appendSeqString(ref_sequence, data[i], buffer);
+          buffer += '\n';
+        }
+      },
+      compress);
 }
 
 void cmaple::Alignment::readFastaOrPhylip(std::istream& aln_stream,
@@ -1348,6 +2485,14 @@ void cmaple::Alignment::readFastaOrPhylip(std::istream& aln_stream,
   if (aln_format == IN_UNKNOWN) {
     throw std::logic_error("Unknown alignment format");
   }
+  // FASTA files can be converted on the fly without keeping the sequences
+  if (aln_format == IN_FASTA &&
+      aln_stream.rdbuf()->pubseekoff(0, ios::cur, ios::in) !=
+          std::streampos(-1)) {
+    readFastaStreaming(aln_stream, n_ref_seq);
+    return;
+  }
+
   StrVector sequences;
   StrVector seq_names;
   readSequences(aln_stream, sequences, seq_names, aln_format);
@@ -1390,76 +2535,177 @@ void cmaple::Alignment::readFastaOrPhylip(std::istream& aln_stream,
   extractMutations(sequences, seq_names, ref_sequence);
 }
 
-auto cmaple::Alignment::detectSequenceType(StrVector& sequences)
-    -> cmaple::SeqRegion::SeqType {
-  size_t num_nuc = 0;
-  size_t num_ungap = 0;
-  size_t num_bin = 0;
-  size_t num_alpha = 0;
-  size_t num_digit = 0;
-  double detectStart = getRealTime();
-  size_t sequenceCount = sequences.size();
-  assert(sequenceCount > 0);
-
-  // #pragma omp parallel for
-  // reduction(+:num_nuc,num_ungap,num_bin,num_alpha,num_digit)
-  for (size_t seqNum = 0; seqNum < sequenceCount; ++seqNum) {
-    auto start = sequences.at(seqNum).data();
-    auto stop = start + sequences.at(seqNum).size();
-    for (auto i = start; i != stop; ++i) {
-      if ((*i) == 'A' || (*i) == 'C' || (*i) == 'G' || (*i) == 'T' ||
-          (*i) == 'U') {
-        ++num_nuc;
-        ++num_ungap;
-        continue;
-      }
-      if ((*i) == '?' || (*i) == '-' || (*i) == '.') {
-        continue;
+void cmaple::Alignment::readFastaStreaming(std::istream& aln_stream,
+                                           const std::string& n_ref_seq) {
+  // remove the failbit
+  aln_stream.exceptions(ios::badbit);
+
+  // 1st pass: read the names, validate the lengths, detect the sequence type
+  // and count the characters at each site (to generate the reference)
+  const cmaple::SeqRegion::SeqType current_seq_type = getSeqType();
+  const bool detect_seq_type =
+      current_seq_type == cmaple::SeqRegion::SEQ_AUTO ||
+      current_seq_type == cmaple::SeqRegion::SEQ_UNKNOWN;
+  const bool count_chars = !n_ref_seq.length();
+  SeqTypeCounter seq_type_counter;
+  std::vector<PositionType> char_counts;
+  StrVector seq_names;
+  std::string seq_name;
+  std::string sequence;
+  std::string::size_type seq_length = 0;
+  std::vector<std::string>::size_type diff_length_seq = 0;
+  PositionType line_num = 0;
+  while (readFastaSeq(aln_stream, seq_name, sequence, line_num)) {
+    if (seq_names.empty()) {
+      seq_length = sequence.length();
+      if (count_chars) {
+        char_counts.resize(seq_length * NUM_SEQ_CHARS, 0);
       }
-      if (*i != 'N' && *i != 'X' && (*i) != '~') {
-        num_ungap++;
-        if (isdigit(*i)) {
-          num_digit++;
-          if ((*i) == '0' || (*i) == '1') {
-            num_bin++;
-          }
-        }
+    } else if (sequence.length() != seq_length) {
+      // report it (by the shortened name) after validating the number of
+      // sequences, as readFasta() would do
+      if (!diff_length_seq) {
+        diff_length_seq = seq_names.size();
       }
-      if (isalpha(*i)) {
-        num_alpha++;
+      sequence.resize(seq_length, '-');
+    }
+    seq_names.push_back(std::move(seq_name));
+
+    if (detect_seq_type) {
+      seq_type_counter.count(sequence);
+    }
+    if (count_chars) {
+      PositionType* site_counts = char_counts.data();
+      for (const char c : sequence) {
+        ++site_counts[getCharIndex(c)];
+        site_counts += NUM_SEQ_CHARS;
       }
     }
-  }  // end OMP parallel for
+  }
+  resetStream(aln_stream);
 
-  if (verbose_mode >= VB_DEBUG) {
-    cout << "Sequence Type detection took " << (getRealTime() - detectStart)
-         << " seconds." << endl;
+  if (seq_names.size() < MIN_NUM_TAXA) {
+    throw std::logic_error("There must be at least " +
+                           convertIntToString(MIN_NUM_TAXA) + " sequences");
+  }
+  shortenSeqNames(seq_names);
+  if (diff_length_seq) {
+    throw std::logic_error(
+        "Sequence " + seq_names[diff_length_seq] +
+        " has a different length compared to the first sequence.");
+  }
+
+  // detect the type of the input sequences
+  if (detect_seq_type) {
+    setSeqType(seq_type_counter.detect());
+  }
+
+  // generate reference sequence from the counts (if the user doesn't supply
+  // it)
+  string ref_sequence =
+      count_chars ? generateRefFromCounts(
+                        aln_stream, char_counts,
+                        static_cast<PositionType>(seq_names.size()),
+                        static_cast<PositionType>(seq_length))
+                  : n_ref_seq;
+  char_counts = std::vector<PositionType>();
+
+  // parse ref_sequence into vector of states
+  parseRefSeq(ref_sequence, false);
+
+  assert(ref_sequence.length() > 0);
+
+  // 2nd pass: extract the mutations of each sequence as soon as it's read
+  data.clear();
+  data.reserve(seq_names.size());
+  line_num = 0;
+  for (std::string& name : seq_names) {
+    readFastaSeq(aln_stream, seq_name, sequence, line_num);
+    extractMutations(sequence, name, ref_sequence);
+  }
+
+  // set the failbit again
+  aln_stream.exceptions(ios::failbit | ios::badbit);
+  resetStream(aln_stream);
+}
+
+auto cmaple::Alignment::generateRefFromCounts(
+    std::istream& aln_stream,
+    std::vector<PositionType>& char_counts,
+    const PositionType num_seqs,
+    const PositionType seq_length) -> std::string {
+  assert(num_seqs > 0);
+  assert(seq_length > 0);
+
+  if (!num_seqs || !seq_length) {
+    throw std::logic_error("Empty input sequences. Please check & try again!");
   }
-  if (static_cast<double>(num_nuc) / num_ungap > 0.9) {
-    if (cmaple::verbose_mode >= cmaple::VB_DEBUG) {
-      std::cout << "DNA data detected." << std::endl;
+
+  if (cmaple::verbose_mode >= cmaple::VB_MAX) {
+    cout << "Generating a reference sequence from the input alignment..."
+         << endl;
+  }
+
+  // init dummy variables
+  const char NULL_CHAR = '\0';
+  string ref_str(static_cast<std::string::size_type>(seq_length), NULL_CHAR);
+  const char DEFAULT_CHAR = cmaple::Alignment::convertState2Char(0, seq_type_);
+  const PositionType threshold = getRefThreshold(static_cast<size_t>(num_seqs));
+
+  std::vector<PositionType> tied_sites;
+  for (PositionType i = 0; i < seq_length; ++i) {
+    const size_t pos = static_cast<size_t>(i);
+    ref_str[pos] = pickRefChar(char_counts.data() + pos * NUM_SEQ_CHARS,
+                               threshold, DEFAULT_CHAR);
+    if (ref_str[pos] == NULL_CHAR) {
+      tied_sites.push_back(i);
     }
-    return cmaple::SeqRegion::SEQ_DNA;
   }
-  /*if (((double)num_bin) / num_ungap > 0.9)
-  {
-      if (cmaple::verbose_mode >= cmaple::VB_DEBUG)
-          std::cout << "Binary data detected." << std::endl;
-      return SEQ_BINARY;
-  }*/
-  if ((static_cast<double>(num_alpha) + num_nuc) / num_ungap > 0.9) {
-    if (cmaple::verbose_mode >= cmaple::VB_DEBUG) {
-      std::cout << "Protein data detected." << std::endl;
+
+  // break ties by browsing the sequences again (in the same order as
+  // generateRef())
+  if (tied_sites.size()) {
+    for (const PositionType site : tied_sites) {
+      std::fill_n(char_counts.begin() + static_cast<std::ptrdiff_t>(site) *
+                                            NUM_SEQ_CHARS,
+                  NUM_SEQ_CHARS, 0);
+    }
+
+    std::string seq_name;
+    std::string sequence;
+    PositionType line_num = 0;
+    while (readFastaSeq(aln_stream, seq_name, sequence, line_num)) {
+      for (const PositionType site : tied_sites) {
+        const size_t pos = static_cast<size_t>(site);
+        const char c = sequence[pos];
+        if (ref_str[pos] == NULL_CHAR && c != '-' &&
+            ++char_counts[pos * NUM_SEQ_CHARS + getCharIndex(c)] >=
+                threshold) {
+          ref_str[pos] = c;
+        }
+      }
     }
-    return cmaple::SeqRegion::SEQ_PROTEIN;
+    resetStream(aln_stream);
   }
-  /*if (((double)(num_alpha + num_digit + num_nuc)) / num_ungap > 0.9)
-  {
-      if (cmaple::verbose_mode >= cmaple::VB_DEBUG)
-          std::cout << "Morphological data detected." << std::endl;
-      return SEQ_MORPH;
-  }*/
-  return cmaple::SeqRegion::SEQ_UNKNOWN;
+
+  return ref_str;
+}
+
+auto cmaple::Alignment::detectSequenceType(StrVector& sequences)
+    -> cmaple::SeqRegion::SeqType {
+  double detectStart = getRealTime();
+  assert(sequences.size() > 0);
+
+  SeqTypeCounter counter;
+  for (const std::string& sequence : sequences) {
+    counter.count(sequence);
+  }
+
+  if (verbose_mode >= VB_DEBUG) {
+    cout << "Sequence Type detection took " << (getRealTime() - detectStart)
+         << " seconds." << endl;
+  }
+  return counter.detect();
 }
 
 void cmaple::Alignment::updateNumStates() {
@@ -1531,6 +2777,16 @@ auto cmaple::Alignment::detectMAPLEorFASTA(std::istream& aln_stream)
 
 auto cmaple::Alignment::detectInputFile(std::istream& aln_stream)
     -> cmaple::Alignment::InputType {
+  // the binary format starts by its magic bytes
+  char magic[sizeof(BINARY_MAGIC)];
+  const std::streamsize num_read =
+      aln_stream.rdbuf()->sgetn(magic, sizeof(BINARY_MAGIC));
+  resetStream(aln_stream);
+  if (num_read == sizeof(BINARY_MAGIC) &&
+      !memcmp(magic, BINARY_MAGIC, sizeof(BINARY_MAGIC))) {
+    return cmaple::Alignment::IN_BINARY;
+  }
+
   unsigned char ch = ' ';
   unsigned char ch2 = ' ';
   int count = 0;
@@ -1574,6 +2830,9 @@ auto cmaple::Alignment::parseAlnFormat(const std::string& n_format)
   if (format == "FASTA") {
     return cmaple::Alignment::IN_FASTA;
   }
+  if (format == "BINARY") {
+    return cmaple::Alignment::IN_BINARY;
+  }
   if (format == "AUTO") {
     return cmaple::Alignment::IN_AUTO;
   }
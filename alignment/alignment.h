@@ -1,5 +1,6 @@
 #include "../utils/timeutil.h"
 #include "sequence.h"
+#include <string_view>
 
 #ifndef CMAPLE_ALIGNMENT_H
 #define CMAPLE_ALIGNMENT_H
@@ -16,6 +17,8 @@ class Alignment {
     IN_PHYLIP,  /*!< PHYLIP format */
     IN_MAPLE,   /*!< [MAPLE](https://www.nature.com/articles/s41588-023-01368-0)
                    format */
+    IN_BINARY,  /*!< Compact binary format of CMAPLE (a packed reference and
+                   the mutations of each sequence, indexed per sequence) */
     IN_AUTO,    /*!< Auto detect */
     IN_UNKNOWN, /*!< Unknown format */
   };
@@ -120,17 +123,21 @@ class Alignment {
    * [MAPLE](https://www.nature.com/articles/s41588-023-01368-0) format
    * @param[in] aln_stream A stream of the output alignment file
    * @param[in] format Format of the output alignment (optional): IN_MAPLE,
-   * IN_FASTA, or IN_PHYLIP
+   * IN_FASTA, IN_PHYLIP, or IN_BINARY
+   * @param[in] compress TRUE to compress the output with gzip (optional)
    * @throw std::invalid\_argument if the format is unknown
    * @throw std::logic\_error if the alignment is empty (i.e., nothing to write)
    */
-  void write(std::ostream& aln_stream, const InputType& format = IN_MAPLE);
+  void write(std::ostream& aln_stream,
+             const InputType& format = IN_MAPLE,
+             const bool compress = false);
 
   /** \brief Write the alignment to a file in FASTA, PHYLIP, or
    * [MAPLE](https://www.nature.com/articles/s41588-023-01368-0) format
-   * @param[in] aln_filename Name of the output alignment file
+   * @param[in] aln_filename Name of the output alignment file, which is
+   * compressed with gzip if its name ends with ".gz"
    * @param[in] format Format of the output alignment (optional): IN_MAPLE,
-   * IN_FASTA, or IN_PHYLIP
+   * IN_FASTA, IN_PHYLIP, or IN_BINARY
    * @param[in] overwrite TRUE to overwrite the existing output file (optional)
    * @throw std::invalid\_argument if any of the following situations occur.
    * - aln_filename is empty
@@ -191,6 +198,15 @@ class Alignment {
    */
   static InputType parseAlnFormat(const std::string& n_format);
 
+  /**
+   Find the sequences that are identical to (i.e., have the same mutations
+   as) an earlier sequence in data. Sequences are grouped by a hash of their
+   mutations, then compared with the first sequence of their group
+   @return for each sequence, the index of the first sequence identical to
+   it (its own index if there is none)
+   */
+  std::vector<cmaple::NumSeqsType> findIdenticalSeqs() const;
+
   /**
    A vector stores all sequences
    */
@@ -252,7 +268,8 @@ class Alignment {
 
   /**
    Sort sequences by their distances to the reference genome
-   distance = num_differents * hamming_weight + num_ambiguities
+   distance = num_differents * hamming_weight + num_ambiguities; sequences at
+   the same distance keep their order (the sort is stable)
 
    @throw std::logic\_error if the sequences contain an invalid type (R)
    */
@@ -279,6 +296,90 @@ class Alignment {
                         const cmaple::StrVector& seq_names,
                         const std::string& ref_sequence);
 
+  /**
+   Extract Mutation from a sequence regarding the reference sequence and add
+   the resulting Sequence to data
+   @param str_sequence the sequence
+   @param seq_name the sequence name
+   @param ref_sequence the reference sequence
+   @throw std::logic\_error if any of the following situations occur.
+   - the length of the sequence is different from that of the reference genome
+   - the sequence contains invalid states
+   */
+  void extractMutations(const std::string& str_sequence,
+                        const std::string& seq_name,
+                        const std::string& ref_sequence);
+
+  /**
+   Read an alignment from a stream (see read())
+   @param[in] aln_filename Name of the alignment file of aln_stream (if any):
+   an alignment in MAPLE format is then read from the memory-mapped file
+   instead of the stream
+   */
+  void readStream(std::istream& aln_stream,
+                  const std::string& ref_seq,
+                  const InputType format,
+                  const cmaple::SeqRegion::SeqType seqtype,
+                  const std::string& aln_filename);
+
+  /**
+   Read an alignment in MAPLE format from a memory-mapped file. The records
+   are split into chunks (at '>' boundaries), which are parsed in parallel
+   and then concatenated in their original order.
+   @param aln_filename Name of an alignment file
+   @throw std::logic\_error if any of the following situations occur.
+   - the alignment is empty or in an incorrect format
+   - the sequences contain invalid states
+   */
+  void readMapleMapped(const std::string& aln_filename);
+
+  /**
+   Parse the reference sequence of a MAPLE file (and detect the sequence type
+   from it if it is not specified yet)
+   @param ref_line the line of the reference sequence
+   @throw std::logic\_error if the sequence contains invalid states
+   */
+  void parseMapleRef(std::string& ref_line);
+
+  /**
+   Parse a line "<Type> <Position> [<Length>]" of a MAPLE file and add the
+   mutation to mutations
+   @param line the line (without its line ending)
+   @param line_num the number of the line (for error messages)
+   @throw std::logic\_error if the line is in an incorrect format
+   */
+  void parseMapleMutation(const std::string_view line,
+                          const cmaple::PositionType line_num,
+                          std::vector<Mutation>& mutations);
+
+  /**
+   Parse the records (names and mutations) between begin and end in a MAPLE
+   file; begin must be the start of a record (except for the first chunk)
+   @param line_num the number of the line at begin (for error messages)
+   @param sequences the sequences to add the records to
+   @throw std::logic\_error if the records are in an incorrect format
+   */
+  void parseMapleRecords(const char* begin,
+                         const char* const end,
+                         cmaple::PositionType line_num,
+                         std::vector<Sequence>& sequences);
+
+  /**
+   Check that a reference and enough sequences were read from a MAPLE (or
+   binary) file
+   @throw std::logic\_error otherwise
+   */
+  void validateMapleData() const;
+
+  /**
+   Read an alignment in the binary format (see writeBinary()); the sequences
+   are decoded in parallel
+   @param begin, end the content of the alignment file
+   @throw std::logic\_error if the content is not a (supported version of
+   the) binary format or is corrupted
+   */
+  void readBinary(const char* const begin, const char* const end);
+
   /**
    Read an alignment in MAPLE format from a stream
    @param aln_stream A stream of an alignment file
@@ -300,6 +401,63 @@ class Alignment {
   void readFastaOrPhylip(std::istream& aln_stream,
                          const std::string& ref_seq = "");
 
+  /**
+   Read an alignment in FASTA format from a (seekable) stream without keeping
+   the full sequences in memory. A first pass counts the characters at each
+   site (to generate the reference if it's not given) and detects the
+   sequence type; a second pass converts each sequence into mutations as soon
+   as it's read. Peak memory is thus proportional to the number of mutations
+   rather than to the number of sequences times the genome length.
+   @param aln_stream A stream of an alignment file
+   @param[in] ref_seq The reference sequence
+   @throw std::logic\_error if any of the following situations occur.
+   - the alignment is empty or in an incorrect format
+   - the sequences contain invalid states
+   */
+  void readFastaStreaming(std::istream& aln_stream,
+                          const std::string& ref_seq = "");
+
+  /**
+   Generate a reference genome from the numbers of times each character
+   appears at each site, following the same rules as generateRef()
+   @param aln_stream A stream of the alignment (to break ties, see below)
+   @param char_counts the number of times each character appears at each
+   site (a fixed number of entries per site); reused when breaking ties
+   @param num_seqs the number of sequences
+   @param seq_length the length of the sequences
+   @return a reference genome
+
+   generateRef() picks the first non-gap character that appears in half of
+   the sequences. If several characters do so at a site, the stream is read
+   again to find the one that reaches the threshold first.
+   */
+  std::string generateRefFromCounts(std::istream& aln_stream,
+                                    std::vector<cmaple::PositionType>& char_counts,
+                                    const cmaple::PositionType num_seqs,
+                                    const cmaple::PositionType seq_length);
+
+  /**
+   Read the next sequence from a stream of an alignment in FASTA format
+   @param aln_stream A stream of the alignment
+   @param[out] seq_name the name of the sequence
+   @param[out] sequence the sequence
+   @param[in,out] line_num the number of lines read so far
+   @return FALSE if no sequence is left
+
+   @throw std::logic\_error if the alignment is in an incorrect format
+   */
+  bool readFastaSeq(std::istream& aln_stream,
+                    std::string& seq_name,
+                    std::string& sequence,
+                    cmaple::PositionType& line_num);
+
+  /**
+   Cut down the names of the sequences (at the first space) if it doesn't
+   make them ambiguous
+   @param[in,out] seq_names the names of the sequences
+   */
+  void shortenSeqNames(cmaple::StrVector& seq_names);
+
   /**
    Parse the reference sequence into vector of state
    @param ref_sequence reference genome in string
@@ -379,20 +537,40 @@ class Alignment {
   /**
    Write alignment in MAPLE format
    @param[in] aln_stream A stream of the output alignment file
+   @param[in] compress TRUE to compress the output with gzip
+   */
+  void writeMAPLE(std::ostream& aln_stream, const bool compress = false);
+
+  /**
+   Write alignment in the binary format (version BINARY_VERSION), i.e., the
+   following parts (integers are little-endian):
+   - a header: magic bytes, version, sequence type, number of states, the
+   states of the mutations (each mutation then stores its index in that
+   list), the length of the reference, the number of sequences, and the
+   sizes of the names and the records, and the size of the offsets;
+   - the reference, bit-packed;
+   - an index: the offsets of the name and the record of each sequence;
+   - the names (a string table);
+   - the records: the number of mutations, their positions as varint
+   (zigzag) deltas, their bit-packed states, and the lengths of N/- regions
+   @param[in] aln_stream A stream of the output alignment file
+   @param[in] compress TRUE to compress the output with gzip
    */
-  void writeMAPLE(std::ostream& aln_stream);
+  void writeBinary(std::ostream& aln_stream, const bool compress = false);
 
   /**
    Write alignment in FASTA format
    @param[in] aln_stream A stream of the output alignment file
+   @param[in] compress TRUE to compress the output with gzip
    */
-  void writeFASTA(std::ostream& aln_stream);
+  void writeFASTA(std::ostream& aln_stream, const bool compress = false);
 
   /**
    Write alignment in PHYLIP format
    @param[in] aln_stream A stream of the output alignment file
+   @param[in] compress TRUE to compress the output with gzip
    */
-  void writePHYLIP(std::ostream& aln_stream);
+  void writePHYLIP(std::ostream& aln_stream, const bool compress = false);
 
   /**
    Get reference sequence in string
@@ -400,9 +578,12 @@ class Alignment {
   auto getRefSeqStr() -> std::string;
 
   /**
-   Get a sequence in string
+   Append a sequence in string to a buffer: a copy of the reference (in
+   string) patched at the positions of the mutations
    */
-  auto getSeqString(const std::string& ref_seq_str, Sequence* sequence) -> std::string;
+  void appendSeqString(const std::string& ref_seq_str,
+                       const Sequence& sequence,
+                       std::string& buffer) const;
 
   /**
   Detect the format of input file in MAPLE or FASTA format
@@ -420,6 +601,7 @@ class Alignment {
       IN_FASTA if in fasta format,
       IN_PHYLIP if in phylip format,
       IN_MAPLE if in MAPLE format,
+      IN_BINARY if in the binary format,
       IN_UNKNOWN if file format unknown.
    */
   InputType detectInputFile(std::istream& aln_stream);
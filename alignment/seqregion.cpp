@@ -6,9 +6,262 @@
 //
 
 #include "seqregion.h"
+#include <atomic>
+#include <cassert>
 #include <iomanip>
+#include <type_traits>
 using namespace cmaple;
 
+namespace {
+/**
+ A freed likelihood array, linked into a free list. The first array of a
+ batch also links the next batch in the shared pool
+ */
+struct FreeLH {
+  FreeLH* next;
+  FreeLH* next_batch;
+};
+
+/**
+ The free list of likelihood arrays of a thread. It is trivially
+ destructible so that it remains usable after the thread-local releaser has
+ run (e.g. when a tree is destroyed during the static destruction)
+ */
+struct LHFreeList {
+  FreeLH* head = nullptr;
+  size_t size = 0;
+  bool released = false;
+};
+
+/**
+ The batches of freed likelihood arrays shared by all threads, so that the
+ arrays freed by one thread can be reused by another one (e.g. when a thread
+ deletes the regions created by other threads). Like LHFreeList, it is
+ trivially destructible.
+ */
+struct SharedLHPool {
+  std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  FreeLH* batches = nullptr;
+  size_t num_batches = 0;
+  bool released = false;
+};
+
+/**
+ The number of likelihood arrays moved at once between a thread and the
+ shared pool
+ */
+constexpr size_t LH_BATCH_SIZE = 1 << 10;
+
+/**
+ The maximum number of freed likelihood arrays kept by a thread; beyond it,
+ a batch is returned to the shared pool
+ */
+constexpr size_t MAX_FREE_LHS = 4 * LH_BATCH_SIZE;
+
+/**
+ The maximum number of batches kept by the shared pool; beyond it, the
+ arrays are returned to the system
+ */
+constexpr size_t MAX_SHARED_LH_BATCHES = 64;
+
+static_assert(sizeof(FreeLH) <= sizeof(SeqRegion::LHType),
+              "A likelihood array must be able to hold a FreeLH");
+
+thread_local LHFreeList lh_free_list;
+SharedLHPool shared_lh_pool;
+
+/**
+ Lock the shared pool while in scope
+ */
+class SharedLHPoolLock {
+ public:
+  SharedLHPoolLock() {
+    while (shared_lh_pool.lock.test_and_set(std::memory_order_acquire)) {
+    }
+  }
+  ~SharedLHPoolLock() { shared_lh_pool.lock.clear(std::memory_order_release); }
+};
+
+/**
+ Return a list of likelihood arrays to the system
+ */
+void deleteLHs(FreeLH* head) {
+  while (head) {
+    FreeLH* const next = head->next;
+    ::operator delete(head);
+    head = next;
+  }
+}
+
+/**
+ Move a batch of likelihood arrays into the shared pool, or return them to
+ the system if the pool is full
+ */
+void returnLHBatch(FreeLH* const batch) {
+  {
+    SharedLHPoolLock pool_lock;
+    if (!shared_lh_pool.released &&
+        shared_lh_pool.num_batches < MAX_SHARED_LH_BATCHES) {
+      batch->next_batch = shared_lh_pool.batches;
+      shared_lh_pool.batches = batch;
+      ++shared_lh_pool.num_batches;
+      return;
+    }
+  }
+  deleteLHs(batch);
+}
+
+/**
+ Take a batch of likelihood arrays from the shared pool
+ @return nullptr if the pool is empty
+ */
+FreeLH* takeLHBatch() {
+  SharedLHPoolLock pool_lock;
+  FreeLH* const batch = shared_lh_pool.batches;
+  if (batch) {
+    shared_lh_pool.batches = batch->next_batch;
+    --shared_lh_pool.num_batches;
+  }
+  return batch;
+}
+
+/**
+ Cut a batch of LH_BATCH_SIZE arrays from the head of the free list of this
+ thread
+ */
+FreeLH* cutLHBatch() {
+  assert(lh_free_list.size >= LH_BATCH_SIZE);
+  FreeLH* const batch = lh_free_list.head;
+  FreeLH* last = batch;
+  for (size_t i = 1; i < LH_BATCH_SIZE; ++i) {
+    last = last->next;
+  }
+  lh_free_list.head = last->next;
+  lh_free_list.size -= LH_BATCH_SIZE;
+  last->next = nullptr;
+  return batch;
+}
+
+/**
+ Return the cached likelihood arrays of a thread to the shared pool (in full
+ batches) or to the system when the thread exits
+ */
+struct LHFreeListReleaser {
+  ~LHFreeListReleaser() {
+    while (lh_free_list.size >= LH_BATCH_SIZE) {
+      returnLHBatch(cutLHBatch());
+    }
+    deleteLHs(lh_free_list.head);
+    lh_free_list.head = nullptr;
+    lh_free_list.size = 0;
+    lh_free_list.released = true;
+  }
+};
+
+/**
+ Return the arrays of the shared pool to the system at exit
+ */
+struct SharedLHPoolReleaser {
+  ~SharedLHPoolReleaser() {
+    SharedLHPoolLock pool_lock;
+    while (shared_lh_pool.batches) {
+      FreeLH* const next_batch = shared_lh_pool.batches->next_batch;
+      deleteLHs(shared_lh_pool.batches);
+      shared_lh_pool.batches = next_batch;
+    }
+    shared_lh_pool.num_batches = 0;
+    shared_lh_pool.released = true;
+  }
+};
+
+thread_local LHFreeListReleaser lh_free_list_releaser;
+SharedLHPoolReleaser shared_lh_pool_releaser;
+}  // namespace
+
+void* cmaple::SeqRegion::LHType::operator new(std::size_t size) {
+  if (size == sizeof(LHType)) {
+    // refill the free list of this thread from the shared pool
+    if (!lh_free_list.head && !lh_free_list.released) {
+      lh_free_list.head = takeLHBatch();
+      if (lh_free_list.head) {
+        // make sure the releaser of this thread is constructed
+        (void)&lh_free_list_releaser;
+        lh_free_list.size = LH_BATCH_SIZE;
+      }
+    }
+    if (lh_free_list.head) {
+      FreeLH* const free_lh = lh_free_list.head;
+      lh_free_list.head = free_lh->next;
+      --lh_free_list.size;
+      return free_lh;
+    }
+  }
+  return ::operator new(size);
+}
+
+void cmaple::SeqRegion::LHType::operator delete(void* ptr,
+                                                std::size_t size) noexcept {
+  if (!ptr) {
+    return;
+  }
+  if (size != sizeof(LHType) || lh_free_list.released) {
+    ::operator delete(ptr);
+    return;
+  }
+  // make sure the releaser of this thread is constructed
+  (void)&lh_free_list_releaser;
+  FreeLH* const free_lh = static_cast<FreeLH*>(ptr);
+  free_lh->next = lh_free_list.head;
+  lh_free_list.head = free_lh;
+  ++lh_free_list.size;
+
+  // return a batch to the shared pool
+  if (lh_free_list.size > MAX_FREE_LHS) {
+    returnLHBatch(cutLHBatch());
+  }
+}
+
+void cmaple::SeqRegion::LHType::releaseAll(SeqRegion* begin,
+                                           SeqRegion* const end) noexcept {
+  static_assert(std::is_trivially_destructible<LHType>::value,
+                "A likelihood array must be releasable without destruction");
+  // after the thread exit, the regions delete their arrays one by one
+  if (lh_free_list.released) {
+    return;
+  }
+
+  // chain the arrays of the regions
+  FreeLH* head = nullptr;
+  FreeLH* tail = nullptr;
+  size_t num_lhs = 0;
+  for (; begin != end; ++begin) {
+    LHType* const lh = begin->likelihood.release();
+    if (lh) {
+      FreeLH* const free_lh = static_cast<FreeLH*>(static_cast<void*>(lh));
+      free_lh->next = head;
+      head = free_lh;
+      if (!tail) {
+        tail = free_lh;
+      }
+      ++num_lhs;
+    }
+  }
+  if (!head) {
+    return;
+  }
+
+  // splice the chain into the free list of this thread (making sure the
+  // releaser of this thread is constructed), then return the excess to the
+  // shared pool
+  (void)&lh_free_list_releaser;
+  tail->next = lh_free_list.head;
+  lh_free_list.head = head;
+  lh_free_list.size += num_lhs;
+  while (lh_free_list.size > MAX_FREE_LHS) {
+    returnLHBatch(cutLHBatch());
+  }
+}
+
 cmaple::SeqRegion::SeqRegion(StateType n_type,
                              PositionType n_position,
                              RealNumType n_plength_observation,
@@ -5,14 +5,47 @@
 #include <memory>  // for unique_ptr
 
 namespace cmaple {
+/*! \cond PRIVATE */
+/**
+    Type of the entries of likelihood vectors (single precision for the
+    targets built with USE_FLOAT_LH). The products written by the merge
+    kernels are computed in double and normalized right away, so a float
+    entry only underflows if the whole unnormalized vector sums to less than
+    getMinCarryOver<float>() (1e-36); such a vector is treated like an
+    underflow to zero (see checkLhUnderflow)
+ */
+#ifdef USE_FLOAT_LH
+typedef float LhNumType;
+#else
+typedef RealNumType LhNumType;
+#endif
+/*! \endcond */
+
 /** A class represents a region in a sequence */
 class SeqRegion : public Mutation {
  public:
   /*! \cond PRIVATE */
   /*!
-      Type of likelihood
-   */
-  using LHType = std::array<cmaple::RealNumType, NUM_STATES>;
+      Type of likelihood. Heap-allocated instances are recycled through a
+      per-thread free list (see operator new/delete) since O regions are
+      created and destroyed at a high rate during placement and SPR searches
+   */
+  struct LHType : public std::array<cmaple::LhNumType, NUM_STATES> {
+    /*!
+        Allocate a likelihood array, reusing one freed by the current thread
+        if available
+     */
+    static void* operator new(std::size_t size);
+    /*!
+        Release a likelihood array into the free list of the current thread
+     */
+    static void operator delete(void* ptr, std::size_t size) noexcept;
+    /*!
+        Release the likelihood arrays of the regions [begin, end) into the
+        free list of the current thread at once (see ~SeqRegions())
+     */
+    static void releaseAll(SeqRegion* begin, SeqRegion* end) noexcept;
+  };
   /*!
       Type of likelihood pointer
    */
@@ -412,54 +412,6 @@ void cmaple::merge_identicalRACGT_TwoLowers(
   }
 }
 
-void cmaple::calSiteLhs_identicalRACGT(std::vector<RealNumType>&site_lh_contributions,
-                               const SeqRegion& seq1_region,
-                               const PositionType end_pos,
-                               RealNumType total_blength_1,
-                               RealNumType total_blength_2,
-                               const PositionType pos,
-                               const RealNumType threshold_prob,
-                               const ModelBase* model,
-                               const RealNumType* const cumulative_rate,
-                               RealNumType& log_lh,
-                               SeqRegions& merged_regions) {
-  assert(seq1_region.type != TYPE_N && seq1_region.type != TYPE_O);
-  assert(model);
-  assert(cumulative_rate);
-    
-  // add a new region and try to merge consecutive R regions together
-  cmaple::SeqRegions::addNonConsecutiveRRegion(merged_regions, seq1_region.type,
-                                               -1, -1, end_pos, threshold_prob);
-
-  // compute the (site) lh contributions
-  // convert total_blength_1 and total_blength_2 to zero if they are -1
-  if (total_blength_1 < 0) {
-    total_blength_1 = 0;
-  }
-  if (total_blength_2 < 0) {
-    total_blength_2 = 0;
-  }
-
-  RealNumType total_blength = total_blength_1 + total_blength_2;
-  if (seq1_region.type == TYPE_R) {
-    log_lh +=
-        total_blength * (cumulative_rate[end_pos + 1] - cumulative_rate[pos]);
-
-    // compute site lh contributions
-    for (PositionType i = pos; i < end_pos + 1; ++i) {
-      site_lh_contributions[static_cast<std::vector<RealNumType>
-                            ::size_type>(i)] += total_blength
-        * (cumulative_rate[i + 1] - cumulative_rate[i]);
-    }
-  } else {
-    log_lh += model->diagonal_mut_mat[seq1_region.type] * total_blength;
-
-    // compute site lh contributions
-    site_lh_contributions[static_cast<std::vector<RealNumType>::size_type>(pos)] +=
-        model->diagonal_mut_mat[seq1_region.type] * total_blength;
-  }
-}
-
 auto cmaple::SeqRegions::operator==(const SeqRegions& seqregions_1) const
     -> bool {
   if (size() != seqregions_1.size()) {
@@ -504,7 +456,7 @@ void cmaple::SeqRegions::addNonConsecutiveRRegion(
                        plength_observation2root);
 }
 
-auto cmaple::SeqRegions::simplifyO(cmaple::RealNumType* const partial_lh,
+auto cmaple::SeqRegions::simplifyO(cmaple::LhNumType* const partial_lh,
                                    cmaple::StateType ref_state,
                                    cmaple::StateType num_states,
                                    cmaple::RealNumType threshold)
@@ -25,6 +25,136 @@ static constexpr DoubleState RO = (DoubleState(TYPE_R) << 8) | TYPE_O;
 static constexpr DoubleState OO = (DoubleState(TYPE_O) << 8) | TYPE_O;
 static constexpr DoubleState ON = (DoubleState(TYPE_O) << 8) | TYPE_N;
 
+/** Number of occurrences of each state in the reference genome before every
+ *  position, stored as one flat (genome length + 1) x num_states table
+ */
+class CumulativeBase {
+ public:
+  /**
+   Recompute the table from a reference genome
+   */
+  void compute(const std::vector<cmaple::StateType>& ref_seq,
+               const cmaple::StateType num_states) {
+    num_states_ = num_states;
+    counts_.assign((ref_seq.size() + 1) * num_states, 0);
+    PositionType* row = counts_.data();
+    for (const cmaple::StateType state : ref_seq) {
+      PositionType* const next_row = row + num_states;
+      std::copy(row, next_row, next_row);
+      ++next_row[state];
+      row = next_row;
+    }
+  }
+
+  /**
+   Check whether the table has not been computed yet
+   */
+  bool empty() const { return counts_.empty(); }
+
+  /**
+   Get the counts of all states in the reference genome before a position
+   */
+  const cmaple::PositionType* getCounts(const cmaple::PositionType pos) const {
+    assert(static_cast<size_t>(pos) * num_states_ < counts_.size());
+    return counts_.data() + static_cast<size_t>(pos) * num_states_;
+  }
+
+  /**
+   Get the number of occurrences of a state in the reference genome before a
+   position
+   */
+  cmaple::PositionType count(const cmaple::PositionType pos,
+                             const cmaple::StateType state) const {
+    return getCounts(pos)[state];
+  }
+
+ private:
+  std::vector<cmaple::PositionType> counts_;
+  cmaple::StateType num_states_ = 0;
+};
+
+/** The site-lh contribution (or its change) at a site
+ */
+struct SiteLhDiff {
+  cmaple::PositionType position;
+  cmaple::RealNumType delta;
+};
+
+/**
+ Add a site-lh contribution into a dense vector of site lhs (one per site)
+ */
+inline void addSiteLh(std::vector<cmaple::RealNumType>& site_lhs,
+                      const cmaple::PositionType pos,
+                      const cmaple::RealNumType lh) {
+  assert(static_cast<size_t>(pos) < site_lhs.size());
+  site_lhs[static_cast<std::vector<cmaple::RealNumType>::size_type>(pos)] +=
+      lh;
+}
+
+/**
+ Add the site-lh contributions blength * (the rate of the site) over a run
+ of sites [start, end] into a dense vector of site lhs
+ */
+inline void addRSiteLhs(std::vector<cmaple::RealNumType>& site_lhs,
+                        const cmaple::PositionType start,
+                        const cmaple::PositionType end,
+                        const cmaple::RealNumType blength,
+                        const cmaple::RealNumType* const cumulative_rate) {
+  for (PositionType i = start; i < end + 1; ++i) {
+    addSiteLh(site_lhs, i,
+              blength * (cumulative_rate[i + 1] - cumulative_rate[i]));
+  }
+}
+
+/** Site-lh contributions collected sparsely while walking regions: the
+ *  contributions at single sites, and the runs of sites (of R regions) whose
+ *  contributions are blength * (the rate of the site). Both are kept in the
+ *  order the regions are walked.
+ */
+struct SparseSiteLhs {
+  /**
+   A run of sites [start, end] contributing blength * (the rate of the site)
+   */
+  struct RRun {
+    cmaple::PositionType start;
+    cmaple::PositionType end;
+    cmaple::RealNumType blength;
+  };
+
+  std::vector<SiteLhDiff> sites;
+  std::vector<RRun> r_runs;
+
+  void clear() {
+    sites.clear();
+    r_runs.clear();
+  }
+};
+
+/**
+ Append a (non-zero) site-lh contribution to sparse site lhs
+ */
+inline void addSiteLh(SparseSiteLhs& site_lhs,
+                      const cmaple::PositionType pos,
+                      const cmaple::RealNumType lh) {
+  if (lh != 0) {
+    site_lhs.sites.push_back({pos, lh});
+  }
+}
+
+/**
+ Append a run of sites [start, end] contributing blength * (the rate of the
+ site) to sparse site lhs
+ */
+inline void addRSiteLhs(SparseSiteLhs& site_lhs,
+                        const cmaple::PositionType start,
+                        const cmaple::PositionType end,
+                        const cmaple::RealNumType blength,
+                        const cmaple::RealNumType* const /*cumulative_rate*/) {
+  if (blength != 0) {
+    site_lhs.r_runs.push_back({start, end, blength});
+  }
+}
+
 /** Vector of sequence regions, used to represent/compute partial/total
  *  likelihood
  */
@@ -47,6 +177,12 @@ class SeqRegions : public std::vector<SeqRegion> {
   /// Move Assignment
   SeqRegions& operator=(SeqRegions&& regions) = default;
 
+  /**
+   *  Regions destructor: the likelihood arrays of the O regions are
+   *  returned to the free list of the current thread in one pass
+   */
+  ~SeqRegions() { SeqRegion::LHType::releaseAll(data(), data() + size()); }
+
   /**
    Add a new region and automatically merged consecutive R regions
    @throw std::logic\_error if unexpected values/behaviors found during the
@@ -177,13 +313,14 @@ class SeqRegions : public std::vector<SeqRegion> {
    @param aln the alignment
    @param model the model of evolution
    @param threshold the threshold for approximation
-   @param return_log_lh TRUE to return the log likelihood
+   @param site_lh_contributions the site-lh contributions, added into a dense
+   vector or appended to SparseSiteLhs (see addSiteLh(), addRSiteLhs())
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
-  template <const cmaple::StateType num_states>
+  template <const cmaple::StateType num_states, typename SiteLhs>
   cmaple::RealNumType calculateSiteLhContributions(
-      std::vector<cmaple::RealNumType>& site_lh_contributions,
+      SiteLhs& site_lh_contributions,
       std::unique_ptr<SeqRegions>& merged_regions,
       const cmaple::RealNumType plength1,
       const SeqRegions& regions2,
@@ -211,7 +348,7 @@ class SeqRegions : public std::vector<SeqRegion> {
   template <const cmaple::StateType num_states>
   cmaple::RealNumType computeAbsoluteLhAtRoot(
       const ModelBase* model,
-      const std::vector<std::vector<PositionType>>& cumulative_base);
+      const CumulativeBase& cumulative_base);
 
   /**
    Compute the site likelihood at root by merging the lower lh with root
@@ -221,13 +358,29 @@ class SeqRegions : public std::vector<SeqRegion> {
   cmaple::RealNumType computeSiteLhAtRoot(
       std::vector<cmaple::RealNumType>& site_lh_contributions,
       const ModelBase* model,
-      const std::vector<std::vector<PositionType>>& cumulative_base);
+      const CumulativeBase& cumulative_base);
+
+  /**
+   Compute the changes of the site likelihoods at root when the lower lh at
+   root changes from old_regions to these regions, only walking the sites
+   where the two lower lhs differ
+   @param[out] site_lh_diff the non-zero changes, sorted by position
+   @param old_site_lhs the site likelihoods of old_regions at root (computed
+   by computeSiteLhAtRoot())
+   */
+  template <const cmaple::StateType num_states>
+  void computeSiteLhDiffAtRoot(
+      std::vector<SiteLhDiff>& site_lh_diff,
+      const std::vector<cmaple::RealNumType>& old_site_lhs,
+      const SeqRegions& old_regions,
+      const ModelBase* model,
+      const CumulativeBase& cumulative_base) const;
 
   /**
    Convert an entry 'O' into a normal nucleotide if its probability dominated
    others
    */
-  static cmaple::StateType simplifyO(cmaple::RealNumType* const partial_lh,
+  static cmaple::StateType simplifyO(cmaple::LhNumType* const partial_lh,
                                      cmaple::StateType ref_state,
                                      cmaple::StateType num_states,
                                      cmaple::RealNumType threshold);
@@ -557,12 +710,16 @@ auto updateLHwithModel(const ModelBase* model,
   assert(model);
     
   RealNumType sum_lh = 0;
-  RealNumType* mutation_mat_row = model->mutation_mat;
-  for (StateType i = 0; i < num_states; ++i, mutation_mat_row += num_states) {
+  RealNumType mut_lhs[num_states];
+  if (total_blength > 0) {  // TODO: avoid
+    matrixVectorProduct<num_states>(model->mutation_mat, prior.data(),
+                                    mut_lhs);
+  }
+  for (StateType i = 0; i < num_states; ++i) {
     RealNumType tot = 0;
     if (total_blength > 0)  // TODO: avoid
     {
-      tot += dotProduct<num_states>(&(prior)[0], mutation_mat_row);
+      tot += mut_lhs[i];
 
       tot *= total_blength;
     }
@@ -582,9 +739,11 @@ auto updateLHwithMat(const RealNumType* mat_row,
   assert(mat_row);
     
   RealNumType sum_lh = 0;
-  for (StateType i = 0; i < num_states; ++i, mat_row += num_states) {
+  RealNumType mut_lhs[num_states];
+  matrixVectorProduct<num_states>(mat_row, prior.data(), mut_lhs);
+  for (StateType i = 0; i < num_states; ++i) {
     RealNumType tot = 0;
-    tot += dotProduct<num_states>(&(prior)[0], mat_row);
+    tot += mut_lhs[i];
 
     tot *= total_blength;
     tot += prior[i];
@@ -602,11 +761,15 @@ auto updateMultLHwithMat(const RealNumType* mat_row,
   assert(mat_row);
     
   RealNumType sum_lh = 0;
-  for (StateType i = 0; i < num_states; ++i, mat_row += num_states) {
+  RealNumType mut_lhs[num_states];
+  if (total_blength > 0) {  // TODO: avoid
+    matrixVectorProduct<num_states>(mat_row, prior.data(), mut_lhs);
+  }
+  for (StateType i = 0; i < num_states; ++i) {
     RealNumType tot = 0;
     if (total_blength > 0)  // TODO: avoid
     {
-      tot += dotProduct<num_states>(&(prior)[0], mat_row);
+      tot += mut_lhs[i];
 
       tot *= total_blength;
     }
@@ -614,7 +777,7 @@ auto updateMultLHwithMat(const RealNumType* mat_row,
     posterior[i] *= tot;
     sum_lh += posterior[i];
   }
-  return sum_lh;
+  return checkLhUnderflow<num_states>(posterior.data(), sum_lh);
 }
 
 template <const StateType num_states>
@@ -848,8 +1011,8 @@ void merge_RACGT_ORACGT(const SeqRegion& seq1_region,
       length_to_root += upper_plength;
     }
     SeqRegion::LHType root_vec;
-    memcpy(root_vec.data(), model->root_freqs,
-           sizeof(RealNumType) * num_states);
+    std::copy(model->root_freqs, model->root_freqs + num_states,
+              root_vec.data());
 
     RealNumType* transposed_mut_mat_row =
         model->transposed_mut_mat + model->row_index[seq1_state];
@@ -1486,7 +1649,7 @@ RealNumType SeqRegions::mergeTwoLowers(
 template <const StateType num_states>
 auto SeqRegions::computeAbsoluteLhAtRoot(
     const ModelBase* model,
-    const std::vector<std::vector<PositionType>>& cumulative_base)
+    const CumulativeBase& cumulative_base)
     -> RealNumType {
   assert(model);
   assert(size() > 0);
@@ -1501,10 +1664,13 @@ auto SeqRegions::computeAbsoluteLhAtRoot(
   for (const SeqRegion& region : regions) {
     // type R
     if (region.type == TYPE_R) {
+      const PositionType* const end_counts =
+          cumulative_base.getCounts(region.position + 1);
+      const PositionType* const start_counts =
+          cumulative_base.getCounts(start_pos);
       for (StateType i = 0; i < num_states; ++i) {
         log_lh += model->root_log_freqs[i] *
-                  (cumulative_base[static_cast<size_t>(region.position) + 1][i] -
-                   cumulative_base[static_cast<size_t>(start_pos)][i]);
+                  (end_counts[i] - start_counts[i]);
       }
     }
     // type ACGT
@@ -1544,7 +1710,7 @@ template <const StateType num_states>
 RealNumType SeqRegions::computeSiteLhAtRoot(
     std::vector<RealNumType>& site_lh_contributions,
     const ModelBase* model,
-    const std::vector<std::vector<PositionType>>& cumulative_base) {
+    const CumulativeBase& cumulative_base) {
   assert(model);
   assert(size() > 0);
     
@@ -1558,19 +1724,22 @@ RealNumType SeqRegions::computeSiteLhAtRoot(
   for (const SeqRegion& region : regions) {
     // type R
     if (region.type == TYPE_R) {
+      const PositionType* const end_counts =
+          cumulative_base.getCounts(region.position + 1);
+      const PositionType* const start_counts =
+          cumulative_base.getCounts(start_pos);
       for (StateType i = 0; i < num_states; ++i) {
         log_lh += model->root_log_freqs[i] *
-                  (cumulative_base[static_cast<size_t>(region.position) + 1][i] -
-                   cumulative_base[static_cast<size_t>(start_pos)][i]);
+                  (end_counts[i] - start_counts[i]);
       }
 
       // calculate site lhs
       for (PositionType pos = start_pos; pos < region.position + 1; ++pos) {
+        const PositionType* const pos_counts = cumulative_base.getCounts(pos);
+        const PositionType* const next_counts = pos_counts + num_states;
         for (StateType i = 0; i < num_states; ++i) {
           site_lh_contributions[static_cast<std::vector<RealNumType>::size_type>(pos)] +=
-              model->root_log_freqs[i] *
-              (cumulative_base[static_cast<size_t>(pos) + 1][i] -
-               cumulative_base[static_cast<size_t>(pos)][i]);
+              model->root_log_freqs[i] * (next_counts[i] - pos_counts[i]);
         }
       }
     }
@@ -1692,7 +1861,78 @@ void SeqRegions::computeTotalLhAtRoot(std::unique_ptr<SeqRegions>& total_lh,
   }
 }
 
-void calSiteLhs_identicalRACGT(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states>
+void SeqRegions::computeSiteLhDiffAtRoot(
+    std::vector<SiteLhDiff>& site_lh_diff,
+    const std::vector<RealNumType>& old_site_lhs,
+    const SeqRegions& old_regions,
+    const ModelBase* model,
+    const CumulativeBase& cumulative_base) const {
+  assert(model);
+  assert(size() > 0);
+  assert(old_regions.size() > 0);
+
+  // dummy variables
+  const SeqRegions& regions = *this;
+  const PositionType seq_length =
+      static_cast<PositionType>(old_site_lhs.size());
+  PositionType pos = 0;
+  size_t iseq1 = 0;
+  size_t iseq2 = 0;
+  site_lh_diff.clear();
+
+  while (pos < seq_length) {
+    PositionType end_pos;
+
+    // get the next shared segment in the two sequences
+    cmaple::SeqRegions::getNextSharedSegment(pos, regions, old_regions, iseq1,
+                                             iseq2, end_pos);
+    const SeqRegion& region = regions[iseq1];
+    const SeqRegion& old_region = old_regions[iseq2];
+    // ACGT/O regions contribute to their first site only
+    const PositionType start_pos =
+        iseq1 > 0 ? regions[iseq1 - 1].position + 1 : 0;
+    const PositionType old_start_pos =
+        iseq2 > 0 ? old_regions[iseq2 - 1].position + 1 : 0;
+
+    // the site lhs only change where the two regions differ
+    if (region.type != old_region.type ||
+        (region.type != TYPE_R && region.type != TYPE_N &&
+         (start_pos != old_start_pos ||
+          (region.type == TYPE_O &&
+           *region.likelihood != *old_region.likelihood)))) {
+      for (PositionType i = pos; i <= end_pos; ++i) {
+        // the same site lh as computeSiteLhAtRoot()
+        RealNumType site_lh = 0;
+        if (region.type == TYPE_R) {
+          const PositionType* const pos_counts = cumulative_base.getCounts(i);
+          const PositionType* const next_counts = pos_counts + num_states;
+          for (StateType j = 0; j < num_states; ++j) {
+            site_lh +=
+                model->root_log_freqs[j] * (next_counts[j] - pos_counts[j]);
+          }
+        } else if (i == start_pos && region.type < num_states) {
+          site_lh = model->root_log_freqs[region.type];
+        } else if (i == start_pos && region.type == TYPE_O) {
+          site_lh = log(dotProduct<num_states>(&(*region.likelihood)[0],
+                                               model->root_freqs));
+        }
+
+        const RealNumType delta =
+            site_lh -
+            old_site_lhs[static_cast<std::vector<RealNumType>::size_type>(i)];
+        if (delta != 0) {
+          site_lh_diff.push_back({i, delta});
+        }
+      }
+    }
+
+    pos = end_pos + 1;
+  }
+}
+
+template <typename SiteLhs>
+void calSiteLhs_identicalRACGT(SiteLhs& site_lh_contributions,
                                const SeqRegion& seq1_region,
                                const PositionType end_pos,
                                RealNumType total_blength_1,
@@ -1702,10 +1942,43 @@ void calSiteLhs_identicalRACGT(std::vector<RealNumType>& site_lh_contributions,
                                const ModelBase* model,
                                const RealNumType* const cumulative_rate,
                                RealNumType& log_lh,
-                               SeqRegions& merged_regions);
+                               SeqRegions& merged_regions) {
+  assert(seq1_region.type != TYPE_N && seq1_region.type != TYPE_O);
+  assert(model);
+  assert(cumulative_rate);
+    
+  // add a new region and try to merge consecutive R regions together
+  cmaple::SeqRegions::addNonConsecutiveRRegion(merged_regions, seq1_region.type,
+                                               -1, -1, end_pos, threshold_prob);
 
-template <const StateType num_states>
-inline void addSimplifyOAndCalSiteLh(std::vector<RealNumType>& site_lh_contributions,
+  // compute the (site) lh contributions
+  // convert total_blength_1 and total_blength_2 to zero if they are -1
+  if (total_blength_1 < 0) {
+    total_blength_1 = 0;
+  }
+  if (total_blength_2 < 0) {
+    total_blength_2 = 0;
+  }
+
+  RealNumType total_blength = total_blength_1 + total_blength_2;
+  if (seq1_region.type == TYPE_R) {
+    log_lh +=
+        total_blength * (cumulative_rate[end_pos + 1] - cumulative_rate[pos]);
+
+    // compute site lh contributions
+    addRSiteLhs(site_lh_contributions, pos, end_pos, total_blength,
+                cumulative_rate);
+  } else {
+    log_lh += model->diagonal_mut_mat[seq1_region.type] * total_blength;
+
+    // compute site lh contributions
+    addSiteLh(site_lh_contributions, pos,
+              model->diagonal_mut_mat[seq1_region.type] * total_blength);
+  }
+}
+
+template <const StateType num_states, typename SiteLhs>
+inline void addSimplifyOAndCalSiteLh(SiteLhs& site_lh_contributions,
     RealNumType& log_lh, SeqRegion::LHType& new_lh, RealNumType& sum_lh,
     const PositionType end_pos, const Alignment* aln, const RealNumType threshold_prob,
     std::unique_ptr<SeqRegions>& merged_regions)
@@ -1718,12 +1991,11 @@ inline void addSimplifyOAndCalSiteLh(std::vector<RealNumType>& site_lh_contribut
     // compute (site) lh contributions
     RealNumType lh_contribution = log(sum_lh);
     log_lh += lh_contribution;
-    site_lh_contributions[static_cast<std::vector<RealNumType>
-                        ::size_type>(end_pos)] += lh_contribution;
+    addSiteLh(site_lh_contributions, end_pos, lh_contribution);
 }
 
-template <const StateType num_states>
-bool calSiteLhs_O_O(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_O_O(SiteLhs& site_lh_contributions,
                     const SeqRegion& seq2_region,
                     RealNumType total_blength_2,
                     const PositionType end_pos,
@@ -1755,8 +2027,8 @@ bool calSiteLhs_O_O(std::vector<RealNumType>& site_lh_contributions,
   return true;
 }
 
-template <const StateType num_states>
-bool calSiteLhs_O_RACGT(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_O_RACGT(SiteLhs& site_lh_contributions,
                         const SeqRegion& seq2_region,
                         RealNumType total_blength_2,
                         const PositionType end_pos,
@@ -1800,16 +2072,15 @@ bool calSiteLhs_O_RACGT(std::vector<RealNumType>& site_lh_contributions,
     // compute (site) lh contributions
     RealNumType lh_contribution = log(new_lh[seq2_state]);
     log_lh += lh_contribution;
-    site_lh_contributions[static_cast<std::vector<RealNumType>
-                        ::size_type>(end_pos)] += lh_contribution;
+    addSiteLh(site_lh_contributions, end_pos, lh_contribution);
   }
 
   // no error
   return true;
 }
 
-template <const StateType num_states>
-bool calSiteLhs_O_ORACGT(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_O_ORACGT(SiteLhs& site_lh_contributions,
                          const SeqRegion& seq1_region,
                          const SeqRegion& seq2_region,
                          RealNumType total_blength_1,
@@ -1854,8 +2125,8 @@ bool calSiteLhs_O_ORACGT(std::vector<RealNumType>& site_lh_contributions,
   return true;
 }
 
-template <const StateType num_states>
-bool calSiteLhs_RACGT_O(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_RACGT_O(SiteLhs& site_lh_contributions,
                         const SeqRegion& seq2_region,
                         RealNumType total_blength_2,
                         const PositionType end_pos,
@@ -1887,8 +2158,8 @@ bool calSiteLhs_RACGT_O(std::vector<RealNumType>& site_lh_contributions,
   return true;
 }
 
-template <const StateType num_states>
-bool calSiteLhs_RACGT_RACGT(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_RACGT_RACGT(SiteLhs& site_lh_contributions,
                             const SeqRegion& seq2_region,
                             RealNumType total_blength_2,
                             const PositionType end_pos,
@@ -1927,16 +2198,15 @@ bool calSiteLhs_RACGT_RACGT(std::vector<RealNumType>& site_lh_contributions,
     // compute (site) lh contributions
     RealNumType lh_contribution = log(new_lh[seq2_state]);
     log_lh += lh_contribution;
-    site_lh_contributions[static_cast<std::vector<RealNumType>
-                            ::size_type>(end_pos)] += lh_contribution;
+    addSiteLh(site_lh_contributions, end_pos, lh_contribution);
   }
 
   // no error
   return true;
 }
 
-template <const StateType num_states>
-bool calSiteLhs_RACGT_ORACGT(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_RACGT_ORACGT(SiteLhs& site_lh_contributions,
                              const SeqRegion& seq1_region,
                              const SeqRegion& seq2_region,
                              RealNumType total_blength_1,
@@ -1984,8 +2254,8 @@ bool calSiteLhs_RACGT_ORACGT(std::vector<RealNumType>& site_lh_contributions,
       threshold_prob, *new_lh, sum_lh, log_lh, merged_regions);
 }
 
-template <const StateType num_states>
-bool calSiteLhs_notN_notN(std::vector<RealNumType>& site_lh_contributions,
+template <const StateType num_states, typename SiteLhs>
+bool calSiteLhs_notN_notN(SiteLhs& site_lh_contributions,
                           const SeqRegion& seq1_region,
                           const SeqRegion& seq2_region,
                           const RealNumType plength1,
@@ -2054,9 +2324,9 @@ bool calSiteLhs_notN_notN(std::vector<RealNumType>& site_lh_contributions,
   return true;
 }
 
-template <const StateType num_states>
+template <const StateType num_states, typename SiteLhs>
 RealNumType SeqRegions::calculateSiteLhContributions(
-    std::vector<RealNumType>& site_lh_contributions,
+    SiteLhs& site_lh_contributions,
     std::unique_ptr<SeqRegions>& merged_regions,
     const RealNumType plength1,
     const SeqRegions& regions2,
@@ -2077,7 +2347,6 @@ RealNumType SeqRegions::calculateSiteLhContributions(
   size_t iseq1 = 0;
   size_t iseq2 = 0;
   const PositionType seq_length = static_cast<PositionType>(aln->ref_seq.size());
-  assert(site_lh_contributions.size() == seq_length);
 
   // init merged_regions
   if (merged_regions) {
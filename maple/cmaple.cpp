@@ -142,8 +142,15 @@ void cmaple::runCMAPLE(cmaple::Params &params)
             return;
         }
         
-        // Initialize a Tree
-        Tree tree(&aln, &model, params.input_treefile, params.fixed_blengths, cmaple::make_unique<cmaple::Params>(params));
+        // Initialize a Tree (from the checkpoint if resuming)
+        if (params.resume && !params.checkpoint_file.length()) {
+          throw std::invalid_argument("Please specify the checkpoint file (-ckp <FILE>) to resume from");
+        }
+        const bool resume = params.resume && fileExists(params.checkpoint_file);
+        Tree tree(&aln, &model, resume ? "" : params.input_treefile, params.fixed_blengths, cmaple::make_unique<cmaple::Params>(params));
+        if (resume) {
+          tree.loadCheckpoint(params.checkpoint_file);
+        }
         
         // Infer a phylogenetic tree
         const cmaple::Tree::TreeSearchType tree_search_type = cmaple::Tree::parseTreeSearchType(params.tree_search_type_str);
@@ -175,7 +182,7 @@ void cmaple::runCMAPLE(cmaple::Params &params)
         
         // Write the normal tree file
         ofstream out = ofstream(output_treefile);
-        out << tree.exportNewick(tree_format);
+        tree.exportNewick(out, tree_format);
         out.close();
         
         // output log-likelihood of the tree
@@ -0,0 +1,106 @@
+# Generate the constexpr tables of the built-in protein models from their
+# NEXUS definitions, so that the models need not be parsed at runtime
+# Usage: cmake -DINPUT=model_aa.nexus -DOUTPUT=model_aa_tables.h -P generate_model_aa_tables.cmake
+
+file(READ "${INPUT}" nexus)
+
+# remove the comments, and protect the semicolons (list separators in CMake)
+string(REGEX REPLACE "\\[[^]]*\\]" "" nexus "${nexus}")
+string(REPLACE ";" "|" nexus "${nexus}")
+
+string(REGEX MATCHALL "model[ \t\r\n]+[^ \t\r\n=]+[ \t\r\n]*=[^|]*" models "${nexus}")
+if(NOT models)
+    message(FATAL_ERROR "No model found in ${INPUT}")
+endif()
+
+set(arrays "")
+set(entries "")
+foreach(model ${models})
+    string(REGEX MATCH "model[ \t\r\n]+([^ \t\r\n=]+)[ \t\r\n]*=(.*)" _ "${model}")
+    set(name "${CMAKE_MATCH_1}")
+    string(REGEX MATCHALL "[^ \t\r\n]+" numbers "${CMAKE_MATCH_2}")
+    list(LENGTH numbers num_numbers)
+
+    # reversible models: the lower triangle of the exchangeabilities;
+    # non-reversible ones: the full rate matrix; then the state frequencies
+    if(num_numbers EQUAL 210)
+        set(reversible "true")
+        set(num_rates 190)
+    elseif(num_numbers EQUAL 420)
+        set(reversible "false")
+        set(num_rates 400)
+    else()
+        message(FATAL_ERROR "Model ${name} has ${num_numbers} parameters (expecting 210 or 420)")
+    endif()
+
+    # write the numbers as floating-point literals (as parsed at runtime)
+    set(values "")
+    foreach(number ${numbers})
+        if(NOT number MATCHES "^[-+]?([0-9]+\\.?[0-9]*|\\.[0-9]+)([eE][-+]?[0-9]+)?$")
+            message(FATAL_ERROR "Model ${name}: invalid number ${number}")
+        endif()
+        if(number MATCHES "^[-+]?[0-9]+$")
+            set(number "${number}.0")
+        endif()
+        list(APPEND values "${number}")
+    endforeach()
+    list(SUBLIST values 0 ${num_rates} rates)
+    list(SUBLIST values ${num_rates} 20 freqs)
+    list(JOIN rates ", " rates)
+    list(JOIN freqs ", " freqs)
+
+    string(MAKE_C_IDENTIFIER "${name}" id)
+    string(APPEND arrays
+        "constexpr double ${id}_RATES[${num_rates}] = {${rates}};\n"
+        "constexpr double ${id}_FREQS[20] = {${freqs}};\n\n")
+    string(APPEND entries "    {\"${name}\", ${reversible}, builtin_aa::${id}_RATES,\n     builtin_aa::${id}_FREQS},\n")
+endforeach()
+
+set(content
+"// Generated from model_aa.nexus by generate_model_aa_tables.cmake: do not edit
+#pragma once
+
+namespace cmaple {
+/** A built-in (empirical) protein model */
+struct BuiltinAAModel {
+  /**
+   Name of the model
+   */
+  const char* name;
+
+  /**
+   TRUE if the model is reversible: rates then holds the lower triangle of
+   the exchangeabilities (row by row); otherwise the full rate matrix
+   */
+  bool reversible;
+
+  /**
+   The rates (190 entries if reversible, 400 otherwise)
+   */
+  const double* rates;
+
+  /**
+   The (20) state frequencies
+   */
+  const double* freqs;
+};
+
+namespace builtin_aa {
+${arrays}}  // namespace builtin_aa
+
+/**
+ The built-in protein models, in the order of model_aa.nexus
+ */
+constexpr BuiltinAAModel builtin_aa_models[] = {
+${entries}};
+}  // namespace cmaple
+")
+
+# only touch the output if it changes
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" old_content)
+    if(old_content STREQUAL content)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${content}")
@@ -6,8 +6,6 @@
 
 namespace cmaple
 {
-    extern const char* builtin_prot_models;
-
     /** Class of AA evolutionary models */
     class ModelAA: public ModelBase
     {
@@ -307,11 +307,31 @@ ModelsBlock* cmaple::ModelBase::readModelsDefinition(
 }
 
 void cmaple::ModelBase::readRates(istream& in, const bool is_reversible) {
+  // reversible models: the lower triangle of the exchangeabilities;
+  // non-reversible models: the whole rate matrix
+  const StateType num_rates =
+      is_reversible ? num_states_ * (num_states_ - 1) / 2
+                    : num_states_ * num_states_;
+  std::vector<RealNumType> rates(num_rates);
+  for (RealNumType& rate : rates) {
+    string tmp_value;
+    in >> tmp_value;
+    if (!tmp_value.length()) {
+      throw getModelName() + ": Rate entries could not be read";
+    }
+    rate = convert_real_number(tmp_value.c_str());
+  }
+
+  setRates(rates.data(), is_reversible);
+}
+
+void cmaple::ModelBase::setRates(const RealNumType* rates,
+                                 const bool is_reversible) {
   StateType row = 1;
   StateType col = 0;
   StateType row_id = num_states_;
   if (is_reversible) {
-    const StateType nrates = 190;
+    const StateType nrates = num_states_ * (num_states_ - 1) / 2;
     // since states for protein is stored in lower-triangle, special treatment
     // is needed
     for (StateType i = 0; i < nrates; i++, col++) {
@@ -325,35 +345,19 @@ void cmaple::ModelBase::readRates(istream& in, const bool is_reversible) {
 
       // don't switch the row and col
       int id = row_id + col;
-      /*if (id >= nrates) {
-          cout << row << " " << col << endl;
-      }
-      assert(id < nrates && id >= 0); // make sure that the conversion is
-      correct*/
-
-      string tmp_value;
-      in >> tmp_value;
-      if (!tmp_value.length()) {
-        throw getModelName() + ": Rate entries could not be read";
-      }
-      mutation_mat[id] = convert_real_number(tmp_value.c_str());
+      mutation_mat[id] = rates[i];
 
       if (mutation_mat[id] < 0.0) {
         throw "Negative rates found";
       }
     }
   } else {
-    // non-reversible model, read the whole rate matrix
+    // non-reversible model, the whole rate matrix
     RealNumType* mutation_mat_ptr = mutation_mat;
     for (row = 0; row < num_states_; row++) {
       RealNumType row_sum = 0.0;
-      for (col = 0; col < num_states_; col++, ++mutation_mat_ptr) {
-        string tmp_value;
-        in >> tmp_value;
-        if (!tmp_value.length()) {
-          throw getModelName() + ": Rate entries could not be read";
-        }
-        mutation_mat_ptr[0] = convert_real_number(tmp_value.c_str());
+      for (col = 0; col < num_states_; col++, ++mutation_mat_ptr, ++rates) {
+        mutation_mat_ptr[0] = rates[0];
 
         if (mutation_mat_ptr[0] < 0.0 && row != col) {
           throw "Negative rates found";
@@ -382,15 +386,37 @@ bool cmaple::ModelBase::readParametersString(string& model_str) {
   return is_reversible;
 }
 
+void cmaple::ModelBase::setParameters(const RealNumType* rates,
+                                      const RealNumType* freqs,
+                                      const bool is_reversible) {
+  try {
+    setRates(rates, is_reversible);
+    setStateFreqs(freqs);
+  } catch (const char* str) {
+    throw std::logic_error(str);
+  } catch (const std::string& str) {
+    throw std::logic_error(str);
+  }
+}
+
 void cmaple::ModelBase::readStateFreq(istream& in) {
-  StateType i;
-  for (i = 0; i < num_states_; i++) {
+  std::vector<RealNumType> freqs(num_states_);
+  for (RealNumType& freq : freqs) {
     string tmp_value;
     in >> tmp_value;
     if (!tmp_value.length()) {
       throw "State frequencies could not be read";
     }
-    root_freqs[i] = convert_real_number(tmp_value.c_str());
+    freq = convert_real_number(tmp_value.c_str());
+  }
+
+  setStateFreqs(freqs.data());
+}
+
+void cmaple::ModelBase::setStateFreqs(const RealNumType* freqs) {
+  StateType i;
+  for (i = 0; i < num_states_; i++) {
+    root_freqs[i] = freqs[i];
     if (root_freqs[i] < 0.0) {
       throw "Negative state frequencies found";
     }
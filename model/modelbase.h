@@ -33,6 +33,13 @@ class ModelBase {
    */
   void readStateFreq(std::istream& in);
 
+  /**
+   Set root state frequencies (normalized if they do not sum to 1)
+   @param[in] freqs The state frequencies
+   @throw const char* if any frequency is negative
+   */
+  void setStateFreqs(const RealNumType* freqs);
+
   /**
    Update the mutation rate matrix regarding the pseu_mutation_count
 
@@ -73,6 +80,25 @@ class ModelBase {
    */
   void readRates(std::istream& in, const bool is_reversible);
 
+  /**
+   Set model's rates
+   @param[in] rates The lower triangle of the exchangeabilities (row by row)
+   if is_reversible; otherwise the full rate matrix
+   @throw const char* or std::string if the rates are invalid
+   */
+  void setRates(const RealNumType* rates, const bool is_reversible);
+
+  /**
+   Set the parameters (rates and state frequencies) of a built-in model,
+   without parsing its definition
+   @param[in] rates The rates (see setRates())
+   @param[in] freqs The state frequencies
+   @throw std::logic\_error if the parameters are invalid
+   */
+  void setParameters(const RealNumType* rates,
+                     const RealNumType* freqs,
+                     const bool is_reversible);
+
   /**
    Normalize the Q matrix so that the expected number of subtitution is 1
    @throw std::logic\_error if the Q matrix is empty
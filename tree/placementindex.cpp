@@ -0,0 +1,227 @@
+#include "placementindex.h"
+
+#include <algorithm>
+#include <stack>
+
+using namespace cmaple;
+
+void cmaple::PlacementIndex::build(std::vector<PhyloNode>& nodes,
+                                   const NumSeqsType root_vector_index,
+                                   const StateType num_states,
+                                   const std::vector<StateType>& ref_seq) {
+  num_states_ = num_states;
+  clades_.clear();
+  mutation_positions_.clear();
+  num_defining_mutations_.assign(nodes.size(), 0);
+  reversions_.clear();
+
+  // traverse the tree from the root
+  std::stack<NumSeqsType> node_stack;
+  node_stack.push(root_vector_index);
+  while (!node_stack.empty()) {
+    const NumSeqsType vec_index = node_stack.top();
+    node_stack.pop();
+    PhyloNode& node = nodes[vec_index];
+    if (!node.isInternal()) {
+      continue;
+    }
+    for (const MiniIndex mini_index : {LEFT, RIGHT}) {
+      node_stack.push(node.getNeighborIndex(mini_index).getVectorIndex());
+    }
+
+    // the root doesn't define a clade
+    if (vec_index == root_vector_index) {
+      continue;
+    }
+
+    // compare the states in the lower regions of the node with those of its
+    // parent (only segments where either of them has a concrete state can
+    // differ)
+    const SeqRegions& regions = *node.getPartialLh(TOP);
+    const SeqRegions& parent_regions =
+        *nodes[node.getNeighborIndex(TOP).getVectorIndex()].getPartialLh(TOP);
+    PositionType pos = 0;
+    PositionType end_pos = 0;
+    size_t i1 = 0;
+    size_t i2 = 0;
+    const PositionType seq_length = regions.back().position + 1;
+    uint32_t num_defining_mutations = 0;
+    while (pos < seq_length) {
+      SeqRegions::getNextSharedSegment(pos, regions, parent_regions, i1, i2,
+                                       end_pos);
+      const StateType type = regions[i1].type;
+      const StateType parent_type = parent_regions[i2].type;
+      if (type != parent_type &&
+          (type < num_states || parent_type < num_states)) {
+        for (; pos <= end_pos; ++pos) {
+          const StateType ref_state = ref_seq[static_cast<std::vector<
+              StateType>::size_type>(pos)];
+          const StateType state = type == TYPE_R ? ref_state : type;
+          const StateType parent_state =
+              parent_type == TYPE_R ? ref_state : parent_type;
+          if (state == parent_state) {
+            continue;
+          }
+          // a (non-reference) state gained by the node
+          if (state < num_states && state != ref_state) {
+            clades_[getKey(pos, state)].push_back(vec_index);
+            mutation_positions_.emplace_back(pos, vec_index);
+            ++num_defining_mutations;
+          }
+          // a reversion to the reference state
+          else if (state == ref_state && parent_state < num_states) {
+            reversions_[pos].push_back(vec_index);
+          }
+        }
+      }
+      pos = end_pos + 1;
+    }
+    num_defining_mutations_[vec_index] = num_defining_mutations;
+  }
+  std::sort(mutation_positions_.begin(), mutation_positions_.end());
+}
+
+void cmaple::PlacementIndex::countHits(
+    const Sequence& sequence,
+    std::unordered_map<NumSeqsType, Hits>& hits) const {
+  for (const Mutation& mutation : sequence) {
+    const PositionType end_pos = mutation.position + mutation.getLength();
+    if (mutation.type < num_states_) {
+      for (PositionType pos = mutation.position; pos < end_pos; ++pos) {
+        const auto clades = clades_.find(getKey(pos, mutation.type));
+        if (clades != clades_.end()) {
+          for (const NumSeqsType vec_index : clades->second) {
+            ++hits[vec_index].num_carried;
+          }
+        }
+        const auto reverted_clades = reversions_.find(pos);
+        if (reverted_clades != reversions_.end()) {
+          for (const NumSeqsType vec_index : reverted_clades->second) {
+            ++hits[vec_index].num_reverted;
+          }
+        }
+      }
+    } else {
+      // all defining mutations within a run of unknown states
+      auto it = std::lower_bound(
+          mutation_positions_.begin(), mutation_positions_.end(),
+          std::make_pair(mutation.position, NumSeqsType(0)));
+      for (; it != mutation_positions_.end() && it->first < end_pos; ++it) {
+        ++hits[it->second].num_unknown;
+      }
+    }
+  }
+}
+
+const cmaple::PlacementIndex::Lineage& cmaple::PlacementIndex::getLineage(
+    const NumSeqsType vec_index,
+    const std::unordered_map<NumSeqsType, Hits>& hits,
+    std::unordered_map<NumSeqsType, Lineage>& lineages,
+    const std::vector<PhyloNode>& nodes,
+    const NumSeqsType root_vector_index) const {
+  // walk up to the first node whose lineage is known
+  lineages.emplace(root_vector_index, Lineage());
+  std::vector<NumSeqsType> path;
+  NumSeqsType ancestor = vec_index;
+  for (; !lineages.count(ancestor);
+       ancestor = nodes[ancestor].getNeighborIndex(TOP).getVectorIndex()) {
+    path.push_back(ancestor);
+  }
+
+  // then add the nodes of the path from the top
+  const NumSeqsType num_indexed_nodes =
+      static_cast<NumSeqsType>(num_defining_mutations_.size());
+  Lineage lineage = lineages[ancestor];
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    ++lineage.depth;
+    // skip nodes added after the index was built
+    if (*it < num_indexed_nodes) {
+      // the defining mutations carried (+1) or not (-1) by the sample, and
+      // the reverted mutations carried by the sample (-1)
+      int32_t num_missing =
+          static_cast<int32_t>(num_defining_mutations_[*it]);
+      const auto node_hits = hits.find(*it);
+      if (node_hits != hits.end()) {
+        const Hits& h = node_hits->second;
+        lineage.score += static_cast<int32_t>(h.num_carried) -
+                         static_cast<int32_t>(h.num_reverted);
+        num_missing -= static_cast<int32_t>(h.num_carried + h.num_unknown);
+      }
+      lineage.score -= num_missing;
+    }
+    lineages[*it] = lineage;
+  }
+  return lineages[vec_index];
+}
+
+NumSeqsType cmaple::PlacementIndex::getCommonAncestor(
+    NumSeqsType vec_index1,
+    NumSeqsType vec_index2,
+    const std::unordered_map<NumSeqsType, Lineage>& lineages,
+    const std::vector<PhyloNode>& nodes) {
+  uint32_t depth1 = lineages.at(vec_index1).depth;
+  uint32_t depth2 = lineages.at(vec_index2).depth;
+  for (; depth1 > depth2; --depth1) {
+    vec_index1 = nodes[vec_index1].getNeighborIndex(TOP).getVectorIndex();
+  }
+  for (; depth2 > depth1; --depth2) {
+    vec_index2 = nodes[vec_index2].getNeighborIndex(TOP).getVectorIndex();
+  }
+  while (vec_index1 != vec_index2) {
+    vec_index1 = nodes[vec_index1].getNeighborIndex(TOP).getVectorIndex();
+    vec_index2 = nodes[vec_index2].getNeighborIndex(TOP).getVectorIndex();
+  }
+  return vec_index1;
+}
+
+NumSeqsType cmaple::PlacementIndex::findStartNode(
+    const Sequence& sequence,
+    const std::vector<PhyloNode>& nodes,
+    const NumSeqsType root_vector_index) const {
+  // count the defining mutations of each clade carried by the sample, and
+  // those at positions where the state of the sample is unknown
+  std::unordered_map<NumSeqsType, Hits> hits;
+  countHits(sequence, hits);
+
+  // score the lineage of each clade carrying some of the mutations of the
+  // sample
+  std::unordered_map<NumSeqsType, Lineage> lineages;
+  std::vector<std::pair<int32_t, NumSeqsType>> scores;
+  int32_t best_score = 0;
+  for (const auto& [clade, clade_hits] : hits) {
+    if (!clade_hits.num_carried) {
+      continue;
+    }
+    const int32_t score =
+        getLineage(clade, hits, lineages, nodes, root_vector_index).score;
+    scores.emplace_back(score, clade);
+    best_score = std::max(best_score, score);
+  }
+  if (best_score <= 0) {
+    return root_vector_index;
+  }
+
+  // start from the lowest common ancestor of the clades scoring nearly as
+  // well as the best one, as the scores are only approximate
+  NumSeqsType start_node = root_vector_index;
+  bool found = false;
+  for (const auto& [score, clade] : scores) {
+    if (score < best_score - SCORE_MARGIN) {
+      continue;
+    }
+    start_node = found
+                     ? getCommonAncestor(start_node, clade, lineages, nodes)
+                     : clade;
+    found = true;
+    if (start_node == root_vector_index) {
+      return root_vector_index;
+    }
+  }
+
+  // start from the top of a polytomy, where the mid-branch point is defined
+  while (start_node != root_vector_index &&
+         nodes[start_node].getUpperLength() <= 0) {
+    start_node = nodes[start_node].getNeighborIndex(TOP).getVectorIndex();
+  }
+  return start_node;
+}
@@ -0,0 +1,157 @@
+#include "../alignment/sequence.h"
+#include "phylonode.h"
+
+#include <unordered_map>
+
+#pragma once
+
+namespace cmaple {
+/** An inverted index from the defining mutations of the clades of a tree to
+ * the roots of those clades, used to start the search for the placement of a
+ * sample near the clade it belongs to instead of at the root of the tree.
+ * The defining mutations of an internal node are the non-reference
+ * (position, state) pairs observed in its lower regions but not in those of
+ * its parent; the positions where it reverts to the reference state are
+ * recorded too. As the lower regions are only an approximation of the
+ * ancestral states, the proposals are a heuristic: the search still explores
+ * the whole subtree of the proposed node.
+ */
+class PlacementIndex {
+ public:
+  /**
+   *  Constructor
+   */
+  PlacementIndex() = default;
+
+  /**
+   (Re)build the index from the current tree
+   @param nodes the nodes of the tree
+   @param root_vector_index the vector index of the root
+   @param num_states the number of states
+   @param ref_seq the reference sequence
+   */
+  void build(std::vector<PhyloNode>& nodes,
+             const cmaple::NumSeqsType root_vector_index,
+             const cmaple::StateType num_states,
+             const std::vector<cmaple::StateType>& ref_seq);
+
+  /**
+   Get the number of nodes of the tree when the index was last built
+   */
+  size_t getNumIndexedNodes() const {
+    return num_defining_mutations_.size();
+  }
+
+  /**
+   Propose a node to start the search for the placement of a sample. The
+   lineage of each clade is scored by its agreement with the sample: +1 for
+   each defining mutation carried by the sample, -1 for each one it doesn't
+   carry (unless its state is unknown) and for each reverted mutation it
+   carries. The proposed node is the lowest common ancestor of the clades
+   scoring within SCORE_MARGIN of the best score. Nodes added to the tree
+   after the index was built are never proposed.
+   @param sequence the mutations of the sample
+   @param nodes the nodes of the tree
+   @param root_vector_index the vector index of the current root
+   @return the vector index of the proposed node, or root_vector_index if the
+   index is inconclusive
+   */
+  cmaple::NumSeqsType findStartNode(
+      const Sequence& sequence,
+      const std::vector<PhyloNode>& nodes,
+      const cmaple::NumSeqsType root_vector_index) const;
+
+ private:
+  /**
+   The margin below the best score within which the clades are considered as
+   candidate placements
+   */
+  static constexpr int32_t SCORE_MARGIN = 4;
+
+  /**
+   The numbers of defining mutations of a clade carried by a sample, at
+   positions where the state of the sample is unknown, and of reverted
+   mutations of the clade carried by the sample
+   */
+  struct Hits {
+    uint32_t num_carried = 0;
+    uint32_t num_unknown = 0;
+    uint32_t num_reverted = 0;
+  };
+
+  /**
+   The score of the lineage of a node and the depth of the node
+   */
+  struct Lineage {
+    int32_t score = 0;
+    uint32_t depth = 0;
+  };
+
+  /**
+   Count the defining and reverted mutations of each clade carried by a
+   sample
+   @param sequence the mutations of the sample
+   @param[out] hits the hits of each clade
+   */
+  void countHits(const Sequence& sequence,
+                 std::unordered_map<cmaple::NumSeqsType, Hits>& hits) const;
+
+  /**
+   Get the score of the lineage of a node, from the node to the root, for a
+   sample (see findStartNode()) and the depth of the node. The lineages of
+   all nodes visited are cached, so that the lineages of several clades are
+   only walked down to their first common (cached) ancestor.
+   */
+  const Lineage& getLineage(
+      const cmaple::NumSeqsType vec_index,
+      const std::unordered_map<cmaple::NumSeqsType, Hits>& hits,
+      std::unordered_map<cmaple::NumSeqsType, Lineage>& lineages,
+      const std::vector<PhyloNode>& nodes,
+      const cmaple::NumSeqsType root_vector_index) const;
+
+  /**
+   Get the lowest common ancestor of two nodes whose lineages are cached
+   */
+  static cmaple::NumSeqsType getCommonAncestor(
+      cmaple::NumSeqsType vec_index1,
+      cmaple::NumSeqsType vec_index2,
+      const std::unordered_map<cmaple::NumSeqsType, Lineage>& lineages,
+      const std::vector<PhyloNode>& nodes);
+
+  /**
+   Get the key of a mutation in the index
+   */
+  static uint64_t getKey(const cmaple::PositionType position,
+                         const cmaple::StateType state) {
+    return (static_cast<uint64_t>(position) << 16) | state;
+  }
+
+  /**
+   The clades (vector indexes of their root nodes) defined by each mutation
+   */
+  std::unordered_map<uint64_t, std::vector<cmaple::NumSeqsType>> clades_;
+
+  /**
+   The defining mutations (position, clade) of all clades sorted by position,
+   to look up those within the runs of unknown states of a sample
+   */
+  std::vector<std::pair<cmaple::PositionType, cmaple::NumSeqsType>>
+      mutation_positions_;
+
+  /**
+   The number of defining mutations of each node (0 if it isn't indexed)
+   */
+  std::vector<uint32_t> num_defining_mutations_;
+
+  /**
+   The clades reverting to the reference state at each position
+   */
+  std::unordered_map<cmaple::PositionType, std::vector<cmaple::NumSeqsType>>
+      reversions_;
+
+  /**
+   The number of states
+   */
+  cmaple::StateType num_states_ = 0;
+};
+}  // namespace cmaple
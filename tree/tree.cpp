@@ -1,11 +1,409 @@
 #include "tree.h"
+#include "placementindex.h"
 
+#include <utils/binaryio.h>
+#include <utils/inputstream.h>
+#include <utils/mappedfile.h>
 #include <utils/matrix.h>
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cstdio>
+#include <limits>
 
 using namespace std;
 using namespace cmaple;
 
+namespace {
+
+/**
+ Read characters from a tree (in Newick format) kept in memory, tracking the
+ current line and column for error messages. Like std::istream::get(), it
+ reports the end of the tree only after an attempt to read beyond it.
+ */
+class NewickReader {
+ public:
+  NewickReader(const std::string& newick,
+               PositionType& in_line,
+               PositionType& in_column)
+      : newick_(newick), in_line_(in_line), in_column_(in_column) {}
+
+  /**
+   TRUE if an attempt was made to read beyond the end of the tree
+   */
+  bool eof() const { return eof_; }
+
+  /**
+   Read the next character into ch (ch is unchanged at the end of the tree)
+   */
+  void get(char& ch) {
+    if (pos_ < newick_.size()) {
+      ch = newick_[pos_++];
+    } else {
+      eof_ = true;
+    }
+  }
+
+  /**
+   Read the next character (EOF at the end of the tree)
+   */
+  char get() {
+    char ch = static_cast<char>(std::char_traits<char>::eof());
+    get(ch);
+    return ch;
+  }
+
+  /**
+   Read the next character, skipping control characters and comments
+   */
+  char nextChar(const char current_ch = 0) {
+    char ch = current_ch;
+    if (current_ch != '[') {
+      getAndCount(ch);
+    }
+    // check if ch is a control character (ascii <= 32)
+    while (controlchar(ch) && !eof_) {
+      getAndCount(ch);
+    }
+    // ignore comment
+    std::string in_comment;
+    while (ch == '[' && !eof_) {
+      while (ch != ']' && !eof_) {
+        getAndCount(ch);
+        if (ch != ']') {
+          in_comment += ch;
+        }
+      }
+      if (ch != ']') {
+        throw "Comments not ended with ]";
+      }
+      getAndCount(ch);
+      while (controlchar(ch) && !eof_) {
+        getAndCount(ch);
+      }
+      if (in_comment.length() && cmaple::verbose_mode > cmaple::VB_QUIET) {
+        std::cout << "Ignore [" + in_comment + "]" << std::endl;
+      }
+    }
+    return ch;
+  }
+
+ private:
+  /**
+   Read the next character and update the line and column
+   */
+  void getAndCount(char& ch) {
+    get(ch);
+    in_column_++;
+    if (ch == 10) {
+      in_line_++;
+      in_column_ = 1;
+    }
+  }
+
+  const std::string& newick_;
+  std::string::size_type pos_ = 0;
+  bool eof_ = false;
+  PositionType& in_line_;
+  PositionType& in_column_;
+};
+
+/**
+ Read a tree (up to and including its ending ';') from a stream. The ';'
+ inside comments and quoted names do not end the tree.
+ */
+void readNewickString(std::istream& in, std::string& newick) {
+  newick.clear();
+  std::string segment;
+  bool in_comment = false;
+  char quote = 0;
+  while (std::getline(in, segment, ';')) {
+    for (const char c : segment) {
+      if (in_comment) {
+        in_comment = c != ']';
+      } else if (quote) {
+        if (c == quote) {
+          quote = 0;
+        }
+      } else if (c == '[') {
+        in_comment = true;
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      }
+    }
+    newick += segment;
+    if (in.eof()) {
+      break;
+    }
+    newick += ';';
+    if (!in_comment && !quote) {
+      break;
+    }
+  }
+}
+/**
+ Write a tree (in Newick format) to a stream through a reusable buffer
+ */
+class NewickWriter {
+ public:
+  explicit NewickWriter(std::ostream& out_stream) : out_stream_(out_stream) {
+    buffer_.reserve(BUFFER_SIZE + 1024);
+  }
+
+  void append(const char ch) { buffer_ += ch; }
+
+  void append(const std::string::size_type count, const char ch) {
+    buffer_.append(count, ch);
+  }
+
+  void append(const std::string& str) {
+    buffer_ += str;
+    flushIfFull();
+  }
+
+  /**
+   Append a number as std::ostream would (with a given precision)
+   */
+  void appendNumber(const RealNumType number, const int precision = 6) {
+    char str[32];
+    const std::to_chars_result result =
+        std::to_chars(str, str + sizeof(str), number,
+                      std::chars_format::general, precision);
+    buffer_.append(str, result.ptr);
+  }
+
+  /**
+   Append ':' followed by a branch length ("0" if it's not positive)
+   */
+  void appendLength(const RealNumType length) {
+    buffer_ += ':';
+    if (length <= 0) {
+      buffer_ += '0';
+    } else {
+      appendNumber(length, 12);
+    }
+    flushIfFull();
+  }
+
+  /**
+   Write the content of the buffer to the stream
+   */
+  void flush() {
+    out_stream_.write(buffer_.data(),
+                      static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+
+ private:
+  void flushIfFull() {
+    if (buffer_.size() >= BUFFER_SIZE) {
+      flush();
+    }
+  }
+
+  static constexpr std::string::size_type BUFFER_SIZE = 1 << 16;
+  std::ostream& out_stream_;
+  std::string buffer_;
+};
+
+/**
+ Magic number and version of checkpoint files
+ */
+const char CHECKPOINT_MAGIC[8] = {'C', 'M', 'A', 'P', 'L', 'E', 'C', 'K'};
+const uint32_t CHECKPOINT_VERSION = 2;
+
+/**
+ Minimum number of nodes in the tree to build the placement index
+ */
+const size_t MIN_NUM_NODES_PLACEMENT_INDEX = 1000;
+
+/**
+ The placement index is rebuilt once the number of nodes in the tree has grown
+ by 1/PLACEMENT_INDEX_REBUILD_GROWTH since it was last built
+ */
+const size_t PLACEMENT_INDEX_REBUILD_GROWTH = 4;
+
+/**
+ Size of the buffer of a checkpoint written to a stream
+ */
+const std::string::size_type CHECKPOINT_BUFFER_SIZE = 1 << 20;
+
+/**
+ Append a value (little-endian) to a checkpoint
+ */
+template <typename T>
+void putValue(std::string& out, const T value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    putReal(out, value);
+  } else {
+    putFixed(out, static_cast<uint64_t>(value), sizeof(T));
+  }
+}
+
+/**
+ Append an array of values to a checkpoint
+ */
+template <typename T>
+void putArray(std::string& out, const T* values, const std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    putValue(out, values[i]);
+  }
+}
+
+/**
+ Read a value written by putValue()
+ */
+template <typename T>
+T getValue(BinaryReader& in) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return in.getReal<T>();
+  } else {
+    return static_cast<T>(in.getFixed(sizeof(T)));
+  }
+}
+
+/**
+ Read an array of values written by putArray()
+ */
+template <typename T>
+void getArray(BinaryReader& in, T* values, const std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    values[i] = getValue<T>(in);
+  }
+}
+
+/**
+ Pack an index (a vector index and a mini-index) into 32 bits
+ */
+uint32_t packIndex(const Index index) {
+  return (index.getVectorIndex() << 2) | index.getMiniIndex();
+}
+
+/**
+ Unpack an index packed by packIndex()
+ */
+Index unpackIndex(const uint32_t packed_index) {
+  return Index(packed_index >> 2, static_cast<MiniIndex>(packed_index & 3));
+}
+
+/**
+ Compute a fingerprint (FNV-1a) of the sequences (names and mutations) and
+ the reference sequence of an alignment
+ */
+uint64_t hashAlignment(const Alignment& aln) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto hashByte = [&hash](const unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+  auto hashFixed = [&hashByte](uint64_t value, const int num_bytes) {
+    for (int i = 0; i < num_bytes; ++i, value >>= 8) {
+      hashByte(static_cast<unsigned char>(value & 0xFF));
+    }
+  };
+  for (const Sequence& sequence : aln.data) {
+    for (const char c : sequence.seq_name) {
+      hashByte(static_cast<unsigned char>(c));
+    }
+    hashByte(0);
+    hashFixed(sequence.size(), 4);
+    for (const Mutation& mutation : sequence) {
+      hashByte(static_cast<unsigned char>(mutation.type));
+      hashFixed(static_cast<uint64_t>(mutation.position), 4);
+      hashFixed(static_cast<uint64_t>(mutation.getLength()), 4);
+    }
+  }
+  for (const StateType state : aln.ref_seq) {
+    hashByte(static_cast<unsigned char>(state));
+  }
+  return hash;
+}
+
+/**
+ Flags of a region in a checkpoint: which optional members are stored
+ */
+enum CheckpointRegionFlags : uint8_t {
+  REGION_PLENGTH2NODE = 1,
+  REGION_PLENGTH2ROOT = 2,
+  REGION_LIKELIHOOD = 4,
+};
+
+/**
+ Write (possibly null) regions to a checkpoint
+ */
+void writeRegions(std::string& out,
+                  const std::unique_ptr<SeqRegions>& regions) {
+  // the number of regions + 1 (0: null)
+  if (!regions) {
+    putValue<uint32_t>(out, 0);
+    return;
+  }
+  putValue<uint32_t>(out, static_cast<uint32_t>(regions->size() + 1));
+  for (const SeqRegion& region : *regions) {
+    uint8_t flags = 0;
+    if (region.plength_observation2node != -1) {
+      flags |= REGION_PLENGTH2NODE;
+    }
+    if (region.plength_observation2root != -1) {
+      flags |= REGION_PLENGTH2ROOT;
+    }
+    if (region.likelihood) {
+      flags |= REGION_LIKELIHOOD;
+    }
+    putValue<StateType>(out, region.type);
+    putValue<uint8_t>(out, flags);
+    putValue<PositionType>(out, region.position);
+    if (flags & REGION_PLENGTH2NODE) {
+      putValue<RealNumType>(out, region.plength_observation2node);
+    }
+    if (flags & REGION_PLENGTH2ROOT) {
+      putValue<RealNumType>(out, region.plength_observation2root);
+    }
+    if (flags & REGION_LIKELIHOOD) {
+      putArray(out, region.likelihood->data(), region.likelihood->size());
+    }
+  }
+}
+
+/**
+ Read (possibly null) regions written by writeRegions()
+ */
+std::unique_ptr<SeqRegions> readRegions(BinaryReader& in,
+                                        const PositionType seq_length) {
+  const uint32_t num_regions_1 = getValue<uint32_t>(in);
+  if (!num_regions_1) {
+    return nullptr;
+  }
+  const uint32_t num_regions = num_regions_1 - 1;
+  if (num_regions > static_cast<uint32_t>(seq_length)) {
+    throw std::logic_error("Corrupted checkpoint (regions)!");
+  }
+
+  std::unique_ptr<SeqRegions> regions = cmaple::make_unique<SeqRegions>();
+  regions->reserve(num_regions);
+  for (uint32_t i = 0; i < num_regions; ++i) {
+    const StateType type = getValue<StateType>(in);
+    const uint8_t flags = getValue<uint8_t>(in);
+    const PositionType position = getValue<PositionType>(in);
+    if (position < 0 || position >= seq_length) {
+      throw std::logic_error("Corrupted checkpoint (regions)!");
+    }
+    const RealNumType plength2node =
+        (flags & REGION_PLENGTH2NODE) ? getValue<RealNumType>(in) : -1;
+    const RealNumType plength2root =
+        (flags & REGION_PLENGTH2ROOT) ? getValue<RealNumType>(in) : -1;
+    SeqRegion::LHPtrType likelihood = nullptr;
+    if (flags & REGION_LIKELIHOOD) {
+      likelihood = SeqRegion::LHPtrType(new SeqRegion::LHType());
+      getArray(in, likelihood->data(), likelihood->size());
+    }
+    regions->emplace_back(type, position, plength2node, plength2root,
+                          std::move(likelihood));
+  }
+  return regions;
+}
+}  // namespace
+
 void cmaple::Tree::initTree(Alignment* n_aln,
                             Model* n_model,
                             std::unique_ptr<cmaple::Params>&& n_params) {
@@ -36,6 +434,7 @@ void cmaple::Tree::initTree(Alignment* n_aln,
   // node_lh_index is usigned int -> we use 0 for UNINITIALIZED node_lh
   node_lhs.clear();
   node_lhs.push_back(NodeLh(0));
+  last_checkpoint_time = getRealTime();
 
   // Attach alignment and model
   attachAlnModel(n_aln, n_model->model_base);
@@ -100,8 +499,8 @@ void cmaple::Tree::load(const std::string& tree_filename,
     throw std::invalid_argument("The tree file name is empty");
   }
 
-  // open the treefile
-  std::ifstream tree_stream;
+  // open the treefile (decompressed if needed)
+  InputFileStream tree_stream;
   try {
     tree_stream.exceptions(ios::failbit | ios::badbit);
     tree_stream.open(tree_filename);
@@ -162,6 +561,14 @@ void cmaple::Tree::makeTreeInOutConsistent() {
 
 std::string cmaple::Tree::exportNewick(const TreeType tree_type,
                                        const bool show_branch_supports) {
+  std::ostringstream out_stream;
+  exportNewick(out_stream, tree_type, show_branch_supports);
+  return out_stream.str();
+}
+
+void cmaple::Tree::exportNewick(std::ostream& out_stream,
+                                const TreeType tree_type,
+                                const bool show_branch_supports) {
   assert(aln);
   assert(model);
     
@@ -174,11 +581,11 @@ std::string cmaple::Tree::exportNewick(const TreeType tree_type,
   // output the tree according to its type
   switch (tree_type) {
     case BIN_TREE:
-      return exportNewick(true, show_branch_supports_checked);
-      // break;
+      exportNewick(out_stream, true, show_branch_supports_checked);
+      break;
     case MUL_TREE:
-      return exportNewick(false, show_branch_supports_checked);
-      // break;
+      exportNewick(out_stream, false, show_branch_supports_checked);
+      break;
     case UNKNOWN_TREE:
     default:
       throw std::invalid_argument(
@@ -188,7 +595,7 @@ std::string cmaple::Tree::exportNewick(const TreeType tree_type,
 }
 
 std::ostream& cmaple::operator<<(std::ostream& out_stream, cmaple::Tree& tree) {
-  out_stream << tree.exportNewick();
+  tree.exportNewick(out_stream);
   return out_stream;
 }
 
@@ -519,16 +926,33 @@ void cmaple::Tree::doInferenceTemplate(
   streambuf* src_cout = cout.rdbuf();
   cout.rdbuf(out_stream.rdbuf());
 
+  // Skip the phases already completed before the checkpoint (if any) we
+  // resumed from. A checkpoint is saved at the end of each phase
+  const InferencePhase start_phase = inference_phase;
+
   // 1. Do placement to build an initial tree
-  doPlacement(out_stream);
+  if (start_phase <= PHASE_PLACEMENT) {
+    doPlacement(out_stream);
+    inference_phase = PHASE_TREE_SEARCH;
+    checkpoint();
+  }
 
   // 2. Optimize the tree with SPR if there is any new nodes added to the tree
-  applySPR(tree_search_type, shallow_tree_search, out_stream);
+  if (start_phase <= PHASE_TREE_SEARCH) {
+    applySPR(tree_search_type, shallow_tree_search, out_stream);
+    inference_phase = PHASE_BRANCH_OPTIMIZATION;
+    checkpoint();
+  }
 
   // 3. Optimize branch lengths (if needed)
-  if (!fixed_blengths) {
-    optimizeBranch(out_stream);
+  if (start_phase <= PHASE_BRANCH_OPTIMIZATION) {
+    if (!fixed_blengths) {
+      optimizeBranch(out_stream);
+    }
+    inference_phase = PHASE_DONE;
+    checkpoint();
   }
+  inference_phase = PHASE_PLACEMENT;
 
   // output log-likelihood of the tree
   if (cmaple::verbose_mode >= cmaple::VB_DEBUG) {
@@ -601,84 +1025,243 @@ void cmaple::Tree::doPlacementTemplate(std::ostream& out_stream) {
     ++i;
   }
 
-  // iteratively place other samples (sequences)
-  for (; i < num_seqs; ++i, ++sequence) {
-    // don't add sequence that was already added in the input tree
-    if (from_input_tree && sequence_added[i]) {
-      --num_new_sequences;
-      continue;
-    }
-    // otherwise, mark the current sequence as added
-    else {
-      sequence_added[i] = true;
-    }
-
-    // get the lower likelihood vector of the current sequence
-    std::unique_ptr<SeqRegions> lower_regions =
-        sequence->getLowerLhVector(seq_length, num_states, aln->getSeqType());
-
-    // update the mutation matrix from empirical number of mutations observed
-    // from the recent sequences (if allowed)
-    if (!(i % (static_cast<std::vector<cmaple::Sequence>
-               ::size_type>(params->mutation_update_period)))) {
-      if (model->updateMutationMatEmpirical()) {
-        computeCumulativeRate();
+  // a sequence identical to an earlier one is not searched for but directly
+  // recorded as a less-info seq of the leaf of that sequence, where the
+  // search would end anyway
+  const std::vector<NumSeqsType> identical_seqs = aln->findIdenticalSeqs();
+  // the leaf of each sequence already in the tree (as its own leaf or as a
+  // less-info seq)
+  std::vector<NumSeqsType> seq_leaves(num_seqs);
+  for (std::vector<PhyloNode>::size_type vec_index = 0;
+       vec_index < nodes.size(); ++vec_index) {
+    PhyloNode& node = nodes[vec_index];
+    if (!node.isInternal()) {
+      const NumSeqsType leaf_vec_index = static_cast<NumSeqsType>(vec_index);
+      seq_leaves[node.getSeqNameIndex()] = leaf_vec_index;
+      for (const NumSeqsType less_info_seq : node.getLessInfoSeqs()) {
+        seq_leaves[less_info_seq] = leaf_vec_index;
       }
     }
+  }
 
-    // NHANLT: debug
-    // if ((*sequence)->seq_name == "39")
-    //    cout << "debug" <<endl;
-
-    // seek a position for new sample placement
+  // iteratively place other samples (sequences) window by window. The
+  // placements of all samples in a window are searched (in parallel) against
+  // the same tree, then committed in order; a sample is re-searched at commit
+  // time if an earlier commit in the window updated any node read by its
+  // search, so the result is that of the plain sequential placement.
+  struct SamplePlacement {
     Index selected_node_index;
     RealNumType best_lh_diff = MIN_NEGATIVE;
     bool is_mid_branch = false;
     RealNumType best_up_lh_diff = MIN_NEGATIVE;
     RealNumType best_down_lh_diff = MIN_NEGATIVE;
     Index best_child_index;
-    seekSamplePlacement<num_states>(
-        Index(root_vector_index, TOP), static_cast<NumSeqsType>(i),
-        lower_regions, selected_node_index, best_lh_diff, is_mid_branch,
-        best_up_lh_diff, best_down_lh_diff, best_child_index);
-
-    // if new sample is not less informative than existing nodes (~selected_node
-    // != NULL) -> place the new sample in the existing tree
-    if (selected_node_index.getMiniIndex() != UNDEFINED) {
-      // place new sample as a descendant of a mid-branch point
-      if (is_mid_branch) {
-        placeNewSampleMidBranch<num_states>(selected_node_index, lower_regions,
-                                    static_cast<NumSeqsType>(i), best_lh_diff);
-        // otherwise, best lk so far is for appending directly to existing
-        // node
-      } else {
-        placeNewSampleAtNode<num_states>(selected_node_index, lower_regions,
-                                         static_cast<NumSeqsType>(i),
-                                         best_lh_diff, best_up_lh_diff,
-                                         best_down_lh_diff, best_child_index);
+    // the nodes read by the search (only recorded for windows of several
+    // samples)
+    std::vector<NumSeqsType> visited_nodes;
+  };
+  const std::vector<cmaple::Sequence>::size_type window_size =
+      static_cast<std::vector<cmaple::Sequence>::size_type>(
+          params->placement_window > 1 ? params->placement_window : 1);
+  const std::vector<cmaple::Sequence>::size_type mutation_update_period =
+      static_cast<std::vector<cmaple::Sequence>::size_type>(
+          params->mutation_update_period);
+  const int num_threads = params->num_threads
+                              ? static_cast<int>(params->num_threads)
+                              : countPhysicalCPUCores();
+  std::vector<NumSeqsType> window_seqs;
+  std::vector<std::unique_ptr<SeqRegions>> window_regions;
+  std::vector<SamplePlacement> window_placements;
+  window_seqs.reserve(window_size);
+
+  // the index proposing where to start seeking the placement of each sample
+  // (if enabled); it is rebuilt whenever the tree has grown by a quarter, as
+  // the nodes added since are never proposed
+  PlacementIndex placement_index;
+  const auto getStartNodeIndex = [&](const NumSeqsType seq_index) {
+    return Index(placement_index.getNumIndexedNodes()
+                     ? placement_index.findStartNode(aln->data[seq_index],
+                                                     nodes, root_vector_index)
+                     : root_vector_index,
+                 TOP);
+  };
+
+  while (i < num_seqs) {
+    // save a checkpoint (if due) between two windows
+    checkpointIfDue();
+
+    // (re)build the placement index between two windows
+    const size_t num_indexed_nodes = placement_index.getNumIndexedNodes();
+    if (params->placement_index &&
+        nodes.size() >=
+            std::max(MIN_NUM_NODES_PLACEMENT_INDEX,
+                     num_indexed_nodes +
+                         num_indexed_nodes / PLACEMENT_INDEX_REBUILD_GROWTH)) {
+      placement_index.build(nodes, root_vector_index, num_states,
+                            aln->ref_seq);
+    }
+
+    // collect the samples of the next window
+    window_seqs.clear();
+    for (; i < num_seqs && window_seqs.size() < window_size; ++i) {
+      // don't add sequence that was already added in the input tree
+      if (from_input_tree && sequence_added[i]) {
+        --num_new_sequences;
+        continue;
+      }
+
+      // update the mutation matrix from empirical number of mutations observed
+      // from the recent sequences (if allowed). A window never spans an update
+      // so that all its samples are searched with the same rates.
+      if (!(i % mutation_update_period)) {
+        if (!window_seqs.empty()) {
+          break;
+        }
+        if (model->updateMutationMatEmpirical()) {
+          computeCumulativeRate();
+        }
+      }
+
+      // mark the current sequence as added
+      sequence_added[i] = true;
+      window_seqs.push_back(static_cast<NumSeqsType>(i));
+    }
+    const std::vector<NumSeqsType>::size_type num_window_seqs =
+        window_seqs.size();
+    window_regions.resize(num_window_seqs);
+    window_placements.assign(num_window_seqs, SamplePlacement());
+
+    // seek the placements of all samples in the window against the current
+    // tree. seekSamplePlacement() only reads the tree when less-info seqs are
+    // deferred
+    std::exception_ptr seek_exception = nullptr;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads) \
+    if (num_window_seqs > 1)
+    for (PositionType j = 0; j < static_cast<PositionType>(num_window_seqs);
+         ++j) {
+      try {
+        const NumSeqsType seq_index = window_seqs[static_cast<
+            std::vector<NumSeqsType>::size_type>(j)];
+        std::unique_ptr<SeqRegions>& lower_regions = window_regions[
+            static_cast<std::vector<NumSeqsType>::size_type>(j)];
+        SamplePlacement& placement = window_placements[
+            static_cast<std::vector<NumSeqsType>::size_type>(j)];
+
+        // identical sequences are handled at commit time
+        if (identical_seqs[seq_index] != seq_index) {
+          continue;
+        }
+
+        // get the lower likelihood vector of the current sequence
+        lower_regions = aln->data[seq_index].getLowerLhVector(
+            seq_length, num_states, aln->getSeqType());
+        seekSamplePlacement<num_states>(
+            getStartNodeIndex(seq_index), seq_index, lower_regions,
+            placement.selected_node_index, placement.best_lh_diff,
+            placement.is_mid_branch, placement.best_up_lh_diff,
+            placement.best_down_lh_diff, placement.best_child_index, true,
+            num_window_seqs > 1 ? &placement.visited_nodes : nullptr);
+      } catch (...) {
+#pragma omp critical
+        if (!seek_exception) {
+          seek_exception = std::current_exception();
+        }
       }
     }
+    if (seek_exception) {
+      std::rethrow_exception(seek_exception);
+    }
+
+    // commit the placements one by one, in the order of the input samples
+    const NumSeqsType window_root_vector_index = root_vector_index;
+    track_touched_nodes = num_window_seqs > 1;
+    touched_nodes.clear();
+    for (std::vector<NumSeqsType>::size_type j = 0; j < num_window_seqs;
+         ++j) {
+      const NumSeqsType seq_index = window_seqs[j];
+      std::unique_ptr<SeqRegions>& lower_regions = window_regions[j];
+      SamplePlacement& placement = window_placements[j];
+      const NumSeqsType identical_seq = identical_seqs[seq_index];
+
+      // re-seek the placement if the root was changed or an earlier commit
+      // in this window updated any node read by the search
+      if (identical_seq == seq_index && j &&
+          (root_vector_index != window_root_vector_index ||
+           std::any_of(placement.visited_nodes.begin(),
+                       placement.visited_nodes.end(),
+                       [this](const NumSeqsType vec_index) {
+                         return touched_nodes.count(vec_index) > 0;
+                       }))) {
+        placement = SamplePlacement();
+        seekSamplePlacement<num_states>(
+            getStartNodeIndex(seq_index), seq_index, lower_regions,
+            placement.selected_node_index, placement.best_lh_diff,
+            placement.is_mid_branch, placement.best_up_lh_diff,
+            placement.best_down_lh_diff, placement.best_child_index, true);
+      }
 
-    // NHANLT: debug
-    // cout << "Added node " << (*sequence)->seq_name << endl;
-    // cout << (*sequence)->seq_name << endl;
-    // cout << tree.exportNewick() << endl;
-
-    // if ((*sequence)->seq_name == "2219")
-    //{
-    // cout << tree.exportNewick() << endl;
-    // string output_file(tree.params->output_prefix);
-    // exportOutput(output_file + "_init.treefile");
-    // exit(0);
-    //}
-    // show progress
-    if (cmaple::verbose_mode >= cmaple::VB_MED) {
-      if (i - count_every_1K >= 1000)
-      {
-        std::cout << "Added " << i << " samples" << std::endl;
-        count_every_1K = i;
+      // if new sample is identical to an earlier one -> record it as a
+      // less-info seq of the leaf of that sequence (which was committed
+      // before)
+      const Index& selected_node_index = placement.selected_node_index;
+      if (identical_seq != seq_index) {
+        const NumSeqsType leaf_vec_index = seq_leaves[identical_seq];
+        nodes[leaf_vec_index].addLessInfoSeqs(seq_index);
+        seq_leaves[seq_index] = leaf_vec_index;
+      }
+      // if new sample is less informative than an existing leaf -> record it
+      // as a less-info seq of that leaf
+      else if (selected_node_index.getMiniIndex() == UNDEFINED) {
+        nodes[selected_node_index.getVectorIndex()].addLessInfoSeqs(seq_index);
+        seq_leaves[seq_index] = selected_node_index.getVectorIndex();
+      }
+      // otherwise, place the new sample in the existing tree
+      else {
+        // the nodes re-linked or re-sized by the placement (the others it
+        // updates are recorded by updatePartialLh())
+        if (track_touched_nodes) {
+          const NumSeqsType selected_vec_index =
+              selected_node_index.getVectorIndex();
+          touched_nodes.insert(selected_vec_index);
+          if (selected_vec_index != root_vector_index) {
+            touched_nodes.insert(nodes[selected_vec_index]
+                                     .getNeighborIndex(TOP)
+                                     .getVectorIndex());
+          }
+          if (placement.best_child_index.getMiniIndex() != UNDEFINED) {
+            touched_nodes.insert(placement.best_child_index.getVectorIndex());
+          }
+        }
+
+        // place new sample as a descendant of a mid-branch point
+        if (placement.is_mid_branch) {
+          placeNewSampleMidBranch<num_states>(selected_node_index,
+                                              lower_regions, seq_index,
+                                              placement.best_lh_diff);
+          // otherwise, best lk so far is for appending directly to existing
+          // node
+        } else {
+          placeNewSampleAtNode<num_states>(
+              selected_node_index, lower_regions, seq_index,
+              placement.best_lh_diff, placement.best_up_lh_diff,
+              placement.best_down_lh_diff, placement.best_child_index);
+        }
+
+        // the new leaf is the last node
+        assert(nodes.back().getSeqNameIndex() == seq_index);
+        seq_leaves[seq_index] = static_cast<NumSeqsType>(nodes.size()) - 1;
+      }
+
+      // show progress
+      if (cmaple::verbose_mode >= cmaple::VB_MED) {
+        if (seq_index - count_every_1K >= 1000)
+        {
+          std::cout << "Added " << seq_index << " samples" << std::endl;
+          count_every_1K = seq_index;
+        }
       }
     }
+    track_touched_nodes = false;
   }
 
   // flag denotes whether there is any new nodes added
@@ -716,7 +1299,7 @@ void cmaple::Tree::doPlacementTemplate(std::ostream& out_stream) {
                : BIN_TREE;
 
     ofstream out = ofstream(prefix + "_init.treefile");
-    out << exportNewick(tree_format);
+    exportNewick(out, tree_format);
     out.close();
   }
 
@@ -728,7 +1311,7 @@ template <const StateType num_states>
 void cmaple::Tree::applySPRTemplate(
     const TreeSearchType n_tree_search_type,
     const bool shallow_tree_search, std::ostream& out_stream) {
-  assert(cumulative_base.size() > 0);
+  assert(!cumulative_base.empty());
   assert(nodes.size() > 0);
     
   TreeSearchType tree_search_type = n_tree_search_type;
@@ -796,7 +1379,7 @@ void cmaple::Tree::applySPRTemplate(
                  : BIN_TREE;
 
       ofstream out = ofstream(prefix + "_shallow_search.treefile");
-      out << exportNewick(tree_format);
+      exportNewick(out, tree_format);
       out.close();
     }
   }
@@ -844,7 +1427,7 @@ void cmaple::Tree::applySPRTemplate(
                : BIN_TREE;
 
     ofstream out = ofstream(prefix + "_topo.treefile");
-    out << exportNewick(tree_format);
+    exportNewick(out, tree_format);
     out.close();
   }
 
@@ -925,6 +1508,9 @@ void cmaple::Tree::optimizeTreeTopology(bool short_range_search) {
     // run improvements only on the nodes that have been affected by some
     // changes in the last round, and so on
     for (int j = 0; j < 20; ++j) {
+      // save a checkpoint (if due) between two rounds
+      checkpointIfDue();
+
       // forget SPR_applied flag to allow new SPR moves
       resetSPRFlags(false, true);
 
@@ -1021,7 +1607,7 @@ void cmaple::Tree::optimizeBranchTemplate(std::ostream& out_stream) {
                : BIN_TREE;
 
     ofstream out = ofstream(prefix + "_opt_blengths.treefile");
-    out << exportNewick(tree_format);
+    exportNewick(out, tree_format);
     out.close();
   }
 
@@ -1137,20 +1723,10 @@ void cmaple::Tree::computeBranchSupportTemplate(
 
   // 2. calculate the site lh contributions
   std::vector<RealNumType> site_lh_contributions, site_lh_at_root;
-  RealNumType total_lh =
-      calculateSiteLhs<num_states>(site_lh_contributions, site_lh_at_root);
-
-  // validate the result
-  /*RealNumType tmp_total_lh = 0;
-  for (RealNumType site_lh : site_lh_contributions)
-      tmp_total_lh += site_lh;
-  for (RealNumType site_lh : site_lh_at_root)
-      tmp_total_lh += site_lh;
-  assert(fabs(tmp_total_lh - total_lh) < 1e-6);*/
+  calculateSiteLhs<num_states>(site_lh_contributions, site_lh_at_root);
 
   // calculate aLRT-SH for all internal branches
-  calculate_aRLT_SH<num_states>(site_lh_contributions, site_lh_at_root,
-                                total_lh);
+  calculate_aRLT_SH<num_states>(site_lh_at_root);
 
   // refresh all non-lower likelihoods
   refreshAllNonLowerLhs<num_states>();
@@ -1166,63 +1742,109 @@ void cmaple::Tree::computeBranchSupportTemplate(
   cout.rdbuf(src_cout);
 }
 
-std::string cmaple::Tree::exportNodeString(const bool binary,
-                                           const NumSeqsType node_vec_index,
-                                           const bool show_branch_supports) {
-  PhyloNode& node = nodes[node_vec_index];
-  string output = "(";
+void cmaple::Tree::exportNodeString(std::ostream& out_stream,
+                                    const bool binary,
+                                    const NumSeqsType node_vec_index,
+                                    const bool show_branch_supports) {
+  NewickWriter writer(out_stream);
 
-  // if it's a leaf
-  if (!node.isInternal()) {
-    return node.exportString(binary, seq_names, show_branch_supports);
-    // if it's an internal node
-  } else {
-    /*bool add_comma = false;
-     for (Index neighbor_index:node.getNeighborIndexes(TOP))
-     {
-     if (!add_comma)
-     add_comma = true;
-     else
-     output += ",";
-     output += exportNodeString(binary, neighbor_index.getVectorIndex());
-     }*/
-    output +=
-        exportNodeString(binary, node.getNeighborIndex(RIGHT).getVectorIndex(),
-                         show_branch_supports);
-    output += ",";
-    output +=
-        exportNodeString(binary, node.getNeighborIndex(LEFT).getVectorIndex(),
-                         show_branch_supports);
-  }
-
-  string branch_support = "";
-  if (show_branch_supports) {
-    // Make sure Branch supports have been computed
-    if (!node.getNodelhIndex()) {
-      throw std::logic_error(
-          "Branch supports is not available. Please compute them first!");
+  // the internal nodes being written, with the number of their children
+  // already written
+  std::vector<std::pair<NumSeqsType, int>> node_stack;
+  NumSeqsType node_vec = node_vec_index;
+  while (true) {
+    // go down to the leftmost leaf of the subtree, opening its internal nodes
+    while (nodes[node_vec].isInternal()) {
+      writer.append('(');
+      node_stack.emplace_back(node_vec, 0);
+      node_vec = nodes[node_vec].getNeighborIndex(RIGHT).getVectorIndex();
+    }
+
+    // write the leaf (and its less-info sequences)
+    PhyloNode& leaf = nodes[node_vec];
+    const std::vector<NumSeqsType>& less_info_seqs = leaf.getLessInfoSeqs();
+    if (less_info_seqs.empty()) {
+      writer.append(seq_names[leaf.getSeqNameIndex()]);
+    }
+    // with minor sequences -> write minor sequences' names with zero
+    // branch lengths
+    else if (binary) {
+      // export less informative sequences in binary tree format
+      writer.append(less_info_seqs.size(), '(');
+      writer.append(seq_names[leaf.getSeqNameIndex()]);
+      writer.append(":0,");
+      writer.append(seq_names[less_info_seqs[0]]);
+      writer.append(":0)");
+      for (std::vector<NumSeqsType>::size_type i = 1;
+           i < less_info_seqs.size(); ++i) {
+        if (show_branch_supports) {
+          writer.append('0');
+        }
+        writer.append(":0,");
+        writer.append(seq_names[less_info_seqs[i]]);
+        writer.append(":0)");
+      }
+      if (show_branch_supports) {
+        writer.append('0');
+      }
+    } else {
+      // export less informative sequences in mutifurcating tree format
+      writer.append('(');
+      writer.append(seq_names[leaf.getSeqNameIndex()]);
+      writer.append(":0");
+      for (const NumSeqsType minor_seq_name_index : less_info_seqs) {
+        writer.append(',');
+        writer.append(seq_names[minor_seq_name_index]);
+        writer.append(":0");
+      }
+      writer.append(')');
+      if (show_branch_supports) {
+        writer.append('0');
+      }
     }
+    writer.appendLength(leaf.getUpperLength());
 
-    branch_support =
-        convertDoubleToString(node_lhs[node.getNodelhIndex()].get_aLRT_SH());
-  }
-  string length = node.getUpperLength() <= 0
-                      ? "0"
-                      : convertDoubleToString(node.getUpperLength(), 12);
-  output += ")" + branch_support + ":" + length;
+    // close the internal nodes whose children have all been written
+    while (!node_stack.empty() && node_stack.back().second == 1) {
+      PhyloNode& node = nodes[node_stack.back().first];
+      writer.append(')');
+      if (show_branch_supports) {
+        // Make sure Branch supports have been computed
+        if (!node.getNodelhIndex()) {
+          throw std::logic_error(
+              "Branch supports is not available. Please compute them first!");
+        }
+
+        writer.appendNumber(node_lhs[node.getNodelhIndex()].get_aLRT_SH());
+      }
+      writer.appendLength(node.getUpperLength());
+      node_stack.pop_back();
+    }
+    if (node_stack.empty()) {
+      break;
+    }
 
-  return output;
+    // move to the second child of the current internal node
+    writer.append(',');
+    node_stack.back().second = 1;
+    node_vec = nodes[node_stack.back().first]
+                   .getNeighborIndex(LEFT)
+                   .getVectorIndex();
+  }
+  writer.flush();
 }
 
-std::string cmaple::Tree::exportNewick(const bool binary,
-                                       const bool show_branch_supports) {
+void cmaple::Tree::exportNewick(std::ostream& out_stream,
+                                const bool binary,
+                                const bool show_branch_supports) {
   // make sure tree is not empty
   if (nodes.size() < 3) {
-    return "";
+    return;
   }
 
-  return exportNodeString(binary, root_vector_index, show_branch_supports) +
-         ";";
+  exportNodeString(out_stream, binary, root_vector_index,
+                   show_branch_supports);
+  out_stream << ';';
 }
 
 template <const StateType num_states>
@@ -1570,6 +2192,9 @@ void cmaple::Tree::updatePartialLh(stack<Index>& node_stack) {
     //   cout << "dsdas";
 
     node.setOutdated(true);
+    if (track_touched_nodes) {
+      touched_nodes.insert(node_index.getVectorIndex());
+    }
 
     std::unique_ptr<SeqRegions> null_seqregions_ptr = nullptr;
     bool is_non_root = root_vector_index != node_index.getVectorIndex();
@@ -1671,7 +2296,8 @@ void cmaple::Tree::finetuneSamplePlacementAtNode(
     const PhyloNode& selected_node,
     RealNumType& best_down_lh_diff,
     Index& best_child_index,
-    const std::unique_ptr<SeqRegions>& sample_regions) {
+    const std::unique_ptr<SeqRegions>& sample_regions,
+    std::vector<NumSeqsType>* visited_nodes) {
 
   // current node might be part of a polytomy (represented by 0 branch lengths)
   // so we want to explore all the children of the current node to find out if
@@ -1696,6 +2322,9 @@ void cmaple::Tree::finetuneSamplePlacementAtNode(
     // const RealNumType current_blength =
     // node.getCorrespondingLength(node_mini_index, nodes);
     const RealNumType current_blength = node.getUpperLength();
+    if (visited_nodes) {
+      visited_nodes->push_back(node_index.getVectorIndex());
+    }
 
     if (current_blength <= 0) {
       /*for (Index
@@ -2421,13 +3050,13 @@ void cmaple::Tree::seekSubTreePlacement(
     Index& best_child_index,
     const bool short_range_search,
     const Index child_node_index,
-    RealNumType& removed_blength)  //, bool search_subtree_placement,
-                                   // SeqRegions* sample_regions)
+    RealNumType& removed_blength,
+    std::vector<NumSeqsType>* visited_nodes)
 {
   assert(aln);
   assert(model);
   assert(cumulative_rate);
-  assert(cumulative_base.size() > 0);
+  assert(!cumulative_base.empty());
   assert(aln->ref_seq.size() > 0);
   assert(nodes.size() > 0);
     
@@ -2523,6 +3152,9 @@ void cmaple::Tree::seekSubTreePlacement(
     const Index current_node_index = updating_node->getIndex();
     const NumSeqsType current_node_vec = current_node_index.getVectorIndex();
     PhyloNode& current_node = nodes[current_node_vec];
+    if (visited_nodes) {
+      visited_nodes->push_back(current_node_vec);
+    }
 
     // consider the case we are moving from a parent to a child
     if (current_node_index.getMiniIndex() == TOP) {
@@ -5106,84 +5738,109 @@ template <const StateType num_states>
 RealNumType cmaple::Tree::improveSubTree(const Index node_index,
                                          PhyloNode& node,
                                          bool short_range_search) {
+  SubTreeSPR spr;
+  seekSubTreeSPR<num_states>(node_index, node, short_range_search, spr);
+  return applySubTreeSPR<num_states>(node_index, node, spr);
+}
+
+template <const StateType num_states>
+void cmaple::Tree::seekSubTreeSPR(const Index node_index,
+                                  PhyloNode& node,
+                                  bool short_range_search,
+                                  SubTreeSPR& spr,
+                                  const bool record_footprint) {
   // dummy variables
   assert(node_index.getMiniIndex() == TOP);
   const NumSeqsType vec_index = node_index.getVectorIndex();
   const RealNumType thresh_placement_cost =
       short_range_search ? params->thresh_placement_cost_short_search
                          : params->thresh_placement_cost;
-  RealNumType total_improvement = 0;
-  bool blength_changed = false;  // true if a branch length has been changed
+  spr = SubTreeSPR();
 
   // we avoid the root node since it cannot be re-placed with SPR moves
   if (root_vector_index != vec_index) {
+    const Index parent_index = node.getNeighborIndex(TOP);
+    if (record_footprint) {
+      const PhyloNode& parent_node = nodes[parent_index.getVectorIndex()];
+      spr.footprint.push_back(vec_index);
+      spr.footprint.push_back(parent_index.getVectorIndex());
+      spr.footprint.push_back(
+          parent_node.getNeighborIndex(parent_index.getFlipMiniIndex())
+              .getVectorIndex());
+      spr.footprint.push_back(
+          parent_node.getNeighborIndex(TOP).getVectorIndex());
+    }
+
     // evaluate current placement
     const std::unique_ptr<SeqRegions>& parent_upper_lr_lh = getPartialLhAtNode(
-        node.getNeighborIndex(TOP));  // node->neighbor->getPartialLhAtNode(aln,
-                                      // model, threshold_prob);
+        parent_index);  // node->neighbor->getPartialLhAtNode(aln,
+                        // model, threshold_prob);
     const std::unique_ptr<SeqRegions>& lower_lh = node.getPartialLh(
         TOP);  // node->getPartialLhAtNode(aln, model, threshold_prob);
-    RealNumType best_blength = node.getUpperLength();  // node->length;
-    RealNumType best_lh = calculateSubTreePlacementCost<num_states>(
-        parent_upper_lr_lh, lower_lh, best_blength);
+    spr.best_blength = node.getUpperLength();  // node->length;
+    spr.best_lh = calculateSubTreePlacementCost<num_states>(
+        parent_upper_lr_lh, lower_lh, spr.best_blength);
 
     // optimize branch length
-    if (best_lh < thresh_placement_cost) {
-      optimizeBlengthBeforeSeekingSPR<num_states>(node, best_blength, best_lh,
-                                                  blength_changed,
-                                                  parent_upper_lr_lh, lower_lh);
+    if (spr.best_lh < thresh_placement_cost) {
+      optimizeBlengthBeforeSeekingSPR<num_states>(
+          node, spr.best_blength, spr.best_lh, spr.blength_changed,
+          parent_upper_lr_lh, lower_lh);
     }
 
     // find new placement
-    if (best_lh < thresh_placement_cost) {
+    if (spr.best_lh < thresh_placement_cost) {
       // now find the best place on the tree where to re-attach the subtree
       // rooted at "node" but to do that we need to consider new vector
       // probabilities after removing the node that we want to replace this is
       // done using findBestParentTopology().
-      bool topology_updated = false;
-      const Index parent_index = node.getNeighborIndex(TOP);
-      // PhyloNode parent_node = nodes[parent_index.getVectorIndex()]; //
-      // node->neighbor->getTopNode();
-      Index best_node_index;
-      RealNumType best_lh_diff = best_lh;
-      bool is_mid_node = false;
+      spr.best_lh_diff = spr.best_lh;
       RealNumType best_up_lh_diff = MIN_NEGATIVE;
       RealNumType best_down_lh_diff = MIN_NEGATIVE;
       Index best_child_index;
 
       // seek a new placement for the subtree
       seekSubTreePlacement<num_states>(
-          best_node_index, best_lh_diff, is_mid_node, best_up_lh_diff,
-          best_down_lh_diff, best_child_index, short_range_search, node_index,
-          best_blength);  // , true, NULL);
+          spr.best_node_index, spr.best_lh_diff, spr.is_mid_node,
+          best_up_lh_diff, best_down_lh_diff, best_child_index,
+          short_range_search, node_index, spr.best_blength,
+          record_footprint ? &spr.footprint : nullptr);
 
       // validate the new placement cost
-      if (best_lh_diff > params->threshold_prob2) {
+      if (spr.best_lh_diff > params->threshold_prob2) {
         throw std::logic_error("Strange, lh cost is positive");
-      } else if (best_lh_diff < -1e50) {
+      } else if (spr.best_lh_diff < -1e50) {
         throw std::logic_error(
             "Likelihood cost is very heavy, this might mean that the "
             "reference used is not the same used to generate the input "
             "MAPLE file");
       }
 
-      if (best_lh_diff + thresh_placement_cost > best_lh) {
-        // check and apply SPR move
-        checkAndApplySPR<num_states>(best_lh_diff, best_blength, best_lh,
-                                     node_index, node, best_node_index,
-                                     parent_index, is_mid_node,
-                                     total_improvement, topology_updated);
-
-        if (!topology_updated && blength_changed) {
-          handleBlengthChanged<num_states>(node, node_index, best_blength);
-        }
-      } else if (blength_changed) {
-        handleBlengthChanged<num_states>(node, node_index, best_blength);
-      }
-    } else if (blength_changed) {
-      handleBlengthChanged<num_states>(node, node_index, best_blength);
+      spr.found_better_placement =
+          spr.best_lh_diff + thresh_placement_cost > spr.best_lh;
     }
   }
+}
+
+template <const StateType num_states>
+RealNumType cmaple::Tree::applySubTreeSPR(const Index node_index,
+                                          PhyloNode& node,
+                                          const SubTreeSPR& spr) {
+  RealNumType total_improvement = 0;
+  bool topology_updated = false;
+
+  // check and apply SPR move
+  if (spr.found_better_placement) {
+    checkAndApplySPR<num_states>(spr.best_lh_diff, spr.best_blength,
+                                 spr.best_lh, node_index, node,
+                                 spr.best_node_index, node.getNeighborIndex(TOP),
+                                 spr.is_mid_node, total_improvement,
+                                 topology_updated);
+  }
+
+  if (!topology_updated && spr.blength_changed) {
+    handleBlengthChanged<num_states>(node, node_index, spr.best_blength);
+  }
 
   return total_improvement;
 }
@@ -5219,9 +5876,13 @@ void calculateSubtreeCost_R_O(const SeqRegion& seq1_region,
   if (seq1_region.plength_observation2root >= 0) {
     RealNumType* transposed_mut_mat_row =
         model->transposed_mut_mat + model->row_index[seq1_state];
-    RealNumType* mutation_mat_row = model->mutation_mat;
+    RealNumType mut_lhs[num_states];
+    if (total_blength > 0) {
+      matrixVectorProduct<num_states>(model->mutation_mat,
+                                      &((*seq2_region.likelihood)[0]), mut_lhs);
+    }
 
-    for (StateType i = 0; i < num_states; ++i, mutation_mat_row += num_states) {
+    for (StateType i = 0; i < num_states; ++i) {
       // NHANLT NOTE: UNSURE
       // tot2: likelihood that we can observe seq1_state elvoving from i at root
       // (account for the fact that the observation might have occurred on the
@@ -5237,12 +5898,7 @@ void calculateSubtreeCost_R_O(const SeqRegion& seq1_region,
       // tot3: likelihood of i evolves to j
       // tot3 = (1 + mut[i,i] * total_blength) * lh(seq2,i) + mut[i,j] *
       // total_blength * lh(seq2,j)
-      RealNumType tot3 =
-          total_blength > 0
-              ? (total_blength *
-                 dotProduct<num_states>(mutation_mat_row,
-                                        &((*seq2_region.likelihood)[0])))
-              : 0;
+      RealNumType tot3 = total_blength > 0 ? (total_blength * mut_lhs[i]) : 0;
 
       // NHANLT NOTE:
       // tot = tot2 * tot3
@@ -5667,6 +6323,7 @@ template <const StateType num_states>
 void calculateSampleCost_R_O(const SeqRegion& seq1_region,
                              const SeqRegion& seq2_region,
                              const RealNumType blength,
+                             const RealNumType* const blength_mut_mat,
                              const StateType seq1_state,
                              RealNumType& lh_cost,
                              RealNumType& total_factor,
@@ -5705,6 +6362,8 @@ void calculateSampleCost_R_O(const SeqRegion& seq1_region,
       if (seq1_region.plength_observation2node >= 0) {
         lh_cost += model->diagonal_mut_mat[seq1_state] *
                    (blength + seq1_region.plength_observation2node);
+      } else if (blength_mut_mat) {
+        lh_cost += blength_mut_mat[model->row_index[seq1_state] + seq1_state];
       } else {
         lh_cost += model->diagonal_mut_mat[seq1_state] * blength;
       }
@@ -5727,18 +6386,18 @@ void calculateSampleCost_R_O(const SeqRegion& seq1_region,
 
 void calculateSampleCost_R_ACGT(const SeqRegion& seq1_region,
                                 const RealNumType blength,
+                                const RealNumType* const blength_mut_mat,
                                 const StateType seq1_state,
                                 const StateType seq2_state,
                                 RealNumType& total_factor,
                                 const ModelBase* model) {
+  const StateType mut_index = model->row_index[seq1_state] + seq2_state;
   if (seq1_region.plength_observation2root >= 0) {
-    // TODO: can cache model->mutation_mat[model->row_index[seq1_state] *
-    // model->diagonal_mut_mat[seq1_state]
     // TODO: can cache  model->freqi_freqj_qij[model->row_index[seq2_state] +
     // seq1_state] * model->diagonal_mut_mat[seq2_state]
     RealNumType seq1_state_evolves_seq2_state =
-        model->mutation_mat[model->row_index[seq1_state] + seq2_state] *
-        blength *
+        (blength_mut_mat ? blength_mut_mat[mut_index]
+                         : model->mutation_mat[mut_index] * blength) *
         (1.0 + model->diagonal_mut_mat[seq1_state] *
                    seq1_region.plength_observation2node);
 
@@ -5750,9 +6409,11 @@ void calculateSampleCost_R_ACGT(const SeqRegion& seq1_region,
 
     total_factor *=
         seq1_state_evolves_seq2_state + seq2_state_evolves_seq1_state;
+  } else if (blength_mut_mat && seq1_region.plength_observation2node < 0) {
+    total_factor *= blength_mut_mat[mut_index];
   } else {
     total_factor *=
-        model->mutation_mat[model->row_index[seq1_state] + seq2_state] *
+        model->mutation_mat[mut_index] *
         (blength + (seq1_region.plength_observation2node < 0
                         ? 0
                         : seq1_region.plength_observation2node));
@@ -5819,8 +6480,16 @@ void calculateSampleCost_O_RACGT(const SeqRegion& seq1_region,
 
 void calculateSampleCost_identicalACGT(const SeqRegion& seq1_region,
                                        const RealNumType blength,
+                                       const RealNumType* const blength_mut_mat,
                                        RealNumType& lh_cost,
                                        const ModelBase* model) {
+  if (blength_mut_mat && seq1_region.plength_observation2node < 0 &&
+      seq1_region.plength_observation2root < 0) {
+    lh_cost +=
+        blength_mut_mat[model->row_index[seq1_region.type] + seq1_region.type];
+    return;
+  }
+
   RealNumType total_blength = blength;
   total_blength += (seq1_region.plength_observation2node < 0
                         ? 0
@@ -5836,6 +6505,7 @@ template <const StateType num_states>
 void calculateSampleCost_ACGT_O(const SeqRegion& seq1_region,
                                 const SeqRegion& seq2_region,
                                 const RealNumType blength,
+                                const RealNumType* const blength_mut_mat,
                                 RealNumType& lh_cost,
                                 RealNumType& total_factor,
                                 const ModelBase* model) {
@@ -5875,7 +6545,10 @@ void calculateSampleCost_ACGT_O(const SeqRegion& seq1_region,
                        ? 0
                        : seq1_region.plength_observation2node);
     if (seq2_region.getLH(seq1_state) > 0.1) {
-      lh_cost += model->diagonal_mut_mat[seq1_state] * tmp_blength;
+      lh_cost += blength_mut_mat && seq1_region.plength_observation2node < 0
+                     ? blength_mut_mat[model->row_index[seq1_state] +
+                                       seq1_state]
+                     : model->diagonal_mut_mat[seq1_state] * tmp_blength;
     } else {
       RealNumType* mutation_mat_row =
           model->mutation_mat + model->row_index[seq1_state];
@@ -5890,6 +6563,7 @@ void calculateSampleCost_ACGT_O(const SeqRegion& seq1_region,
 void calculateSampleCost_ACGT_RACGT(const SeqRegion& seq1_region,
                                     const SeqRegion& seq2_region,
                                     const RealNumType blength,
+                                    const RealNumType* const blength_mut_mat,
                                     const PositionType end_pos,
                                     RealNumType& total_factor,
                                     const Alignment* aln,
@@ -5917,6 +6591,8 @@ void calculateSampleCost_ACGT_RACGT(const SeqRegion& seq1_region,
 
     total_factor *=
         (seq1_state_evoloves_seq2_state + seq2_state_evolves_seq1_state);
+  } else if (blength_mut_mat && seq1_region.plength_observation2node < 0) {
+    total_factor *= blength_mut_mat[model->row_index[seq1_state] + seq2_state];
   } else {
     RealNumType tmp_blength =
         ((seq1_region.plength_observation2node < 0)
@@ -5954,6 +6630,10 @@ RealNumType cmaple::Tree::calculateSamplePlacementCost(
   if (blength < 0) {
     blength = 0;
   }
+  // most samples are examined with the default branch length, for which the
+  // transition terms are precomputed
+  const RealNumType* const blength_mut_mat =
+      blength == default_blength ? default_blength_mut_mat.data() : nullptr;
   const PositionType seq_length = static_cast<PositionType>(aln->ref_seq.size());
 
   while (pos < seq_length) {
@@ -5987,17 +6667,19 @@ RealNumType cmaple::Tree::calculateSamplePlacementCost(
     }
     // 2.2. e1.type = R and e2.type = O
     else if (s1s2 == RO) {
-      calculateSampleCost_R_O<num_states>(*seq1_region, *seq2_region, blength,
-                                          aln->ref_seq[static_cast<
-                            std::vector<cmaple::StateType>::size_type>(end_pos)],
-                                          lh_cost, total_factor, model);
+      calculateSampleCost_R_O<num_states>(
+          *seq1_region, *seq2_region, blength, blength_mut_mat,
+          aln->ref_seq[static_cast<std::vector<cmaple::StateType>::size_type>(
+              end_pos)],
+          lh_cost, total_factor, model);
     }
     // 2.3. e1.type = R and e2.type = A/C/G/T
     else if (seq1_region->type == TYPE_R) {
-      calculateSampleCost_R_ACGT(*seq1_region, blength,
-                                 aln->ref_seq[static_cast<
-                    std::vector<cmaple::StateType>::size_type>(end_pos)],
-                                 seq2_region->type, total_factor, model);
+      calculateSampleCost_R_ACGT(
+          *seq1_region, blength, blength_mut_mat,
+          aln->ref_seq[static_cast<std::vector<cmaple::StateType>::size_type>(
+              end_pos)],
+          seq2_region->type, total_factor, model);
     }
     // 3. e1.type = O
     // 3.1. e1.type = O and e2.type = O
@@ -6014,18 +6696,21 @@ RealNumType cmaple::Tree::calculateSamplePlacementCost(
     // 4. e1.type = A/C/G/T
     // 4.1. e1.type =  e2.type
     else if (seq1_region->type == seq2_region->type) {
-      calculateSampleCost_identicalACGT(*seq1_region, blength, lh_cost, model);
+      calculateSampleCost_identicalACGT(*seq1_region, blength, blength_mut_mat,
+                                        lh_cost, model);
     }
     // e1.type = A/C/G/T and e2.type = O/A/C/G/T
     // 4.2. e1.type = A/C/G/T and e2.type = O
     else if (seq2_region->type == TYPE_O) {
-      calculateSampleCost_ACGT_O<num_states>(
-          *seq1_region, *seq2_region, blength, lh_cost, total_factor, model);
+      calculateSampleCost_ACGT_O<num_states>(*seq1_region, *seq2_region,
+                                             blength, blength_mut_mat, lh_cost,
+                                             total_factor, model);
     }
     // 4.3. e1.type = A/C/G/T and e2.type = R or A/C/G/T
     else {
       calculateSampleCost_ACGT_RACGT(*seq1_region, *seq2_region, blength,
-                                     end_pos, total_factor, aln, model);
+                                     blength_mut_mat, end_pos, total_factor,
+                                     aln, model);
     }
 
     // avoid underflow on total_factor
@@ -6450,9 +7135,10 @@ void cmaple::Tree::calculate_aRLT(const bool allow_replacing_ML_tree) {
 }
 
 template <const StateType num_states>
-void cmaple::Tree::calSiteLhDiffRoot(
-    std::vector<RealNumType>& site_lh_diff,
-    std::vector<RealNumType>& site_lh_root_diff,
+bool cmaple::Tree::calSiteLhDiffRoot(
+    SparseSiteLhs& site_lh_diff,
+    SparseSiteLhs& site_lh_diff_old,
+    std::vector<SiteLhDiff>& site_lh_root_diff,
     const std::vector<RealNumType>& site_lh_root,
     std::unique_ptr<SeqRegions>& parent_new_lower_lh,
     const RealNumType& child_2_new_blength,
@@ -6473,8 +7159,6 @@ void cmaple::Tree::calSiteLhDiffRoot(
       child_2.getPartialLh(TOP);
   std::unique_ptr<SeqRegions> new_parent_new_lower_lh = nullptr;
   std::unique_ptr<SeqRegions> tmp_lower_lh = nullptr;
-  const std::vector<cmaple::StateType>::size_type seq_length = aln->ref_seq.size();
-  std::vector<RealNumType> site_lh_diff_old(seq_length, 0);
 
   // 2. estimate x ~ the length of the new branch connecting the parent and the
   // new_parent nodes
@@ -6482,8 +7166,7 @@ void cmaple::Tree::calSiteLhDiffRoot(
   // merge 2 lower vector into one
   // NHANLT: avoid null
   if (!parent_new_lower_lh) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   RealNumType best_parent_lh = parent_new_lower_lh->mergeTwoLowers<num_states>(
       new_parent_new_lower_lh, parent_new_blength, *child_1_lower_regions,
@@ -6520,8 +7203,7 @@ void cmaple::Tree::calSiteLhDiffRoot(
   // 5.2. for the parent node
   // NHANLT: avoid null
   if (!new_parent_new_upper_lr_1) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   std::unique_ptr<SeqRegions> parent_new_upper_lr_1 = nullptr;
   new_parent_new_upper_lr_1->mergeUpperLower<num_states>(
@@ -6564,8 +7246,7 @@ void cmaple::Tree::calSiteLhDiffRoot(
   // 7.2. the new_parent node
   // NHANLT: avoid null
   if (!parent_new_lower_lh) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   parent_new_lower_lh->calculateSiteLhContributions<num_states>(
       site_lh_diff, new_parent_new_lower_lh, parent_best_blength,
@@ -6576,23 +7257,18 @@ void cmaple::Tree::calSiteLhDiffRoot(
       *sibling_lower_lh, sibling.getUpperLength(), aln, model, cumulative_rate,
       threshold_prob);
   // 7.3 the absolute likelihood at root
-  new_parent_new_lower_lh->computeSiteLhAtRoot<num_states>(
-      site_lh_root_diff, model, cumulative_base);
-  // update site_lh_root_diff
-  for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-    site_lh_root_diff[j] -= site_lh_root[j];
-  }
+  new_parent_new_lower_lh->computeSiteLhDiffAtRoot<num_states>(
+      site_lh_root_diff, site_lh_root, *parent.getPartialLh(TOP), model,
+      cumulative_base);
 
-  // calculate the site-lh differences between the new and the old ones
-  for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-    site_lh_diff[j] -= site_lh_diff_old[j];
-  }
+  return true;
 }
 
 template <const StateType num_states>
-void cmaple::Tree::calSiteLhDiffNonRoot(
-    std::vector<RealNumType>& site_lh_diff,
-    std::vector<RealNumType>& site_lh_root_diff,
+bool cmaple::Tree::calSiteLhDiffNonRoot(
+    SparseSiteLhs& site_lh_diff,
+    SparseSiteLhs& site_lh_diff_old,
+    std::vector<SiteLhDiff>& site_lh_root_diff,
     const std::vector<RealNumType>& site_lh_root,
     std::unique_ptr<SeqRegions>& parent_new_lower_lh,
     const RealNumType& child_2_new_blength,
@@ -6615,7 +7291,6 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   std::unique_ptr<SeqRegions> new_parent_new_lower_lh = nullptr;
   std::unique_ptr<SeqRegions> tmp_lower_lh = nullptr;
   const std::vector<cmaple::StateType>::size_type seq_length = aln->ref_seq.size();
-  std::vector<RealNumType> site_lh_diff_old(seq_length, 0);
 
   const std::unique_ptr<SeqRegions>& grand_parent_upper_lr =
       getPartialLhAtNode(parent.getNeighborIndex(TOP));
@@ -6635,8 +7310,7 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   std::unique_ptr<SeqRegions> parent_new_mid_branch_lh = nullptr;
   // NHANLT: avoid null
   if (!grand_parent_upper_lr) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   grand_parent_upper_lr->mergeUpperLower<num_states>(
       parent_new_mid_branch_lh, parent_mid_blength, *parent_new_lower_lh,
@@ -6692,8 +7366,7 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   // 4. recompute the lower_lh of the new_parent
   // NHANLT: avoid null
   if (!parent_new_lower_lh) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   parent_new_lower_lh->mergeTwoLowers<num_states>(
       new_parent_new_lower_lh, parent_new_blength, *child_1_lower_regions,
@@ -6713,8 +7386,7 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   // 5.2. for the parent node
   // NHANLT: avoid null
   if (!new_parent_new_upper_lr_1) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   std::unique_ptr<SeqRegions> parent_new_upper_lr_1 = nullptr;
   new_parent_new_upper_lr_1->mergeUpperLower<num_states>(
@@ -6762,8 +7434,7 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   // 7.2. the new_parent node
   // NHANLT: avoid null
   if (!parent_new_lower_lh) {
-    std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-    return;
+    return false;
   }
   RealNumType prev_lh_diff =
       parent_new_lower_lh->calculateSiteLhContributions<num_states>(
@@ -6787,8 +7458,7 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
   while (true) {
     // NHANLT: avoid null
     if (!new_lower_lh) {
-      std::fill(site_lh_diff.begin(), site_lh_diff.end(), MIN_NEGATIVE);
-      return;
+      return false;
     }
 
     NumSeqsType node_vec = node_index.getVectorIndex();
@@ -6840,13 +7510,9 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
       // case when node is root
       else {
         // re-calculate likelihood at root
-        new_lower_lh->computeSiteLhAtRoot<num_states>(site_lh_root_diff, model,
-                                                      cumulative_base);
-
-        // update site_lh_root_diff
-        for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-          site_lh_root_diff[j] -= site_lh_root[j];
-        }
+        new_lower_lh->computeSiteLhDiffAtRoot<num_states>(
+            site_lh_root_diff, site_lh_root, *node.getPartialLh(TOP), model,
+            cumulative_base);
 
         // stop traversing further
         break;
@@ -6865,15 +7531,12 @@ void cmaple::Tree::calSiteLhDiffNonRoot(
     }
   }
 
-  // calculate the site-lh differences between the new and the old ones
-  for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-    site_lh_diff[j] -= site_lh_diff_old[j];
-  }
+  return true;
 }
 
 template <const StateType num_states>
-void cmaple::Tree::calSiteLhDiff(std::vector<RealNumType>& site_lh_diff,
-                                 std::vector<RealNumType>& site_lh_root_diff,
+bool cmaple::Tree::calSiteLhDiff(std::vector<SiteLhDiff>& site_lh_diff,
+                                 ALRTSHBuffers& buffers,
                                  const std::vector<RealNumType>& site_lh_root,
                                  PhyloNode& current_node,
                                  PhyloNode& child_1,
@@ -6900,19 +7563,118 @@ void cmaple::Tree::calSiteLhDiff(std::vector<RealNumType>& site_lh_diff,
 
   // if the (old) parent is root
   // for more information, pls see https://tinyurl.com/5n8m5c8y
+  SparseSiteLhs& site_lh_new = buffers.site_lh_new;
+  SparseSiteLhs& site_lh_old = buffers.site_lh_old;
+  std::vector<SiteLhDiff>& site_lh_root_diff = buffers.site_lh_root_diff;
+  site_lh_new.clear();
+  site_lh_old.clear();
+  site_lh_root_diff.clear();
+  bool valid;
   if (root_vector_index == parent_index.getVectorIndex()) {
-    calSiteLhDiffRoot<num_states>(site_lh_diff, site_lh_root_diff, site_lh_root,
-                                  parent_new_lower_lh, child_2_new_blength,
-                                  current_node, child_1, child_2, sibling,
-                                  parent, parent_index);
+    valid = calSiteLhDiffRoot<num_states>(
+        site_lh_new, site_lh_old, site_lh_root_diff, site_lh_root,
+        parent_new_lower_lh, child_2_new_blength, current_node, child_1,
+        child_2, sibling, parent, parent_index);
     // otherwise, the (old) parent node is non-root
     // for more information, pls see https://tinyurl.com/ymr49jy8
   } else {
-    calSiteLhDiffNonRoot<num_states>(site_lh_diff, site_lh_root_diff,
-                                     site_lh_root, parent_new_lower_lh,
-                                     child_2_new_blength, current_node, child_1,
-                                     child_2, sibling, parent, parent_index);
+    valid = calSiteLhDiffNonRoot<num_states>(
+        site_lh_new, site_lh_old, site_lh_root_diff, site_lh_root,
+        parent_new_lower_lh, child_2_new_blength, current_node, child_1,
+        child_2, sibling, parent, parent_index);
+  }
+
+  site_lh_diff.clear();
+  if (!valid) {
+    return false;
+  }
+
+  // collect the contributions at single sites (new - old + root), sorted by
+  // position
+  std::vector<SiteLhDiff>& site_lhs = buffers.site_lhs;
+  site_lhs = site_lh_new.sites;
+  for (const SiteLhDiff& site_lh : site_lh_old.sites) {
+    site_lhs.push_back({site_lh.position, -site_lh.delta});
+  }
+  site_lhs.insert(site_lhs.end(), site_lh_root_diff.begin(),
+                  site_lh_root_diff.end());
+  std::stable_sort(site_lhs.begin(), site_lhs.end(),
+                   [](const SiteLhDiff& a, const SiteLhDiff& b) {
+                     return a.position < b.position;
+                   });
+
+  // collect the runs of R sites (the old ones with negative blengths) and
+  // their bounds: (the first site of a run, 2 * run) and (the site after the
+  // last site of a run, 2 * run + 1)
+  std::vector<SparseSiteLhs::RRun>& r_runs = buffers.r_runs;
+  r_runs = site_lh_new.r_runs;
+  for (const SparseSiteLhs::RRun& r_run : site_lh_old.r_runs) {
+    r_runs.push_back({r_run.start, r_run.end, -r_run.blength});
+  }
+  std::vector<std::pair<PositionType, size_t>>& r_run_bounds =
+      buffers.r_run_bounds;
+  r_run_bounds.clear();
+  for (size_t i = 0; i < r_runs.size(); ++i) {
+    r_run_bounds.emplace_back(r_runs[i].start, 2 * i);
+    r_run_bounds.emplace_back(r_runs[i].end + 1, 2 * i + 1);
+  }
+  std::sort(r_run_bounds.begin(), r_run_bounds.end());
+
+  // sweep the sites, only visiting those covered by runs whose blengths do
+  // not cancel out, or having contributions at single sites
+  std::vector<size_t>& active_r_runs = buffers.active_r_runs;
+  active_r_runs.clear();
+  auto bound_it = r_run_bounds.begin();
+  auto site_it = site_lhs.begin();
+  RealNumType r_blength = 0;
+  PositionType pos = 0;
+  while (bound_it != r_run_bounds.end() || site_it != site_lhs.end()) {
+    // update the runs covering pos, summing up their blengths from scratch
+    // so that a new and an old run of the same blength cancel out exactly
+    if (bound_it != r_run_bounds.end() && bound_it->first <= pos) {
+      for (; bound_it != r_run_bounds.end() && bound_it->first <= pos;
+           ++bound_it) {
+        const size_t run = bound_it->second / 2;
+        if (bound_it->second % 2) {
+          active_r_runs.erase(
+              std::find(active_r_runs.begin(), active_r_runs.end(), run));
+        } else {
+          active_r_runs.push_back(run);
+        }
+      }
+      r_blength = 0;
+      for (const size_t run : active_r_runs) {
+        r_blength += r_runs[run].blength;
+      }
+    }
+
+    // jump to the next site that may change
+    if (r_blength == 0) {
+      PositionType next_pos = std::numeric_limits<PositionType>::max();
+      if (bound_it != r_run_bounds.end()) {
+        next_pos = bound_it->first;
+      }
+      if (site_it != site_lhs.end()) {
+        next_pos = std::min(next_pos, site_it->position);
+      }
+      if (next_pos > pos) {
+        pos = next_pos;
+        continue;
+      }
+    }
+
+    RealNumType delta =
+        r_blength * (cumulative_rate[pos + 1] - cumulative_rate[pos]);
+    for (; site_it != site_lhs.end() && site_it->position == pos; ++site_it) {
+      delta += site_it->delta;
+    }
+    if (delta != 0) {
+      site_lh_diff.push_back({pos, delta});
+    }
+    ++pos;
   }
+
+  return true;
 }
 
 void findTwoLargest(const RealNumType a,
@@ -6938,12 +7700,28 @@ void findTwoLargest(const RealNumType a,
   }
 }
 
+void addResampledSiteLhDiff(std::vector<RealNumType>& lh_diff_stars,
+                            const std::vector<uint8_t>& resampling_counts,
+                            const PositionType position,
+                            const RealNumType delta) {
+  // the counts of a site are contiguous (one per replicate)
+  const std::vector<RealNumType>::size_type num_replicates =
+      lh_diff_stars.size();
+  const uint8_t* const counts =
+      resampling_counts.data() +
+      static_cast<std::vector<uint8_t>::size_type>(position) * num_replicates;
+  RealNumType* const stars = lh_diff_stars.data();
+  for (std::vector<RealNumType>::size_type i = 0; i < num_replicates; ++i) {
+    stars[i] += counts[i] * delta;
+  }
+}
+
 template <const StateType num_states>
 PositionType cmaple::Tree::count_aRLT_SH_branch(
-    std::vector<RealNumType>& site_lh_contributions,
     std::vector<RealNumType>& site_lh_root,
+    const std::vector<uint8_t>& resampling_counts,
     PhyloNode& node,
-    const RealNumType& LT1) {
+    ALRTSHBuffers& buffers) {
   // caculate aLRT
   const Index child_1_index = node.getNeighborIndex(RIGHT);
   const Index child_2_index = node.getNeighborIndex(LEFT);
@@ -6955,125 +7733,95 @@ PositionType cmaple::Tree::count_aRLT_SH_branch(
       parent.getNeighborIndex(parent_index.getFlipMiniIndex());
   PhyloNode& sibling = nodes[sibling_index.getVectorIndex()];
   PositionType sh_count{0};
-  const std::vector<cmaple::StateType>::size_type seq_length = aln->ref_seq.size();
   const NodeLh& nodelh = node_lhs[node.getNodelhIndex()];
-  const RealNumType LT2 = LT1 + nodelh.getLhDiff2();
-  const RealNumType LT3 = LT1 + nodelh.getLhDiff3();
-
-  // debug
-  /*if (!child_1.isInternal() && (aln->data[child_1.getSeqNameIndex()].seq_name
-  == "52")) std::cout << "sfdfds " <<std::endl;
-
-  if (!child_2.isInternal() && (aln->data[child_2.getSeqNameIndex()].seq_name ==
-  "52")) std::cout << "sfdfds " <<std::endl;*/
 
   // calculate site_lh differences
   // neighbor 2
-  std::vector<RealNumType> site_lh_diff_2(seq_length, 0);
-  std::vector<RealNumType> site_lh_root_diff_2(seq_length, 0);
-  calSiteLhDiff<num_states>(site_lh_diff_2, site_lh_root_diff_2, site_lh_root,
-                            node, child_1, child_2, sibling, parent,
-                            parent_index);
+  std::vector<SiteLhDiff>& site_lh_diff_2 = buffers.site_lh_diff_2;
+  const bool valid_2 = calSiteLhDiff<num_states>(
+      site_lh_diff_2, buffers, site_lh_root, node, child_1, child_2, sibling,
+      parent, parent_index);
   // neighbor 3
-  std::vector<RealNumType> site_lh_diff_3(seq_length, 0);
-  std::vector<RealNumType> site_lh_root_diff_3(seq_length, 0);
-  calSiteLhDiff<num_states>(site_lh_diff_3, site_lh_root_diff_3, site_lh_root,
-                            node, child_2, child_1, sibling, parent,
-                            parent_index);
+  std::vector<SiteLhDiff>& site_lh_diff_3 = buffers.site_lh_diff_3;
+  const bool valid_3 = calSiteLhDiff<num_states>(
+      site_lh_diff_3, buffers, site_lh_root, node, child_2, child_1, sibling,
+      parent, parent_index);
 
+#ifdef DEBUG
   // validate the results
   RealNumType lh_diff_2{0};
   RealNumType lh_diff_3{0};
-  for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-    lh_diff_2 += site_lh_diff_2[j];
-    lh_diff_2 += site_lh_root_diff_2[j];
-
-    lh_diff_3 += site_lh_diff_3[j];
-    lh_diff_3 += site_lh_root_diff_3[j];
-  }
-#ifdef DEBUG
-  assert(isinf(lh_diff_2) || fabs(lh_diff_2 - nodelh.getLhDiff2()) < 1e-3);
-  assert(isinf(lh_diff_3) || fabs(lh_diff_3 - nodelh.getLhDiff3()) < 1e-3);
-#endif
-
-// iterate a number of replicates
-#pragma omp parallel reduction(+ : sh_count)
-  {
-    std::vector<PositionType> selected_sites(seq_length);
-    int thread_id = 0;
-#ifdef _OPENMP
-    thread_id = omp_get_thread_num();
+  for (const SiteLhDiff& site_diff : site_lh_diff_2)
+    lh_diff_2 += site_diff.delta;
+  for (const SiteLhDiff& site_diff : site_lh_diff_3)
+    lh_diff_3 += site_diff.delta;
+  assert(!valid_2 || fabs(lh_diff_2 - nodelh.getLhDiff2()) < 1e-3);
+  assert(!valid_3 || fabs(lh_diff_3 - nodelh.getLhDiff3()) < 1e-3);
 #endif
 
-    // init random generators
-    std::default_random_engine gen(static_cast<unsigned int>(params->ran_seed) + static_cast<unsigned int>(thread_id));
-    std::uniform_int_distribution<> rng_distrib(0, static_cast<int>(seq_length) - 1);
-#pragma omp for
-    for (PositionType i = 0; i < params->aLRT_SH_replicates; ++i) {
-      // reset all LTX*
-      RealNumType LT1_star{0}, LT2_star{0}, LT3_star{0};
-
-      // generate a vector of sampled sites
-      for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j)
-        selected_sites[j] = rng_distrib(gen);
-
-      // compute LT1*, LT2*, LT3*
-      // NOTES: LT2*, LT3* are now the lh differences between the actual LT2*,
-      // LT3* and LT1*
-      for (std::vector<cmaple::StateType>::size_type j = 0; j < seq_length; ++j) {
-        const std::vector<cmaple::StateType>::size_type site_index = static_cast<
-          std::vector<cmaple::StateType>::size_type>(selected_sites[j]);
-
-        LT1_star += site_lh_contributions[site_index];
-        LT1_star += site_lh_root[site_index];
-
-        LT2_star += site_lh_diff_2[site_index];
-        LT2_star += site_lh_root_diff_2[site_index];
-
-        LT3_star += site_lh_diff_3[site_index];
-        LT3_star += site_lh_root_diff_3[site_index];
-      }
-
-      // compute the actual LT2* and LT3*
-      LT2_star += LT1_star;
-      LT3_star += LT1_star;
-
-      // compute the centered sums CS1*, CS2*, CS3*
-      // where CSX* = LTX* - LTX
-      const RealNumType CS1 = LT1_star - LT1;
-      const RealNumType CS2 = LT2_star - LT2;
-      const RealNumType CS3 = LT3_star - LT3;
-
-      // find CS_first and CS_second which are the highest and the second
-      // highest among CSX* values
-      RealNumType CS_first, CS_second;
-      findTwoLargest(CS1, CS2, CS3, CS_first, CS_second);
-
-      // increase sh_count if the condition (aLRT > 2(CS_first - CS_second) +
-      // epsilon) is satisfied
-      // <=> half_aLRT > CS_first - CS_second + half_epsilon
-      if (nodelh.getHalf_aLRT() >
-          (CS_first - CS_second + params->aLRT_SH_half_epsilon))
-        ++sh_count;
-    }  // for aLRT_SH_replicates
-  }    // omp parallel
+  // compute LT2*, LT3* of all replicates at once: the replicates only differ
+  // at the sites where the NNI neighbors differ from the ML tree, each weighted
+  // by the number of times it was resampled
+  // NOTES: LT2*, LT3* are the lh differences between the actual LT2*,
+  // LT3* and LT1*
+  const std::vector<RealNumType>::size_type num_replicates =
+      static_cast<std::vector<RealNumType>::size_type>(
+          params->aLRT_SH_replicates);
+  std::vector<RealNumType>& LT2_stars = buffers.LT2_stars;
+  std::vector<RealNumType>& LT3_stars = buffers.LT3_stars;
+  LT2_stars.assign(num_replicates, 0);
+  LT3_stars.assign(num_replicates, 0);
+  for (const SiteLhDiff& site_diff : site_lh_diff_2) {
+    addResampledSiteLhDiff(LT2_stars, resampling_counts, site_diff.position,
+                           site_diff.delta);
+  }
+  for (const SiteLhDiff& site_diff : site_lh_diff_3) {
+    addResampledSiteLhDiff(LT3_stars, resampling_counts, site_diff.position,
+                           site_diff.delta);
+  }
+
+  // iterate a number of replicates
+  for (std::vector<RealNumType>::size_type i = 0; i < num_replicates; ++i) {
+    const RealNumType LT2_star = LT2_stars[i];
+    const RealNumType LT3_star = LT3_stars[i];
+
+    // compute the centered sums CS1*, CS2*, CS3*
+    // where CSX* = LTX* - LTX, shifted by LT1 - LT1* (which does not change
+    // the difference between the highest and the second highest)
+    const RealNumType CS1 = 0;
+    const RealNumType CS2 =
+        valid_2 ? LT2_star - nodelh.getLhDiff2() : MIN_NEGATIVE;
+    const RealNumType CS3 =
+        valid_3 ? LT3_star - nodelh.getLhDiff3() : MIN_NEGATIVE;
+
+    // find CS_first and CS_second which are the highest and the second
+    // highest among CSX* values
+    RealNumType CS_first, CS_second;
+    findTwoLargest(CS1, CS2, CS3, CS_first, CS_second);
+
+    // increase sh_count if the condition (aLRT > 2(CS_first - CS_second) +
+    // epsilon) is satisfied
+    // <=> half_aLRT > CS_first - CS_second + half_epsilon
+    if (nodelh.getHalf_aLRT() >
+        (CS_first - CS_second + params->aLRT_SH_half_epsilon))
+      ++sh_count;
+  }  // for aLRT_SH_replicates
 
   return sh_count;
 }
 
 template <const StateType num_states>
 void cmaple::Tree::calculate_aRLT_SH(
-    std::vector<RealNumType>& site_lh_contributions,
-    std::vector<RealNumType>& site_lh_root,
-    const RealNumType& LT1) {
+    std::vector<RealNumType>& site_lh_root) {
   const RealNumType replicate_inverse = 100.0 / params->aLRT_SH_replicates;
 
-  // traverse tree to calculate aLRT-SH for each internal branch
+  // traverse tree to collect the internal branches
   PhyloNode& root = nodes[root_vector_index];
 
   // aLRT-SH at root branch is zero
   node_lhs[root.getNodelhIndex()].set_aLRT_SH(0);
 
+  std::vector<NumSeqsType> branch_vecs;
   std::stack<Index> node_stack;
   if (root.isInternal()) {
     node_stack.push(root.getNeighborIndex(RIGHT));
@@ -7094,25 +7842,67 @@ void cmaple::Tree::calculate_aRLT_SH(
 
       // only compute the aLRT for internal non-zero branches
       if (node.getUpperLength() > 0) {
-        node_lhs[node.getNodelhIndex()].set_aLRT_SH(
-            replicate_inverse *
-            count_aRLT_SH_branch<num_states>(site_lh_contributions,
-                                             site_lh_root, node, LT1));
-
-        // print out the aLRT (for debugging only)
-        // std::cout << std::setprecision(3) << "aLRT-SH (node_vec: " <<
-        // node_vec << "): " << node_lhs[node.getNodelhIndex()].get_aLRT_SH() <<
-        // std::endl;
+        branch_vecs.push_back(node_vec);
       }
       // return zero for zero-length internal branches
       else {
         node_lhs[node.getNodelhIndex()].set_aLRT_SH(0);
-        // print out the aLRT (for debugging only)
-        // std::cout << std::setprecision(3) << "aLRT-SH (node_vec: " <<
-        // node_vec << "): 0 (*zero-length branch)" << std::endl;
       }
     }
   }
+
+  // draw the resampled sites of all replicates once; all branches share them
+  // so the supports do not depend on the number of threads
+  // resampling_counts[pos * num_replicates + i] = the number of times site
+  // pos is resampled in replicate i
+  const std::vector<uint8_t>::size_type seq_length = aln->ref_seq.size();
+  const std::vector<uint8_t>::size_type num_replicates =
+      static_cast<std::vector<uint8_t>::size_type>(
+          params->aLRT_SH_replicates);
+  std::vector<uint8_t> resampling_counts(seq_length * num_replicates, 0);
+  std::default_random_engine gen(static_cast<unsigned int>(params->ran_seed));
+  std::uniform_int_distribution<> rng_distrib(0, static_cast<int>(seq_length) - 1);
+  for (std::vector<uint8_t>::size_type i = 0; i < num_replicates; ++i) {
+    for (std::vector<uint8_t>::size_type j = 0; j < seq_length; ++j) {
+      uint8_t& count = resampling_counts[static_cast<
+          std::vector<uint8_t>::size_type>(rng_distrib(gen)) * num_replicates +
+                                         i];
+      if (count == UINT8_MAX) {
+        throw std::logic_error("A site was resampled more than " +
+                               convertIntToString(UINT8_MAX) + " times");
+      }
+      ++count;
+    }
+  }
+
+  // distribute the branches among threads; branch costs vary a lot (the
+  // site-lh differences may be propagated up to the root), so threads pick
+  // the next branch dynamically
+  const PositionType num_branches = static_cast<PositionType>(branch_vecs.size());
+  std::exception_ptr branch_exception = nullptr;
+#pragma omp parallel if (num_branches > 1)
+  {
+    ALRTSHBuffers buffers;
+#pragma omp for schedule(dynamic)
+    for (PositionType i = 0; i < num_branches; ++i) {
+      try {
+        PhyloNode& node = nodes[branch_vecs[static_cast<
+            std::vector<NumSeqsType>::size_type>(i)]];
+        node_lhs[node.getNodelhIndex()].set_aLRT_SH(
+            replicate_inverse *
+            count_aRLT_SH_branch<num_states>(site_lh_root, resampling_counts,
+                                             node, buffers));
+      } catch (...) {
+#pragma omp critical
+        if (!branch_exception) {
+          branch_exception = std::current_exception();
+        }
+      }
+    }
+  }  // omp parallel
+  if (branch_exception) {
+    std::rethrow_exception(branch_exception);
+  }
 }
 
 template <const StateType num_states>
@@ -8261,43 +9051,159 @@ RealNumType cmaple::Tree::calculateSiteLhs(
   return total_lh;
 }
 
-NumSeqsType cmaple::Tree::parseFile(
-    std::istream& infile,
-    char& ch,
-    RealNumType& branch_len,
+NumSeqsType cmaple::Tree::parseNewick(
+    const std::string& newick,
     PositionType& in_line,
     PositionType& in_column,
-    const std::map<std::string, NumSeqsType>& map_seqname_index,
+    const std::unordered_map<std::string, NumSeqsType>& map_seqname_index,
     bool& missing_blengths) {
-  int maxlen = 1000;
-  string seqname;
-  int seqlen;
-  RealNumType brlen = -1;
-
-  // create new node
-  NumSeqsType tmp_root_vec;
-  // start with "(" -> an internal node
-  if (ch == '(') {
-    createAnInternalNode();
-    tmp_root_vec = static_cast<NumSeqsType>(nodes.size()) - 1;
-  }
-  // otherwise, it's a leaf
-  else {
-    createALeafNode(0);
-    tmp_root_vec = static_cast<NumSeqsType>(nodes.size()) - 1;
-  }
+  const int maxlen = 1000;
+  NewickReader reader(newick, in_line, in_column);
+  std::string seqname;
+  seqname.reserve(64);
+
+  // An internal node whose children are being read
+  struct Clade {
+    NumSeqsType node_vec;
+    // the mini-index of its next child (UNDEFINED if it already has two)
+    MiniIndex child_mini;
+    // the branch length of the last child read (-1: missing)
+    RealNumType brlen;
+  };
+  std::vector<Clade> clades;
+  // the branch length above the top node (unused)
+  RealNumType top_brlen = -1;
+
+  char ch = reader.nextChar();
+  if (ch != '(') {
+    throw "Tree file does not start with an opening-bracket '('";
+  }
+
+  // read the name (and the branch length) of the node that has just been
+  // read
+  auto readNameAndLength = [&](const NumSeqsType node_vec,
+                               RealNumType& branch_len) {
+    int seqlen = 0;
+    char end_ch = 0;
+    if (ch == '\'' || ch == '"') {
+      end_ch = ch;
+    }
+    seqname.clear();
+
+    while (!reader.eof() && seqlen < maxlen) {
+      if (end_ch == 0) {
+        if (is_newick_token(ch) || controlchar(ch)) {
+          break;
+        }
+      }
+      seqname += ch;
+      seqlen++;
+      ch = reader.get();
+      in_column++;
+      if (end_ch != 0 && ch == end_ch) {
+        seqname += ch;
+        seqlen++;
+        break;
+      }
+    }
+    if ((controlchar(ch) || ch == '[' || ch == end_ch) && !reader.eof()) {
+      ch = reader.nextChar(ch);
+    }
+    if (seqlen == maxlen) {
+      throw "Too long name ( > 1000)";
+    }
+    PhyloNode& node = nodes[node_vec];
+    if (!node.isInternal()) {
+      renameString(seqname);
+    }
+    if (seqlen == 0 && !node.isInternal()) {
+      throw "Redundant double-bracket ‘((…))’ with closing bracket ending at";
+    }
+    if (seqlen > 0 && !node.isInternal()) {
+      auto it = map_seqname_index.find(seqname);
+      if (it == map_seqname_index.end()) {
+        throw "Leaf " + seqname +
+            " is not found in the alignment. Please check and try again!";
+      } else {
+        const NumSeqsType sequence_index = it->second;
+        node.setSeqNameIndex(sequence_index);
+        node.setPartialLh(
+            TOP, aln->data[sequence_index].getLowerLhVector(
+                     static_cast<PositionType>(aln->ref_seq.size()),
+                     aln->num_states, aln->getSeqType()));
+
+        // mark the sequece as added (to the tree)
+        sequence_added[sequence_index] = true;
+      }
+    }
+
+    if (ch == ';' || reader.eof()) {
+      return;
+    }
+    // parse branch length
+    if (ch == ':') {
+      ch = reader.nextChar();
+      seqlen = 0;
+      seqname.clear();
+      while (!is_newick_token(ch) && !controlchar(ch) && !reader.eof() &&
+             seqlen < maxlen) {
+        seqname += ch;
+        seqlen++;
+        ch = reader.get();
+        in_column++;
+      }
+      if ((controlchar(ch) || ch == '[') && !reader.eof()) {
+        ch = reader.nextChar(ch);
+      }
+      if (seqlen == maxlen || reader.eof()) {
+        throw "branch length format error.";
+      }
+      branch_len = convert_real_number(seqname.c_str());
+    }
+  };
+
+  // The nodes are created in the same (pre-)order as a recursive descent
+  while (true) {
+    // create a new node: start with "(" -> an internal node
+    NumSeqsType node_vec;
+    if (ch == '(') {
+      createAnInternalNode();
+      node_vec = static_cast<NumSeqsType>(nodes.size()) - 1;
+      clades.push_back({node_vec, RIGHT, -1});
+      ch = reader.nextChar();
+      // read its first child
+      if (ch != ')' && !reader.eof()) {
+        continue;
+      }
+      // or close it (without any child)
+      if (!reader.eof()) {
+        ch = reader.nextChar();
+      }
+      clades.pop_back();
+    }
+    // otherwise, it's a leaf
+    else {
+      createALeafNode(0);
+      node_vec = static_cast<NumSeqsType>(nodes.size()) - 1;
+    }
 
-  // start with "(" -> an internal node
-  if (ch == '(') {
-    MiniIndex child_mini = RIGHT;
+    // finish the nodes whose children have all been read
+    bool read_next_child = false;
+    while (!read_next_child) {
+      RealNumType& branch_len =
+          clades.empty() ? top_brlen : clades.back().brlen;
+      readNameAndLength(node_vec, branch_len);
 
-    ch = readNextChar(infile, in_line, in_column);
-    while (ch != ')' && !infile.eof()) {
-      const NumSeqsType tmp_node_vec =
-          parseFile(infile, ch, brlen, in_line, in_column, map_seqname_index,
-                    missing_blengths);
+      if (clades.empty()) {
+        if (reader.eof() || ch != ';') {
+          throw "Tree file must be ended with a semi-colon ';'";
+        }
+        return node_vec;
+      }
 
-      if (child_mini == UNDEFINED) {
+      // attach the node to its parent
+      Clade& parent = clades.back();
+      if (parent.child_mini == UNDEFINED) {
         if (cmaple::verbose_mode > cmaple::VB_QUIET) {
           std::cout << "Converting a mutifurcating to a bifurcating tree"
                     << std::endl;
@@ -8305,222 +9211,73 @@ NumSeqsType cmaple::Tree::parseFile(
 
         // create a new parent node
         createAnInternalNode();
-        const NumSeqsType new_tmp_root_vec = static_cast<NumSeqsType>(nodes.size()) - 1;
-        // connect the current root node to the new parent node
-        nodes[new_tmp_root_vec].setNeighborIndex(RIGHT,
-                                                 Index(tmp_root_vec, TOP));
-        PhyloNode& current_root = nodes[tmp_root_vec];
-        current_root.setNeighborIndex(TOP, Index(new_tmp_root_vec, RIGHT));
-        current_root.setUpperLength(0);
-
-        // the new parent becomes the current root node -> new child will be
-        // added as the left child of the (new) root node
-        tmp_root_vec = new_tmp_root_vec;
-        child_mini = LEFT;
+        const NumSeqsType new_parent_vec =
+            static_cast<NumSeqsType>(nodes.size()) - 1;
+        // connect the current parent node to the new parent node
+        nodes[new_parent_vec].setNeighborIndex(RIGHT,
+                                               Index(parent.node_vec, TOP));
+        PhyloNode& current_parent = nodes[parent.node_vec];
+        current_parent.setNeighborIndex(TOP, Index(new_parent_vec, RIGHT));
+        current_parent.setUpperLength(0);
+
+        // the new parent becomes the current parent node -> new child will be
+        // added as the left child of the (new) parent node
+        parent.node_vec = new_parent_vec;
+        parent.child_mini = LEFT;
       }
 
-      PhyloNode& node = nodes[tmp_node_vec];
-      nodes[tmp_root_vec].setNeighborIndex(child_mini,
-                                           Index(tmp_node_vec, TOP));
-      node.setNeighborIndex(TOP, Index(tmp_root_vec, child_mini));
+      PhyloNode& node = nodes[node_vec];
+      nodes[parent.node_vec].setNeighborIndex(parent.child_mini,
+                                              Index(node_vec, TOP));
+      node.setNeighborIndex(TOP, Index(parent.node_vec, parent.child_mini));
       // If the branch length is not specify -> set it to default_blength and
       // mark the tree with missing blengths so that we can re-estimate the
       // blengths later
-      if (brlen == -1) {
-        brlen = default_blength;
+      if (parent.brlen == -1) {
+        parent.brlen = default_blength;
         missing_blengths = true;
       }
-      node.setUpperLength(brlen);
+      node.setUpperLength(parent.brlen);
 
       // change to the second child
-      child_mini = (child_mini == RIGHT) ? LEFT : UNDEFINED;
+      parent.child_mini = (parent.child_mini == RIGHT) ? LEFT : UNDEFINED;
 
-      if (infile.eof()) {
+      if (reader.eof()) {
         throw "Expecting ')', but end of file instead";
       }
       if (ch == ',') {
-        ch = readNextChar(infile, in_line, in_column);
+        ch = reader.nextChar();
       } else if (ch != ')') {
         string err = "Expecting ')', but found '";
         err += ch;
         err += "' instead";
         throw err;
       }
-    }
-    if (!infile.eof()) {
-      ch = readNextChar(infile, in_line, in_column);
-    }
-  }
-
-  // now read the node name
-  seqlen = 0;
-  char end_ch = 0;
-  if (ch == '\'' || ch == '"') {
-    end_ch = ch;
-  }
-  seqname = "";
-
-  while (!infile.eof() && seqlen < maxlen) {
-    if (end_ch == 0) {
-      if (is_newick_token(ch) || controlchar(ch)) {
-        break;
-      }
-    }
-    seqname += ch;
-    seqlen++;
-    ch = infile.get();
-    in_column++;
-    if (end_ch != 0 && ch == end_ch) {
-      seqname += ch;
-      seqlen++;
-      break;
-    }
-  }
-  if ((controlchar(ch) || ch == '[' || ch == end_ch) && !infile.eof()) {
-    ch = readNextChar(infile, in_line, in_column, ch);
-  }
-  if (seqlen == maxlen) {
-    throw "Too long name ( > 1000)";
-  }
-  PhyloNode& tmp_root = nodes[tmp_root_vec];
-  if (!tmp_root.isInternal()) {
-    renameString(seqname);
-  }
-  //    seqname[seqlen] = 0;
-  if (seqlen == 0 && !tmp_root.isInternal()) {
-    throw "Redundant double-bracket ‘((…))’ with closing bracket ending at";
-  }
-  if (seqlen > 0 && !tmp_root.isInternal()) {
-    auto it = map_seqname_index.find(seqname);
-    if (it == map_seqname_index.end()) {
-      throw "Leaf " + seqname +
-          " is not found in the alignment. Please check and try again!";
-    } else {
-      const NumSeqsType sequence_index = it->second;
-      tmp_root.setSeqNameIndex(sequence_index);
-      tmp_root.setPartialLh(TOP, aln->data[sequence_index]
-                .getLowerLhVector(static_cast<PositionType>(aln->ref_seq.size()),
-                                  aln->num_states, aln->getSeqType()));
 
-      // mark the sequece as added (to the tree)
-      sequence_added[sequence_index] = true;
-    }
-  }
-  /*if (!tmp_root.isInternal()) {
-      // is a leaf, assign its ID
-      if (leafNum == 0)
-          cmaple::Tree::root_vector_index = root;
-  }*/
-
-  if (ch == ';' || infile.eof()) {
-    return tmp_root_vec;
-  }
-  // parse branch length
-  if (ch == ':') {
-    // string saved_comment = in_comment;
-    ch = readNextChar(infile, in_line, in_column);
-    /*if (in_comment.empty())
-        in_comment = saved_comment;*/
-    seqlen = 0;
-    seqname = "";
-    while (!is_newick_token(ch) && !controlchar(ch) && !infile.eof() &&
-           seqlen < maxlen) {
-      //            seqname[seqlen] = ch;
-      seqname += ch;
-      seqlen++;
-      ch = infile.get();
-      in_column++;
-    }
-    if ((controlchar(ch) || ch == '[') && !infile.eof()) {
-      ch = readNextChar(infile, in_line, in_column, ch);
-    }
-    if (seqlen == maxlen || infile.eof()) {
-      throw "branch length format error.";
-    }
-    branch_len = convert_real_number(seqname.c_str());
-  }
-  // handle the case of multiple-length branches but lack of the average branch
-  // length e.g A[0.1/0.2/0.3/0.4] instead of A[0.1/0.2/0.3/0.4]:0.25
-  /*else if (in_comment.length())
-  {
-      // set default average branch length at 0
-      string default_avg_length = "0";
-      parseBranchLength(default_avg_length, branch_len);
-  }*/
-
-  return tmp_root_vec;
-}
-
-const char cmaple::Tree::readNextChar(std::istream& in,
-                                      PositionType& in_line,
-                                      PositionType& in_column,
-                                      const char& current_ch) const {
-  char ch;
-  if (current_ch == '[') {
-    ch = current_ch;
-  } else {
-    in.get(ch);
-    in_column++;
-
-    if (ch == 10) {
-      in_line++;
-      in_column = 1;
-    }
-  }
-  // check if ch is a control character (ascii <= 32)
-  while (controlchar(ch) && !in.eof()) {
-    in.get(ch);
-    in_column++;
-
-    if (ch == 10) {
-      in_line++;
-      in_column = 1;
-    }
-  }
-  string in_comment = "";
-  // ignore comment
-  while (ch == '[' && !in.eof()) {
-    while (ch != ']' && !in.eof()) {
-      in.get(ch);
-      if (ch != ']') {
-        in_comment += ch;
+      // read the next child of the parent
+      if (ch != ')' && !reader.eof()) {
+        read_next_child = true;
       }
-      in_column++;
-      if (ch == 10) {
-        in_line++;
-        in_column = 1;
-      }
-    }
-    if (ch != ']') {
-      throw "Comments not ended with ]";
-    }
-    in_column++;
-    in.get(ch);
-    if (ch == 10) {
-      in_line++;
-      in_column = 1;
-    }
-    while (controlchar(ch) && !in.eof()) {
-      in_column++;
-      in.get(ch);
-      if (ch == 10) {
-        in_line++;
-        in_column = 1;
+      // or close the parent
+      else {
+        if (!reader.eof()) {
+          ch = reader.nextChar();
+        }
+        node_vec = parent.node_vec;
+        clades.pop_back();
       }
     }
-    if (in_comment.length() && cmaple::verbose_mode > cmaple::VB_QUIET) {
-      std::cout << "Ignore [" + in_comment + "]" << std::endl;
-    }
   }
-  return ch;
 }
 
-std::map<std::string, NumSeqsType> cmaple::Tree::initMapSeqNameIndex() {
+std::unordered_map<std::string, NumSeqsType>
+cmaple::Tree::initMapSeqNameIndex() {
   assert(aln);
 
   // create the map
-  std::map<std::string, NumSeqsType> map_seqname_index;
+  std::unordered_map<std::string, NumSeqsType> map_seqname_index;
   const std::vector<Sequence>& sequences = aln->data;
+  map_seqname_index.reserve(sequences.size());
   for (NumSeqsType i = 0; i < sequences.size(); ++i) {
     map_seqname_index.emplace(sequences[i].seq_name, i);
   }
@@ -8530,7 +9287,7 @@ std::map<std::string, NumSeqsType> cmaple::Tree::initMapSeqNameIndex() {
 
 NumSeqsType cmaple::Tree::markAnExistingSeq(
     const std::string& seq_name,
-    const std::map<std::string, NumSeqsType>& map_name_index) {
+    const std::unordered_map<std::string, NumSeqsType>& map_name_index) {
   NumSeqsType new_seq_index = 0;
 
   // Find the sequence name
@@ -8554,7 +9311,8 @@ void cmaple::Tree::remarkExistingSeqs() {
   assert(aln);
 
   // init a mapping between sequence names and its index in the alignment
-  std::map<std::string, NumSeqsType> map_name_index = initMapSeqNameIndex();
+  std::unordered_map<std::string, NumSeqsType> map_name_index =
+      initMapSeqNameIndex();
 
   // reset all marked sequences
   resetSeqAdded();
@@ -8583,7 +9341,8 @@ bool cmaple::Tree::readTree(std::istream& tree_stream) {
   bool missing_blengths = false;
 
   // create a map between leave and sequences in the alignment
-  std::map<std::string, NumSeqsType> map_seqname_index = initMapSeqNameIndex();
+  std::unordered_map<std::string, NumSeqsType> map_seqname_index =
+      initMapSeqNameIndex();
 
   if (cmaple::verbose_mode >= cmaple::VB_MED) {
     std::cout << "Reading a tree" << std::endl;
@@ -8595,17 +9354,16 @@ bool cmaple::Tree::readTree(std::istream& tree_stream) {
   // std::string in_comment{};
 
   try {
-    char ch;
-    ch = readNextChar(tree_stream, in_line, in_column);
-    if (ch != '(') {
-      cout << tree_stream.rdbuf() << endl;
-      throw "Tree file does not start with an opening-bracket '('";
-    }
+    std::string newick;
+    readNewickString(tree_stream, newick);
+
+    // each leaf adds at most two nodes (itself and its parent)
+    const std::size_t num_leaves = static_cast<std::size_t>(
+        std::count(newick.begin(), newick.end(), ',')) + 1;
+    nodes.reserve(nodes.size() + num_leaves + num_leaves);
 
-    RealNumType branch_len;
-    const NumSeqsType tmp_node_vec =
-        parseFile(tree_stream, ch, branch_len, in_line, in_column, map_seqname_index,
-                  missing_blengths);
+    const NumSeqsType tmp_node_vec = parseNewick(
+        newick, in_line, in_column, map_seqname_index, missing_blengths);
 
     // set root
     if (nodes[tmp_node_vec].isInternal()) {
@@ -8646,10 +9404,6 @@ bool cmaple::Tree::readTree(std::istream& tree_stream) {
     }
     // make sure that root is a leaf
     assert(root->isLeaf());*/
-
-    if (tree_stream.eof() || ch != ';') {
-      throw "Tree file must be ended with a semi-colon ';'";
-    }
   } catch (bad_alloc) {
     throw std::bad_alloc();
   } catch (const char* str) {
@@ -9044,6 +9798,328 @@ cmaple::Tree::TreeType cmaple::Tree::parseTreeType(
   return cmaple::Tree::UNKNOWN_TREE;
 }
 
+void cmaple::Tree::saveCheckpoint(const std::string& checkpoint_filename) {
+  assert(aln && model);
+
+  // write to a temporary file, then replace the checkpoint file, so that an
+  // interruption never leaves a partial checkpoint behind
+  const std::string tmp_filename = checkpoint_filename + ".tmp";
+  std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::logic_error("Failed to open checkpoint file " + tmp_filename);
+  }
+  writeCheckpoint(out);
+  out.close();
+  if (!out || std::rename(tmp_filename.c_str(), checkpoint_filename.c_str())) {
+    throw std::logic_error("Failed to write checkpoint file " +
+                           checkpoint_filename);
+  }
+  last_checkpoint_time = getRealTime();
+
+  if (cmaple::verbose_mode >= cmaple::VB_MAX) {
+    std::cout << "Checkpoint saved to " << checkpoint_filename << std::endl;
+  }
+}
+
+void cmaple::Tree::loadCheckpoint(const std::string& checkpoint_filename) {
+  assert(aln && model);
+
+  if (!fileExists(checkpoint_filename)) {
+    throw std::invalid_argument("Checkpoint file " + checkpoint_filename +
+                                " is not found!");
+  }
+  std::unique_ptr<MappedFile> file;
+  try {
+    file = cmaple::make_unique<MappedFile>(checkpoint_filename);
+  } catch (const std::ios_base::failure&) {
+    throw std::invalid_argument("Failed to open checkpoint file " +
+                                checkpoint_filename);
+  }
+
+  if (cmaple::verbose_mode >= cmaple::VB_MED) {
+    std::cout << "Resuming from checkpoint " << checkpoint_filename
+              << std::endl;
+  }
+  readCheckpoint(file->data(), file->data() + file->size());
+  last_checkpoint_time = getRealTime();
+}
+
+void cmaple::Tree::writeCheckpoint(std::ostream& out_stream) {
+  const StateType num_states = model->num_states_;
+  const std::size_t mat_size =
+      static_cast<std::size_t>(num_states) * num_states;
+  std::string out;
+  out.reserve(CHECKPOINT_BUFFER_SIZE + CHECKPOINT_BUFFER_SIZE / 2);
+  auto flush = [&out, &out_stream]() {
+    out_stream.write(out.data(), static_cast<std::streamsize>(out.size()));
+    out.clear();
+  };
+
+  // header
+  out.append(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  putValue<uint32_t>(out, CHECKPOINT_VERSION);
+  putValue<uint8_t>(out, inference_phase);
+  putValue<uint16_t>(out, num_states);
+  putValue<uint16_t>(out, static_cast<uint16_t>(sizeof(SeqRegion::LHType)));
+  putValue<uint32_t>(out, static_cast<uint32_t>(aln->data.size()));
+  putValue<PositionType>(out, static_cast<PositionType>(aln->ref_seq.size()));
+  putValue<uint64_t>(out, hashAlignment(*aln));
+  putValue<uint8_t>(out, fixed_blengths);
+  putValue<NumSeqsType>(out, root_vector_index);
+
+  // model parameters
+  putValue<RealNumType>(out, model->normalized_factor);
+  putValue<uint8_t>(out, model->pseu_mutation_count != nullptr);
+  if (model->pseu_mutation_count) {
+    putArray(out, model->pseu_mutation_count, mat_size);
+  }
+  putArray(out, model->root_freqs, num_states);
+  putArray(out, model->root_log_freqs, num_states);
+  putArray(out, model->inverse_root_freqs, num_states);
+  putArray(out, model->mutation_mat, mat_size);
+  putArray(out, model->diagonal_mut_mat, num_states);
+  putArray(out, model->transposed_mut_mat, mat_size);
+  putArray(out, model->freqi_freqj_qij, mat_size);
+  putArray(out, model->freq_j_transposed_ij, mat_size);
+
+  // sequences added to the tree
+  std::vector<uint8_t> added((sequence_added.size() + 7) / 8, 0);
+  for (std::vector<bool>::size_type i = 0; i < sequence_added.size(); ++i) {
+    if (sequence_added[i]) {
+      added[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    }
+  }
+  putArray(out, added.data(), added.size());
+
+  // likelihood contributions (and branch supports) of internal nodes
+  putValue<uint32_t>(out, static_cast<uint32_t>(node_lhs.size()));
+  for (const NodeLh& node_lh : node_lhs) {
+    putValue<RealNumType>(out, node_lh.getLhDiff2());
+    putValue<RealNumType>(out, node_lh.getLhDiff3());
+    putValue<RealNumType>(out, node_lh.getLhContribution());
+    putValue<RealNumType>(out, node_lh.get_aLRT_SH());
+  }
+
+  // nodes
+  putValue<uint32_t>(out, static_cast<uint32_t>(nodes.size()));
+  for (PhyloNode& node : nodes) {
+    if (out.size() >= CHECKPOINT_BUFFER_SIZE) {
+      flush();
+    }
+    putValue<uint8_t>(out, node.isInternal());
+    putValue<uint8_t>(out, node.isOutdated());
+    putValue<uint8_t>(out, node.getSPRCount());
+    putValue<float>(out, static_cast<float>(node.getUpperLength()));
+    if (node.isInternal()) {
+      for (const MiniIndex mini_index : {TOP, LEFT, RIGHT}) {
+        putValue<uint32_t>(out, packIndex(node.getNeighborIndex(mini_index)));
+      }
+      putValue<NumSeqsType>(out, node.getNodelhIndex());
+      for (const MiniIndex mini_index : {TOP, LEFT, RIGHT}) {
+        writeRegions(out, node.getPartialLh(mini_index));
+      }
+    } else {
+      putValue<NumSeqsType>(out, node.getSeqNameIndex());
+      putValue<uint32_t>(out, packIndex(node.getNeighborIndex(TOP)));
+      const std::vector<NumSeqsType>& less_info_seqs = node.getLessInfoSeqs();
+      putValue<uint32_t>(out, static_cast<uint32_t>(less_info_seqs.size()));
+      putArray(out, less_info_seqs.data(), less_info_seqs.size());
+      writeRegions(out, node.getPartialLh(TOP));
+    }
+    writeRegions(out, node.getTotalLh());
+    writeRegions(out, node.getMidBranchLh());
+  }
+  flush();
+}
+
+void cmaple::Tree::readCheckpoint(const char* const begin,
+                                  const char* const end) {
+  const StateType num_states = model->num_states_;
+  const std::size_t mat_size =
+      static_cast<std::size_t>(num_states) * num_states;
+  const NumSeqsType num_seqs = static_cast<NumSeqsType>(aln->data.size());
+  const PositionType seq_length =
+      static_cast<PositionType>(aln->ref_seq.size());
+
+  // header
+  BinaryReader in(begin, end, "checkpoint");
+  if (static_cast<size_t>(end - begin) < sizeof(CHECKPOINT_MAGIC) ||
+      !std::equal(CHECKPOINT_MAGIC,
+                  CHECKPOINT_MAGIC + sizeof(CHECKPOINT_MAGIC),
+                  in.getBytes(sizeof(CHECKPOINT_MAGIC)))) {
+    throw std::logic_error("The file is not a CMAPLE checkpoint!");
+  }
+  if (getValue<uint32_t>(in) != CHECKPOINT_VERSION) {
+    throw std::logic_error("Unsupported version of checkpoint!");
+  }
+  const uint8_t phase = getValue<uint8_t>(in);
+  if (phase > PHASE_DONE) {
+    throw std::logic_error("Corrupted checkpoint (phase)!");
+  }
+  if (getValue<uint16_t>(in) != num_states ||
+      getValue<uint16_t>(in) != sizeof(SeqRegion::LHType)) {
+    throw std::invalid_argument(
+        "The checkpoint was saved for another sequence type!");
+  }
+  if (getValue<uint32_t>(in) != num_seqs ||
+      getValue<PositionType>(in) != seq_length ||
+      getValue<uint64_t>(in) != hashAlignment(*aln)) {
+    throw std::invalid_argument(
+        "The checkpoint was saved for another alignment!");
+  }
+  const bool n_fixed_blengths = getValue<uint8_t>(in);
+  const NumSeqsType n_root_vector_index = getValue<NumSeqsType>(in);
+
+  // model parameters
+  const RealNumType normalized_factor = getValue<RealNumType>(in);
+  std::vector<RealNumType> pseu_mutation_count;
+  if (getValue<uint8_t>(in)) {
+    pseu_mutation_count.resize(mat_size);
+    getArray(in, pseu_mutation_count.data(), mat_size);
+  }
+  std::vector<RealNumType> model_arrays(4 * num_states + 4 * mat_size);
+  getArray(in, model_arrays.data(), model_arrays.size());
+
+  // sequences added to the tree
+  std::vector<uint8_t> added((num_seqs + 7) / 8);
+  getArray(in, added.data(), added.size());
+
+  // likelihood contributions (and branch supports) of internal nodes
+  const uint32_t num_node_lhs = getValue<uint32_t>(in);
+  if (num_node_lhs > num_seqs + 1) {
+    throw std::logic_error("Corrupted checkpoint (node likelihoods)!");
+  }
+  std::vector<NodeLh> n_node_lhs;
+  n_node_lhs.reserve(num_seqs);
+  for (uint32_t i = 0; i < num_node_lhs; ++i) {
+    const RealNumType lh_diff2 = getValue<RealNumType>(in);
+    const RealNumType lh_diff3 = getValue<RealNumType>(in);
+    n_node_lhs.emplace_back(getValue<RealNumType>(in));
+    n_node_lhs.back().setLhDiff2(lh_diff2);
+    n_node_lhs.back().setLhDiff3(lh_diff3);
+    n_node_lhs.back().set_aLRT_SH(getValue<RealNumType>(in));
+  }
+
+  // nodes
+  const uint32_t num_nodes = getValue<uint32_t>(in);
+  if (num_nodes > 2 * static_cast<uint32_t>(num_seqs) ||
+      (num_nodes && n_root_vector_index >= num_nodes)) {
+    throw std::logic_error("Corrupted checkpoint (nodes)!");
+  }
+  auto readIndex = [&in, num_nodes]() {
+    const Index index = unpackIndex(getValue<uint32_t>(in));
+    if (index.getVectorIndex() >= num_nodes) {
+      throw std::logic_error("Corrupted checkpoint (nodes)!");
+    }
+    return index;
+  };
+  std::vector<PhyloNode> n_nodes;
+  n_nodes.reserve(num_seqs + num_seqs);
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    const bool is_internal = getValue<uint8_t>(in);
+    const bool outdated = getValue<uint8_t>(in);
+    const uint8_t spr_count = getValue<uint8_t>(in);
+    const float length = getValue<float>(in);
+    if (is_internal) {
+      n_nodes.emplace_back(InternalNode());
+      PhyloNode& node = n_nodes.back();
+      for (const MiniIndex mini_index : {TOP, LEFT, RIGHT}) {
+        node.setNeighborIndex(mini_index, readIndex());
+      }
+      const NumSeqsType node_lh_index = getValue<NumSeqsType>(in);
+      if (node_lh_index >= num_node_lhs) {
+        throw std::logic_error("Corrupted checkpoint (nodes)!");
+      }
+      node.setNodeLhIndex(node_lh_index);
+      for (const MiniIndex mini_index : {TOP, LEFT, RIGHT}) {
+        node.setPartialLh(mini_index, readRegions(in, seq_length));
+      }
+    } else {
+      const NumSeqsType seq_name_index = getValue<NumSeqsType>(in);
+      if (seq_name_index >= num_seqs) {
+        throw std::logic_error("Corrupted checkpoint (nodes)!");
+      }
+      n_nodes.emplace_back(LeafNode(seq_name_index));
+      PhyloNode& node = n_nodes.back();
+      node.setNeighborIndex(TOP, readIndex());
+      const uint32_t num_less_info_seqs = getValue<uint32_t>(in);
+      if (num_less_info_seqs > num_seqs) {
+        throw std::logic_error("Corrupted checkpoint (nodes)!");
+      }
+      std::vector<NumSeqsType>& less_info_seqs = node.getLessInfoSeqs();
+      less_info_seqs.resize(num_less_info_seqs);
+      getArray(in, less_info_seqs.data(), num_less_info_seqs);
+      for (const NumSeqsType seq_index : less_info_seqs) {
+        if (seq_index >= num_seqs) {
+          throw std::logic_error("Corrupted checkpoint (nodes)!");
+        }
+      }
+      node.setPartialLh(TOP, readRegions(in, seq_length));
+    }
+    PhyloNode& node = n_nodes.back();
+    node.setOutdated(outdated);
+    node.setSPRCount(spr_count);
+    node.setUpperLength(length);
+    node.setTotalLh(readRegions(in, seq_length));
+    node.setMidBranchLh(readRegions(in, seq_length));
+  }
+
+  // everything was read -> update the tree and the model
+  nodes = std::move(n_nodes);
+  node_lhs = std::move(n_node_lhs);
+  if (node_lhs.empty()) {
+    node_lhs.emplace_back(0);
+  }
+  root_vector_index = n_root_vector_index;
+  fixed_blengths = n_fixed_blengths;
+  inference_phase = static_cast<InferencePhase>(phase);
+  sequence_added.resize(num_seqs);
+  for (NumSeqsType i = 0; i < num_seqs; ++i) {
+    sequence_added[i] = (added[i / 8] >> (i % 8)) & 1;
+  }
+
+  model->normalized_factor = normalized_factor;
+  if (!pseu_mutation_count.empty()) {
+    if (!model->pseu_mutation_count) {
+      model->pseu_mutation_count = new RealNumType[mat_size];
+    }
+    std::copy(pseu_mutation_count.begin(), pseu_mutation_count.end(),
+              model->pseu_mutation_count);
+  }
+  const RealNumType* model_array = model_arrays.data();
+  for (RealNumType* const values :
+       {model->root_freqs, model->root_log_freqs, model->inverse_root_freqs}) {
+    std::copy(model_array, model_array + num_states, values);
+    model_array += num_states;
+  }
+  std::copy(model_array, model_array + mat_size, model->mutation_mat);
+  model_array += mat_size;
+  std::copy(model_array, model_array + num_states, model->diagonal_mut_mat);
+  model_array += num_states;
+  for (RealNumType* const values :
+       {model->transposed_mut_mat, model->freqi_freqj_qij,
+        model->freq_j_transposed_ij}) {
+    std::copy(model_array, model_array + mat_size, values);
+    model_array += mat_size;
+  }
+
+  // the cumulative rates depend on the mutation matrix
+  computeCumulativeRate();
+}
+
+void cmaple::Tree::checkpoint() {
+  if (params && params->checkpoint_file.length()) {
+    saveCheckpoint(params->checkpoint_file);
+  }
+}
+
+void cmaple::Tree::checkpointIfDue() {
+  if (params && params->checkpoint_interval > 0 &&
+      getRealTime() - last_checkpoint_time >= params->checkpoint_interval) {
+    checkpoint();
+  }
+}
+
 void cmaple::Tree::computeCumulativeRate() {
   assert(aln && model);
   const std::vector<cmaple::StateType>::size_type sequence_length = aln->ref_seq.size();
@@ -9057,19 +10133,27 @@ void cmaple::Tree::computeCumulativeRate() {
     cumulative_rate = new RealNumType[sequence_length + 1];
   }
 
-  // init cumulative_base and cumulative_rate
-  cumulative_base.resize(sequence_length + 1);
-  cumulative_rate[0] = 0;
-  cumulative_base[0].resize(model->num_states_, 0);
-
-  // compute cumulative_base and cumulative_rate
+  // compute cumulative_base
   const std::vector<cmaple::StateType>& ref_seq = aln->ref_seq;
+  cumulative_base.compute(ref_seq, model->num_states_);
+
+  // compute cumulative_rate
+  cumulative_rate[0] = 0;
   cmaple::RealNumType* const diagonal_mut_mat = model->diagonal_mut_mat;
   for (std::vector<cmaple::StateType>::size_type i = 0; i < sequence_length; ++i) {
     StateType state = ref_seq[i];
     cumulative_rate[i + 1] = cumulative_rate[i] + diagonal_mut_mat[state];
+  }
 
-    cumulative_base[i + 1] = cumulative_base[i];
-    cumulative_base[i + 1][state] = cumulative_base[i][state] + 1;
+  // compute the transition terms for the default branch length
+  const size_t mat_size =
+      static_cast<size_t>(model->num_states_) * model->num_states_;
+  default_blength_mut_mat.resize(mat_size);
+  for (size_t i = 0; i < mat_size; ++i) {
+    default_blength_mut_mat[i] = model->mutation_mat[i] * default_blength;
+  }
+  for (StateType i = 0; i < model->num_states_; ++i) {
+    default_blength_mut_mat[model->row_index[i] + i] =
+        model->diagonal_mut_mat[i] * default_blength;
   }
 }
@@ -275,6 +275,39 @@ class Tree {
   std::string exportNewick(const TreeType tree_type = BIN_TREE,
                            const bool show_branch_supports = true);
 
+  /*! \brief Write the phylogenetic tree to a stream in NEWICK format.
+   * @param[in] out_stream The output stream
+   * @param[in] tree_type The type of the output tree (optional): BIN_TREE
+   * (bifurcating tree), MUL_TREE (multifurcating tree)
+   * @param[in] show_branch_supports TRUE to output the branch supports (aLRT-SH
+   * values)
+   * @throw std::invalid\_argument if any of the following situations occur.
+   * - tree\_type is unknown
+   */
+  void exportNewick(std::ostream& out_stream,
+                    const TreeType tree_type = BIN_TREE,
+                    const bool show_branch_supports = true);
+
+  /*! \brief Save the current state of the tree (the nodes and their
+   * likelihoods, the model parameters, and the phase of the inference) to a
+   * binary checkpoint file. The file is replaced atomically.
+   * @param[in] checkpoint_filename Name of the checkpoint file
+   * @throw std::logic\_error if failing to write the file
+   */
+  void saveCheckpoint(const std::string& checkpoint_filename);
+
+  /*! \brief Restore the tree from a checkpoint file (written by
+   * saveCheckpoint()) without re-computing the likelihoods. infer() then
+   * continues from the phase recorded in the checkpoint.
+   * @param[in] checkpoint_filename Name of the checkpoint file
+   * @throw std::invalid\_argument if any of the following situations occur.
+   * - the file is not found
+   * - the checkpoint was saved for another alignment or sequence type
+   *
+   * @throw std::logic\_error if the file is corrupted
+   */
+  void loadCheckpoint(const std::string& checkpoint_filename);
+
   // ----------------- END OF PUBLIC APIs ------------------------------------
   // //
 
@@ -312,10 +345,18 @@ class Tree {
    */
   cmaple::RealNumType* cumulative_rate = nullptr;
 
+  /**
+   The mutation matrix multiplied by default_blength (row by row): the
+   transition terms Q_ij * t of the placement costs of samples, which are
+   mostly evaluated with the default branch length (recomputed with the
+   cumulative rates)
+   */
+  std::vector<cmaple::RealNumType> default_blength_mut_mat;
+
   /**
    cumulative bases
    */
-  std::vector<std::vector<cmaple::PositionType>> cumulative_base;
+  CumulativeBase cumulative_base;
 
   /**
    Vector of phylonodes
@@ -345,6 +386,17 @@ class Tree {
    */
   std::vector<bool> sequence_added;
 
+  /**
+   TRUE to record the nodes whose likelihoods are updated by updatePartialLh()
+   into touched_nodes (used when committing a window of speculative placements)
+   */
+  bool track_touched_nodes = false;
+
+  /**
+   (vector) Indexes of the nodes updated since touched_nodes was last cleared
+   */
+  std::unordered_set<cmaple::NumSeqsType> touched_nodes;
+
   /*!
    * Apply some minor changes (collapsing zero-branch leaves into less-info
    * sequences, re-estimating model parameters) to make the processes of
@@ -533,6 +585,50 @@ class Tree {
    */
   void computeCumulativeRate();
 
+  /**
+   Phases of the inference (see doInferenceTemplate())
+   */
+  enum InferencePhase : uint8_t {
+    PHASE_PLACEMENT,
+    PHASE_TREE_SEARCH,
+    PHASE_BRANCH_OPTIMIZATION,
+    PHASE_DONE,
+  };
+
+  /**
+   The next phase of the inference to run (restored from a checkpoint)
+   */
+  InferencePhase inference_phase = PHASE_PLACEMENT;
+
+  /**
+   The time the last checkpoint was saved
+   */
+  double last_checkpoint_time = 0;
+
+  /**
+   Write the state of the tree to a checkpoint stream
+   */
+  void writeCheckpoint(std::ostream& out);
+
+  /**
+   Restore the state of the tree from the content of a checkpoint file
+   @param[in] begin, end The content of the checkpoint file
+   @throw std::invalid\_argument if the checkpoint doesn't match the alignment
+   @throw std::logic\_error if the checkpoint is corrupted
+   */
+  void readCheckpoint(const char* begin, const char* end);
+
+  /**
+   Save a checkpoint to the file specified in params (if any)
+   */
+  void checkpoint();
+
+  /**
+   Save a checkpoint if the period specified in params has passed since the
+   last one
+   */
+  void checkpointIfDue();
+
   /*! Optimize the tree topology
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
@@ -560,6 +656,50 @@ class Tree {
                                      PhyloNode& node,
                                      bool short_range_search);
 
+  /**
+   The outcome of searching an SPR move for a subtree, produced by
+   seekSubTreeSPR() and consumed by applySubTreeSPR()
+   */
+  struct SubTreeSPR {
+    bool blength_changed = false;
+    bool found_better_placement = false;
+    cmaple::RealNumType best_blength = 0;
+    cmaple::RealNumType best_lh = 0;
+    cmaple::Index best_node_index;
+    cmaple::RealNumType best_lh_diff = 0;
+    bool is_mid_node = false;
+    /**
+     (vector) Indexes of the nodes read by the search; the outcome is still
+     valid as long as none of them has been updated
+     */
+    std::vector<cmaple::NumSeqsType> footprint;
+  };
+
+  /**
+   Search (without modifying the tree) for a better branch length and a
+   better placement of the subtree rooted at node
+   @param record_footprint TRUE to record the nodes read by the search
+   @throw std::logic\_error if unexpected values/behaviors found during the
+   operations
+   */
+  template <const cmaple::StateType num_states>
+  void seekSubTreeSPR(const cmaple::Index index,
+                      PhyloNode& node,
+                      bool short_range_search,
+                      SubTreeSPR& spr,
+                      const bool record_footprint = false);
+
+  /**
+   Apply the outcome of seekSubTreeSPR() to the tree
+   @return total improvement
+   @throw std::logic\_error if unexpected values/behaviors found during the
+   operations
+   */
+  template <const cmaple::StateType num_states>
+  cmaple::RealNumType applySubTreeSPR(const cmaple::Index index,
+                                      PhyloNode& node,
+                                      const SubTreeSPR& spr);
+
   /**
    Calculate derivative starting from coefficients.
    @return derivative
@@ -600,6 +740,7 @@ class Tree {
 
   /**
    Traverse downwards polytomy for more fine-grained placement
+   @param visited_nodes if not null, the nodes examined are appended to it
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
@@ -608,7 +749,8 @@ class Tree {
       const PhyloNode& selected_node,
       cmaple::RealNumType& best_down_lh_diff,
       cmaple::Index& best_child_index,
-      const std::unique_ptr<SeqRegions>& sample_regions);
+      const std::unique_ptr<SeqRegions>& sample_regions,
+      std::vector<cmaple::NumSeqsType>* visited_nodes = nullptr);
 
   /**
    Add start nodes for seeking a placement for a subtree
@@ -1354,37 +1496,72 @@ class Tree {
       std::vector<cmaple::RealNumType>& site_lh_root);
 
   /**
-   Calculate aLRT-SH for each internal branches
+   Calculate aLRT-SH for each internal branches; branches are distributed
+   among threads
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
   template <const cmaple::StateType num_states>
-  void calculate_aRLT_SH(
-      std::vector<cmaple::RealNumType>& site_lh_contributions,
-      std::vector<cmaple::RealNumType>& site_lh_root,
-      const cmaple::RealNumType& LT1);
+  void calculate_aRLT_SH(std::vector<cmaple::RealNumType>& site_lh_root);
+
+  /**
+   Scratch buffers used to count aLRT-SH for a branch; each thread owns one
+   set, reused across all the branches it processes
+   */
+  struct ALRTSHBuffers {
+    /**
+     The new and the old site-lh contributions, as emitted by the region walks
+     of calSiteLhDiff(), and the changes of the site lhs at root
+     */
+    SparseSiteLhs site_lh_new;
+    SparseSiteLhs site_lh_old;
+    std::vector<SiteLhDiff> site_lh_root_diff;
+    /**
+     Scratch lists used to merge the contributions site by site
+     */
+    std::vector<SiteLhDiff> site_lhs;
+    std::vector<SparseSiteLhs::RRun> r_runs;
+    std::vector<std::pair<cmaple::PositionType, size_t>> r_run_bounds;
+    std::vector<size_t> active_r_runs;
+    /**
+     Sparse site-lh differences of the two NNI neighbors
+     */
+    std::vector<SiteLhDiff> site_lh_diff_2;
+    std::vector<SiteLhDiff> site_lh_diff_3;
+    /**
+     LT2*, LT3* (relative to LT1*) of each replicate
+     */
+    std::vector<cmaple::RealNumType> LT2_stars;
+    std::vector<cmaple::RealNumType> LT3_stars;
+  };
 
   /**
-   Count aLRT-SH for an internal branch
+   Count aLRT-SH for an internal branch (sequentially, using the given
+   scratch buffers)
+   @param resampling_counts the number of times each site is resampled in each
+   replicate, stored site by site
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
   template <const cmaple::StateType num_states>
   cmaple::PositionType count_aRLT_SH_branch(
-      std::vector<cmaple::RealNumType>& site_lh_contributions,
       std::vector<cmaple::RealNumType>& site_lh_root,
+      const std::vector<uint8_t>& resampling_counts,
       PhyloNode& node,
-      const cmaple::RealNumType& LT1);
+      ALRTSHBuffers& buffers);
 
   /**
    Calculate the site-lh differences  between an NNI neighbor on the branch
-   connecting to root and the ML tree
+   connecting to root and the ML tree; the new and the old site-lh
+   contributions are appended to site_lh_diff and site_lh_diff_old
+   @return FALSE if the NNI neighbor could not be evaluated
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
   template <const cmaple::StateType num_states>
-  void calSiteLhDiffRoot(std::vector<cmaple::RealNumType>& site_lh_diff,
-                         std::vector<cmaple::RealNumType>& site_lh_root_diff,
+  bool calSiteLhDiffRoot(SparseSiteLhs& site_lh_diff,
+                         SparseSiteLhs& site_lh_diff_old,
+                         std::vector<SiteLhDiff>& site_lh_root_diff,
                          const std::vector<cmaple::RealNumType>& site_lh_root,
                          std::unique_ptr<SeqRegions>& parent_new_lower_lh,
                          const cmaple::RealNumType& child_2_new_blength,
@@ -1397,14 +1574,17 @@ class Tree {
 
   /**
    Calculate the site-lh differences  between an NNI neighbor on the branch
-   connecting to a non-root node and the ML tree
+   connecting to a non-root node and the ML tree; the new and the old site-lh
+   contributions are appended to site_lh_diff and site_lh_diff_old
+   @return FALSE if the NNI neighbor could not be evaluated
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
   template <const cmaple::StateType num_states>
-  void calSiteLhDiffNonRoot(
-      std::vector<cmaple::RealNumType>& site_lh_diff,
-      std::vector<cmaple::RealNumType>& site_lh_root_diff,
+  bool calSiteLhDiffNonRoot(
+      SparseSiteLhs& site_lh_diff,
+      SparseSiteLhs& site_lh_diff_old,
+      std::vector<SiteLhDiff>& site_lh_root_diff,
       const std::vector<cmaple::RealNumType>& site_lh_root,
       std::unique_ptr<SeqRegions>& parent_new_lower_lh,
       const cmaple::RealNumType& child_2_new_blength,
@@ -1417,12 +1597,15 @@ class Tree {
 
   /**
    Calculate the site-lh differences  between an NNI neighbor and the ML tree
+   @param[out] site_lh_diff the non-zero differences, sorted by position
+   @param buffers scratch buffers (all but the LT2*, LT3* are used)
+   @return FALSE if the NNI neighbor could not be evaluated
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
   template <const cmaple::StateType num_states>
-  void calSiteLhDiff(std::vector<cmaple::RealNumType>& site_lh_diff,
-                     std::vector<cmaple::RealNumType>& site_lh_root_diff,
+  bool calSiteLhDiff(std::vector<SiteLhDiff>& site_lh_diff,
+                     ALRTSHBuffers& buffers,
                      const std::vector<cmaple::RealNumType>& site_lh_root,
                      PhyloNode& current_node,
                      PhyloNode& child_1,
@@ -1432,26 +1615,25 @@ class Tree {
                      const cmaple::Index parent_index);
 
   /**
-   Read the next character from the treefile
-   */
-  const char readNextChar(std::istream& in,
-                          cmaple::PositionType& in_line,
-                          cmaple::PositionType& in_column,
-                          const char& current_ch = 0) const;
-
-  /**
-   Read string from tree file to create new nodes
-   @throw std::logic\_error if any of the following situations occur.
-   - any taxa in the tree is not found in the  alignment
-   - unexpected values/behaviors found during the operations
-   */
-  cmaple::NumSeqsType parseFile(
-      std::istream& infile,
-      char& ch,
-      cmaple::RealNumType& branch_len,
+   Parse a tree in Newick format and create its nodes. The clades are read
+   iteratively (keeping the clades being read in an explicit stack), so that
+   deep trees do not overflow the call stack.
+   @param newick the tree (up to its ending ';')
+   @param in_line, in_column the current position in the tree (for error
+   messages)
+   @param map_seqname_index a mapping between sequence names and their index
+   in the alignment
+   @param missing_blengths set to TRUE if any branch has no length
+   @return the (vector) index of the top node
+   @throw const char* or std::string if the tree is in an incorrect format or
+   any taxa in the tree is not found in the alignment (see readTree())
+   */
+  cmaple::NumSeqsType parseNewick(
+      const std::string& newick,
       cmaple::PositionType& in_line,
       cmaple::PositionType& in_column,
-      const std::map<std::string, cmaple::NumSeqsType>& map_seqname_index,
+      const std::unordered_map<std::string, cmaple::NumSeqsType>&
+          map_seqname_index,
       bool& missing_blengths);
 
   /**
@@ -1518,13 +1700,15 @@ class Tree {
                                      const cmaple::Index parent_index);
 
   /**
-   Export Node in Newick format
-   @throw std::invalid\_argument if show\_branch\_supports = true but branch
+   Write the (sub)tree rooted at a node in Newick format (without the ending
+   ';'). The tree is traversed iteratively and written through a buffer.
+   @throw std::logic\_error if show\_branch\_supports = true but branch
    support values have yet been computed
    */
-  std::string exportNodeString(const bool binary,
-                               const cmaple::NumSeqsType node_vec_index,
-                               const bool show_branch_supports);
+  void exportNodeString(std::ostream& out_stream,
+                        const bool binary,
+                        const cmaple::NumSeqsType node_vec_index,
+                        const bool show_branch_supports);
 
   /**
    Read an input tree from a stream
@@ -1562,7 +1746,7 @@ class Tree {
   /**
    Initialize a mapping between sequence names and their index in the alignment
    */
-  std::map<std::string, NumSeqsType> initMapSeqNameIndex();
+  std::unordered_map<std::string, NumSeqsType> initMapSeqNameIndex();
 
   /**
    * Re-mark the sequences in the alignment, which already existed in the
@@ -1583,7 +1767,7 @@ class Tree {
    */
   NumSeqsType markAnExistingSeq(
       const std::string& seq_name,
-      const std::map<std::string, NumSeqsType>& map_name_index);
+      const std::unordered_map<std::string, NumSeqsType>& map_name_index);
 
   /**
    * Mark all sequences (in the alignment) as not yet added to the current tree
@@ -1599,9 +1783,11 @@ class Tree {
   void attachAlnModel(Alignment* aln, ModelBase* model);
 
   /**
-   Export tree std::string in Newick format
+   Write the tree in Newick format to a stream
    */
-  std::string exportNewick(const bool binary, const bool show_branch_supports);
+  void exportNewick(std::ostream& out_stream,
+                    const bool binary,
+                    const bool show_branch_supports);
 
   /**
    Increase the length of a 0-length branch (connecting this node to its parent)
@@ -1625,6 +1811,11 @@ class Tree {
   /**
    Seek a position for a sample placement starting at the start_node
 
+   @param defer_less_info_seqs TRUE to leave the tree untouched if the sample is
+   less informative than an existing leaf; selected_node_index is then set to
+   Index(<leaf>, UNDEFINED) so that the caller can add it later
+   @param visited_nodes if not null, the (vector indexes of the) nodes whose
+   likelihoods are read by the search are appended to it
    @throw std::logic\_error if unexpected values/behaviors found during the
    operations
    */
@@ -1637,7 +1828,10 @@ class Tree {
                            bool& is_mid_branch,
                            cmaple::RealNumType& best_up_lh_diff,
                            cmaple::RealNumType& best_down_lh_diff,
-                           cmaple::Index& best_child_index);
+                           cmaple::Index& best_child_index,
+                           const bool defer_less_info_seqs = false,
+                           std::vector<cmaple::NumSeqsType>* visited_nodes =
+                               nullptr);
 
   /**
    Seek a position for placing a subtree/sample starting at the start_node
@@ -1655,9 +1849,8 @@ class Tree {
       cmaple::Index& best_child_index,
       const bool short_range_search,
       const cmaple::Index child_node_index,
-      cmaple::RealNumType&
-          removed_blength);  //, bool search_subtree_placement = true,
-                             // SeqRegions* sample_regions = NULL);
+      cmaple::RealNumType& removed_blength,
+      std::vector<cmaple::NumSeqsType>* visited_nodes = nullptr);
 
   /**
    Place a new sample at a mid-branch point
@@ -1920,59 +2113,133 @@ RealNumType cmaple::Tree::improveEntireTree(bool short_range_search) {
   PositionType num_nodes = 0;
   PositionType count_node_1K = 0;
 
+  // Subtrees are processed window by window: SPR moves for all subtrees in a
+  // window are sought (in parallel) on the same tree, then applied one by one
+  // in traversal order. The subtrees of a window are disjoint: the children of
+  // a node added to a window are only traversed after the window. A subtree is
+  // searched again (on the updated tree) if an earlier move in its window
+  // updated any node its search has read, so the outcome does not depend on
+  // the number of threads.
+  const std::vector<Index>::size_type window_size =
+      static_cast<std::vector<Index>::size_type>(
+          params->spr_window > 1 ? params->spr_window : 1);
+  const bool record_footprint = window_size > 1;
+  const int num_threads = params->num_threads
+                              ? static_cast<int>(params->num_threads)
+                              : countPhysicalCPUCores();
+  std::vector<Index> window_nodes;
+  std::vector<Index> deferred_children;
+  std::vector<SubTreeSPR> window_sprs;
+  window_nodes.reserve(window_size);
+
   // traverse downward the tree
   while (!node_stack.empty()) {
-    // pick the top node from the stack
-    Index index = node_stack.top();
-    node_stack.pop();
-    PhyloNode& node = nodes[index.getVectorIndex()];
-    // MiniIndex mini_index = index.getMiniIndex();
-
-    // add all children of the current nodes to the stack for further traversing
-    // later
-    /*for (Index neighbor_index:node.getNeighborIndexes(mini_index))
-        node_stack.push(neighbor_index);*/
-    assert(index.getMiniIndex() == TOP);
-    if (node.isInternal()) {
-      node_stack.push(node.getNeighborIndex(RIGHT));
-      node_stack.push(node.getNeighborIndex(LEFT));
+    // collect the outdated nodes of the next window
+    window_nodes.clear();
+    deferred_children.clear();
+    while (!node_stack.empty() && window_nodes.size() < window_size) {
+      // pick the top node from the stack
+      Index index = node_stack.top();
+      node_stack.pop();
+      PhyloNode& node = nodes[index.getVectorIndex()];
+      assert(index.getMiniIndex() == TOP);
+
+      // only process outdated node to avoid traversing the same part of the
+      // tree multiple times
+      const bool in_window = node.isOutdated() && node.getSPRCount() <= 5;
+      if (in_window) {
+        node.setOutdated(false);
+        window_nodes.push_back(index);
+      }
+
+      // add all children of the current nodes to the stack for further
+      // traversing later (after the window if the current node is in it)
+      if (node.isInternal()) {
+        if (in_window) {
+          deferred_children.push_back(node.getNeighborIndex(LEFT));
+          deferred_children.push_back(node.getNeighborIndex(RIGHT));
+        } else {
+          node_stack.push(node.getNeighborIndex(RIGHT));
+          node_stack.push(node.getNeighborIndex(LEFT));
+        }
+      }
+    }
+    const std::vector<Index>::size_type num_window_nodes =
+        window_nodes.size();
+    window_sprs.resize(num_window_nodes);
+
+    // seek SPR moves for all subtrees in the window
+    std::exception_ptr seek_exception = nullptr;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads) \
+    if (num_window_nodes > 1)
+    for (PositionType j = 0; j < static_cast<PositionType>(num_window_nodes);
+         ++j) {
+      try {
+        const std::vector<Index>::size_type k =
+            static_cast<std::vector<Index>::size_type>(j);
+        seekSubTreeSPR<num_states>(
+            window_nodes[k], nodes[window_nodes[k].getVectorIndex()],
+            short_range_search, window_sprs[k], record_footprint);
+      } catch (...) {
+#pragma omp critical
+        if (!seek_exception) {
+          seek_exception = std::current_exception();
+        }
+      }
+    }
+    if (seek_exception) {
+      std::rethrow_exception(seek_exception);
     }
 
-    // only process outdated node to avoid traversing the same part of the tree
-    // multiple times
-    if (node.isOutdated() && node.getSPRCount() <= 5) {
-      node.setOutdated(false);
+    // apply the moves one by one
+    const NumSeqsType window_root_vector_index = root_vector_index;
+    track_touched_nodes = record_footprint;
+    touched_nodes.clear();
+    for (std::vector<Index>::size_type j = 0; j < num_window_nodes; ++j) {
+      const Index index = window_nodes[j];
+      PhyloNode& node = nodes[index.getVectorIndex()];
+      SubTreeSPR& spr = window_sprs[j];
+
+      // re-seek the move if the tree it was sought on has changed
+      if (j) {
+        bool outdated_spr = root_vector_index != window_root_vector_index;
+        for (const NumSeqsType vec_index : spr.footprint) {
+          if (outdated_spr) {
+            break;
+          }
+          outdated_spr = touched_nodes.count(vec_index);
+        }
+        if (outdated_spr) {
+          node.setOutdated(false);
+          seekSubTreeSPR<num_states>(index, node, short_range_search, spr);
+        }
+      }
 
-      // if checkEachSPR:
-      //   root=node
-      //  while root.up!=None:
-      //      root=root.up
-      //  #print("Pre-SPR tree: "+createBinaryNewick(root))
-      //  oldTreeLK=calculateTreeLikelihood(root,mutMatrix,checkCorrectness=True)
-      //  #print("Pre-SPR tree likelihood: "+str(oldTreeLK))
-      // reCalculateAllGenomeLists(root,mutMatrix, checkExistingAreCorrect=True)
+      // record the nodes that an SPR move re-connects (the others it updates
+      // are recorded by updatePartialLh())
+      if (track_touched_nodes && spr.found_better_placement) {
+        const Index parent_index = node.getNeighborIndex(TOP);
+        const NumSeqsType parent_vec_index = parent_index.getVectorIndex();
+        const PhyloNode& parent_node = nodes[parent_vec_index];
+        const NumSeqsType best_vec_index = spr.best_node_index.getVectorIndex();
+        touched_nodes.insert(index.getVectorIndex());
+        touched_nodes.insert(parent_vec_index);
+        touched_nodes.insert(
+            parent_node.getNeighborIndex(parent_index.getFlipMiniIndex())
+                .getVectorIndex());
+        if (parent_vec_index != root_vector_index) {
+          touched_nodes.insert(
+              parent_node.getNeighborIndex(TOP).getVectorIndex());
+        }
+        touched_nodes.insert(best_vec_index);
+        if (best_vec_index != root_vector_index) {
+          touched_nodes.insert(
+              nodes[best_vec_index].getNeighborIndex(TOP).getVectorIndex());
+        }
+      }
 
       // do SPR moves to improve the tree
-      RealNumType improvement =
-          improveSubTree<num_states>(index, node, short_range_search);
-
-      // if checkEachSPR:
-      //          #print(" apparent improvement "+str(improvement))
-      //        root=node
-      //       while root.up!=None:
-      //         root=root.up
-      //           #print("Post-SPR tree: "+createBinaryNewick(root))
-      //         newTreeLK=calculateTreeLikelihood(root,mutMatrix)
-      //       reCalculateAllGenomeLists(root,mutMatrix,
-      //       checkExistingAreCorrect=True)
-      //     #print("Post-SPR tree likelihood: "+str(newTreeLK))
-      //   if newTreeLK-oldTreeLK < improvement-1.0:
-      //              print("In startTopologyUpdates, LK score of improvement
-      //              "+str(newTreeLK)+" - "+str(oldTreeLK)+" =
-      //              "+str(newTreeLK-oldTreeLK)+" is less than //what is
-      //              supposd to be "+str(improvement))
-      //        exit()
-      //
+      RealNumType improvement = applySubTreeSPR<num_states>(index, node, spr);
 
       // update total_improvement
       total_improvement += improvement;
@@ -1990,6 +2257,13 @@ RealNumType cmaple::Tree::improveEntireTree(bool short_range_search) {
         count_node_1K = num_nodes;
       }
     }
+    track_touched_nodes = false;
+
+    // traverse the children of the nodes of the window, in traversal order
+    for (auto child = deferred_children.rbegin();
+         child != deferred_children.rend(); ++child) {
+      node_stack.push(*child);
+    }
   }
 
   return total_improvement;
@@ -2020,7 +2294,9 @@ void cmaple::Tree::seekSamplePlacement(
     bool& is_mid_branch,
     RealNumType& best_up_lh_diff,
     RealNumType& best_down_lh_diff,
-    Index& best_child_index) {
+    Index& best_child_index,
+    const bool defer_less_info_seqs,
+    std::vector<NumSeqsType>* visited_nodes) {
   assert(sample_regions && sample_regions->size() > 0);
   assert(seq_name_index >= 0);
   assert(aln);
@@ -2046,6 +2322,9 @@ void cmaple::Tree::seekSamplePlacement(
         current_extended_node.getIndex().getVectorIndex();
     PhyloNode& current_node = nodes[current_node_vec];
     const bool& is_internal = current_node.isInternal();
+    if (visited_nodes) {
+      visited_nodes->push_back(current_node_vec);
+    }
 
     // NHANLT: debug
     // if (current_node->next && ((current_node->next->neighbor &&
@@ -2062,8 +2341,12 @@ void cmaple::Tree::seekSamplePlacement(
     if ((!is_internal) &&
         (current_node.getPartialLh(TOP)->compareWithSample(
              *sample_regions, seq_length, aln) == 1)) {
-      current_node.addLessInfoSeqs(seq_name_index);
-      selected_node_index = Index();
+      if (defer_less_info_seqs) {
+        selected_node_index = Index(current_node_vec, UNDEFINED);
+      } else {
+        current_node.addLessInfoSeqs(seq_name_index);
+        selected_node_index = Index();
+      }
       return;
     }
 
@@ -2129,7 +2412,7 @@ void cmaple::Tree::seekSamplePlacement(
   if (!is_mid_branch) {
     finetuneSamplePlacementAtNode<num_states>(
         nodes[selected_node_index.getVectorIndex()], best_down_lh_diff,
-        best_child_index, sample_regions);
+        best_child_index, sample_regions, visited_nodes);
   }
 }
 
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "../alignment/alignment.h"
+#include "../utils/gzstream.h"
 using namespace cmaple;
 
 /*
@@ -43,6 +44,226 @@ TEST(Alignment, readSequences)
     EXPECT_THROW(aln.read(example_dir + "notfound"), std::ios_base::failure);
 }
 
+/*
+ Test that streaming a FASTA alignment gives the same reference and mutations
+ as reading the same sequences in PHYLIP format (including tied sites)
+ */
+TEST(Alignment, readFastaStreaming)
+{
+    const std::vector<std::string> names = {"S1", "S2", "S3", "S4"};
+    const std::vector<std::string> seqs = {"ACGTNAC-RT", "ACGAAGC-TT",
+                                           "TCTACGTAGT", "TGTTCGTACT"};
+    std::stringstream fasta, phylip;
+    phylip << names.size() << " " << seqs[0].length() << std::endl;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        // split the FASTA sequences across two lines
+        fasta << ">" << names[i] << std::endl << seqs[i].substr(0, 4)
+              << std::endl << seqs[i].substr(4) << std::endl;
+        phylip << names[i] << " " << seqs[i] << std::endl;
+    }
+    
+    Alignment aln_fasta, aln_phylip;
+    aln_fasta.read(fasta, "", cmaple::Alignment::IN_FASTA);
+    aln_phylip.read(phylip, "", cmaple::Alignment::IN_PHYLIP);
+    
+    EXPECT_EQ(aln_fasta.ref_seq, aln_phylip.ref_seq);
+    ASSERT_EQ(aln_fasta.data.size(), aln_phylip.data.size());
+    for (size_t i = 0; i < aln_fasta.data.size(); ++i)
+    {
+        EXPECT_EQ(aln_fasta.data[i].seq_name, aln_phylip.data[i].seq_name);
+        ASSERT_EQ(aln_fasta.data[i].size(), aln_phylip.data[i].size());
+        for (size_t j = 0; j < aln_fasta.data[i].size(); ++j)
+        {
+            EXPECT_EQ(aln_fasta.data[i][j].type, aln_phylip.data[i][j].type);
+            EXPECT_EQ(aln_fasta.data[i][j].position,
+                      aln_phylip.data[i][j].position);
+            EXPECT_EQ(aln_fasta.data[i][j].getLength(),
+                      aln_phylip.data[i][j].getLength());
+        }
+    }
+    
+    // sequences of different lengths
+    std::stringstream bad_fasta(">S1\nACGT\n>S2\nACG\n>S3\nACGT\n");
+    EXPECT_THROW(aln_fasta.read(bad_fasta, "", cmaple::Alignment::IN_FASTA),
+                 std::invalid_argument);
+}
+
+/*
+ Test sortSeqsByDistances(): sequences at the same distance keep their order
+ */
+TEST(Alignment, sortSeqsByDistances)
+{
+    std::stringstream maple(">REF\nACGTACGTAC\n"
+                            ">S1\nT\t1\n"
+                            ">S2\nT\t1\nG\t3\n"
+                            ">S3\nG\t2\n"
+                            ">S4\n"
+                            ">S5\nA\t2\n"
+                            ">S6\nN\t4\t2\n");
+    Alignment aln(maple);
+    
+    const std::vector<std::string> expected_names = {"S4", "S1", "S3", "S5", "S6", "S2"};
+    ASSERT_EQ(aln.data.size(), expected_names.size());
+    for (size_t i = 0; i < expected_names.size(); ++i)
+        EXPECT_EQ(aln.data[i].seq_name, expected_names[i]);
+}
+
+/*
+ Test findIdenticalSeqs()
+ */
+TEST(Alignment, findIdenticalSeqs)
+{
+    std::stringstream maple(">REF\nACGTACGTAC\n"
+                            ">S1\nT\t1\n"
+                            ">S2\nT\t1\nG\t3\n"
+                            ">S3\nT\t1\n"
+                            ">S4\nN\t4\t2\n"
+                            ">S5\nT\t1\nG\t3\n"
+                            ">S6\nN\t4\t3\n"
+                            ">S7\nN\t4\t2\n"
+                            ">S8\nT\t1\n");
+    Alignment aln(maple);
+    
+    // the sequences are sorted -> compare them by names
+    const std::vector<NumSeqsType> identical_seqs = aln.findIdenticalSeqs();
+    ASSERT_EQ(identical_seqs.size(), aln.data.size());
+    std::map<std::string, std::string> representatives;
+    for (size_t i = 0; i < aln.data.size(); ++i)
+    {
+        EXPECT_LE(identical_seqs[i], i);
+        representatives[aln.data[i].seq_name] =
+            aln.data[identical_seqs[i]].seq_name;
+    }
+    const std::map<std::string, std::string> expected_representatives = {
+        {"S1", "S1"}, {"S3", "S1"}, {"S8", "S1"}, {"S2", "S2"}, {"S5", "S2"},
+        {"S4", "S4"}, {"S7", "S4"}, {"S6", "S6"}};
+    EXPECT_EQ(representatives, expected_representatives);
+}
+
+/*
+ Test reading gzip-compressed alignments
+ */
+TEST(Alignment, readCompressed)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    // compress test_100.maple and input.fa
+    for (const std::string filename : {"test_100.maple", "input.fa"})
+    {
+        std::ifstream in(example_dir + filename);
+        ogzstream out((example_dir + filename + ".gz").c_str());
+        out << in.rdbuf();
+        out.close();
+    }
+    
+    for (const std::string filename : {"test_100.maple", "input.fa"})
+    {
+        Alignment aln(example_dir + filename);
+        Alignment aln_gz(example_dir + filename + ".gz");
+        
+        EXPECT_EQ(aln_gz.ref_seq, aln.ref_seq);
+        ASSERT_EQ(aln_gz.data.size(), aln.data.size());
+        for (size_t i = 0; i < aln.data.size(); ++i)
+        {
+            EXPECT_EQ(aln_gz.data[i].seq_name, aln.data[i].seq_name);
+            ASSERT_EQ(aln_gz.data[i].size(), aln.data[i].size());
+            for (size_t j = 0; j < aln.data[i].size(); ++j)
+            {
+                EXPECT_EQ(aln_gz.data[i][j].type, aln.data[i][j].type);
+                EXPECT_EQ(aln_gz.data[i][j].position, aln.data[i][j].position);
+            }
+        }
+        std::remove((example_dir + filename + ".gz").c_str());
+    }
+}
+
+/*
+ Test writing gzip-compressed alignments
+ */
+TEST(Alignment, writeCompressed)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    for (const Alignment::InputType format : {Alignment::IN_MAPLE, Alignment::IN_FASTA, Alignment::IN_PHYLIP, Alignment::IN_BINARY})
+    {
+        std::stringstream plain_stream;
+        aln.write(plain_stream, format);
+        
+        // the compressed file decompresses to the plain output
+        const std::string filename = example_dir + "test_100.out.gz";
+        aln.write(filename, format, true);
+        igzstream in(filename.c_str());
+        std::stringstream decompressed_stream;
+        decompressed_stream << in.rdbuf();
+        in.close();
+        EXPECT_EQ(decompressed_stream.str(), plain_stream.str());
+        
+        // and can be read back
+        Alignment aln_gz(filename);
+        EXPECT_EQ(aln_gz.data.size(), aln.data.size());
+        std::remove(filename.c_str());
+    }
+}
+
+/*
+ Test writing and reading the binary format
+ */
+TEST(Alignment, binaryFormat)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    std::stringstream binary_stream;
+    aln.write(binary_stream, cmaple::Alignment::IN_BINARY);
+    
+    // read it back (detecting the format)
+    Alignment aln_binary(binary_stream);
+    EXPECT_EQ(aln_binary.getSeqType(), aln.getSeqType());
+    EXPECT_EQ(aln_binary.ref_seq, aln.ref_seq);
+    ASSERT_EQ(aln_binary.data.size(), aln.data.size());
+    
+    // (sequences at the same distance to the reference may be reordered)
+    std::map<std::string, const Sequence*> sequences;
+    for (const Sequence& sequence : aln.data)
+        sequences[sequence.seq_name] = &sequence;
+    for (const Sequence& sequence : aln_binary.data)
+    {
+        ASSERT_TRUE(sequences.count(sequence.seq_name));
+        const Sequence& expected = *sequences[sequence.seq_name];
+        ASSERT_EQ(sequence.size(), expected.size());
+        for (size_t j = 0; j < sequence.size(); ++j)
+        {
+            EXPECT_EQ(sequence[j].type, expected[j].type);
+            EXPECT_EQ(sequence[j].position, expected[j].position);
+            EXPECT_EQ(sequence[j].getLength(), expected[j].getLength());
+        }
+    }
+    
+    // the binary format is much smaller than the MAPLE format
+    std::stringstream maple_stream;
+    aln.write(maple_stream, cmaple::Alignment::IN_MAPLE);
+    EXPECT_LT(binary_stream.str().size() * 2, maple_stream.str().size());
+    
+    // truncated or unsupported files
+    std::stringstream truncated_stream(binary_stream.str().substr(0, 100));
+    EXPECT_THROW(aln_binary.read(truncated_stream), std::invalid_argument);
+    std::string future_version = binary_stream.str();
+    future_version[8] = 2;
+    std::stringstream future_stream(future_version);
+    EXPECT_THROW(aln_binary.read(future_stream), std::invalid_argument);
+}
+
 /*
  Test readRefSeq(const std::string& ref_path)
  */
@@ -227,9 +448,9 @@ TEST(Alignment, readMapleFile)
     
     // test the output data
     EXPECT_EQ(aln.data.size(), 5000);
-    EXPECT_EQ(aln.data[454].seq_name, "3521");
+    EXPECT_EQ(aln.data[454].seq_name, "725");
     EXPECT_EQ(aln.data[1328].size(), 12);
-    EXPECT_EQ(aln.data[943][8].type, 3);
+    EXPECT_EQ(aln.data[943][8].type, 1);
     EXPECT_EQ(aln.data[953][9].getLength(), 1);
     EXPECT_EQ(aln.data[76][5].position, 23402);
     EXPECT_EQ(aln.data[1543].size(), 13);
@@ -247,6 +468,26 @@ TEST(Alignment, readMapleFile)
     EXPECT_EQ(aln.ref_seq[1593], 1);
     // ----- test on test_5K.maple, load ref_seq from test_100.maple -----
     
+    // ----- reading test_5K.maple from a stream gives the same sequences as
+    // reading it from the (memory-mapped) file
+    Alignment aln_stream;
+    std::ifstream maple_stream(example_dir + "test_5K.maple");
+    aln_stream.read(maple_stream);
+    EXPECT_EQ(aln_stream.ref_seq, aln.ref_seq);
+    ASSERT_EQ(aln_stream.data.size(), aln.data.size());
+    for (size_t i = 0; i < aln.data.size(); ++i)
+    {
+        EXPECT_EQ(aln_stream.data[i].seq_name, aln.data[i].seq_name);
+        ASSERT_EQ(aln_stream.data[i].size(), aln.data[i].size());
+        for (size_t j = 0; j < aln.data[i].size(); ++j)
+        {
+            EXPECT_EQ(aln_stream.data[i][j].type, aln.data[i][j].type);
+            EXPECT_EQ(aln_stream.data[i][j].position, aln.data[i][j].position);
+            EXPECT_EQ(aln_stream.data[i][j].getLength(),
+                      aln.data[i][j].getLength());
+        }
+    }
+    
     // ----- Test read() with an empty input
     EXPECT_THROW(aln.read(""), std::invalid_argument);
     
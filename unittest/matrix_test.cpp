@@ -33,3 +33,99 @@ TEST(Model, dotProduct)
   testDotProduct<float>();
   testDotProduct<double>();
 }
+
+/*
+ Test the kernels with likelihood vectors in single precision and matrices in
+ double precision
+ */
+TEST(Model, mixedPrecision)
+{
+  std::array<float, 20> lh;
+  std::iota(std::begin(lh), std::end(lh), 0.0f); // Fill with 0...19.
+  std::array<double, 20> mat;
+  std::iota(std::begin(mat), std::end(mat), 0.0); // Fill with 0...19.
+
+  // sums up in double precision
+  const cmaple::RealNumType dot = dotProduct<20>(&lh[0], &mat[0]);
+  EXPECT_EQ(dot, 2470);
+  EXPECT_EQ(dotProduct<20>(&mat[0], &lh[0]), dot);
+
+  // results are stored back in single precision
+  std::array<float, 4> set_vec;
+  setVecByProduct<4>(&set_vec[0], &lh[0], &mat[0]);
+  EXPECT_EQ(set_vec[3], 9.0f);
+  setVecWithState<4>(&set_vec[0], 1, &mat[0], 0.5);
+  EXPECT_EQ(set_vec[0], 0.0f);
+  EXPECT_EQ(set_vec[1], 1.5f);
+  EXPECT_EQ(set_vec[2], 1.0f);
+  EXPECT_EQ(resetLhVecExceptState<4>(&set_vec[0], 2, 0.25), 0.25);
+  EXPECT_EQ(set_vec[1], 0.0f);
+  EXPECT_EQ(set_vec[2], 0.25f);
+}
+
+/*
+ Test that single-precision likelihood vectors summing below the float
+ carry-over are reported as underflowed instead of being kept as denormals
+ */
+TEST(Model, floatUnderflow)
+{
+  const std::array<double, 4> mat{-0.5, 0.25, 0.125, 0.125};
+
+  // products around 1e-20 are kept in single precision
+  std::array<float, 4> lh{1e-20f, 1e-20f, 0.0f, 0.0f};
+  const cmaple::RealNumType sum = updateVecWithState<4>(&lh[0], 0, &mat[0], 0.5);
+  EXPECT_GT(sum, 0);
+  EXPECT_FLOAT_EQ(lh[0], 0.75e-20f);
+  EXPECT_FLOAT_EQ(lh[1], 0.125e-20f);
+
+  // products around 1e-40 would be denormal in single precision
+  lh = {1e-38f, 1e-38f, 0.0f, 0.0f};
+  EXPECT_EQ(updateVecWithState<4>(&lh[0], 0, &mat[0], 0.001), 0);
+  EXPECT_EQ(lh[0], 0.0f);
+  EXPECT_EQ(lh[1], 0.0f);
+
+  // double vectors keep the same products
+  std::array<double, 4> lh_d{1e-38, 1e-38, 0.0, 0.0};
+  EXPECT_GT(updateVecWithState<4>(&lh_d[0], 0, &mat[0], 0.001), 0);
+  EXPECT_GT(lh_d[1], 0.0);
+}
+
+/*
+ Test the runtime-dispatched matrix-vector kernels
+ */
+TEST(Model, matrixVectorProduct)
+{
+  std::array<double, 400> mat;
+  for (size_t i = 0; i < mat.size(); ++i)
+    mat[i] = static_cast<double>((i * 7) % 23) * 0.013 + static_cast<double>(i) * 1e-3;
+  std::array<double, 20> vec;
+  for (size_t i = 0; i < vec.size(); ++i)
+    vec[i] = static_cast<double>(i) * 0.05 + 0.01;
+
+  std::array<double, 20> expected;
+  for (cmaple::StateType i = 0; i < 20; ++i)
+    expected[i] = dotProduct<20>(&vec[0], &mat[i * 20]);
+
+  // all kernels give the same results (up to rounding), whatever the CPU
+  // supports (unsupported levels are not run)
+  const SIMDLevel max_level = detectSIMDLevel();
+  for (SIMDLevel level : {SIMDLevel::GENERIC, SIMDLevel::AVX2_FMA, SIMDLevel::AVX512})
+  {
+    if (level > max_level)
+      break;
+    std::array<double, 20> result;
+    getMatVec20Kernel(level)(&mat[0], &vec[0], &result[0]);
+    for (size_t i = 0; i < 20; ++i)
+      EXPECT_NEAR(result[i], expected[i], 1e-12 * expected[i]);
+  }
+
+  std::array<double, 20> result;
+  matrixVectorProduct<20>(&mat[0], &vec[0], &result[0]);
+  for (size_t i = 0; i < 20; ++i)
+    EXPECT_NEAR(result[i], expected[i], 1e-12 * expected[i]);
+
+  // the generic path for other sizes is exact
+  matrixVectorProduct<4>(&mat[0], &vec[0], &result[0]);
+  for (cmaple::StateType i = 0; i < 4; ++i)
+    EXPECT_EQ(result[i], dotProduct<4>(&vec[0], &mat[i * 4]));
+}
@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include "../model/model_aa.h"
 #include "../model/model_dna.h"
 
 using namespace cmaple;
@@ -29,4 +30,33 @@ TEST(Model, initMutationMat)
     EXPECT_EQ(model_JC.freq_j_transposed_ij[15], -0.25);
 }
 
+/*
+ Test initMutationMat() with the built-in protein models
+ */
+TEST(Model, initMutationMatAA)
+{
+    for (const auto& it : cmaple::ModelBase::aa_models_mapping)
+    {
+        ModelAA model(it.second);
+        
+        // the frequencies sum to 1 and the rows of the Q matrix to 0
+        RealNumType sum_freqs = 0;
+        for (StateType i = 0; i < 20; ++i)
+        {
+            sum_freqs += model.root_freqs[i];
+            RealNumType sum_rates = 0;
+            for (StateType j = 0; j < 20; ++j)
+                sum_rates += model.mutation_mat[i * 20 + j];
+            EXPECT_NEAR(sum_rates, 0, 1e-5) << it.first;
+        }
+        EXPECT_NEAR(sum_freqs, 1, 1e-7) << it.first;
+    }
+    
+    // the parameters of LG, as defined in model_aa.nexus
+    ModelAA model_LG(cmaple::ModelBase::LG);
+    EXPECT_EQ(model_LG.root_freqs[0], 0.07906592);
+    EXPECT_EQ(model_LG.root_freqs[19], 0.06914693);
+    EXPECT_EQ(model_LG.inverse_root_freqs[10], 1.0 / 0.0990809);
+}
+
 // NOT YET DONE
@@ -341,6 +341,17 @@ TEST(PhyloNode, TestExportString)
         "(sequence 1:0,sequence 3:0,sequence 6:0,sequence 8:0):0.5");
 }
 
+/*
+    Get a sequence of an alignment by its name
+ */
+static cmaple::Sequence& getSeq(cmaple::Alignment& aln, const std::string& name)
+{
+    for (cmaple::Sequence& sequence : aln.data)
+        if (sequence.seq_name == name)
+            return sequence;
+    throw std::invalid_argument("Sequence " + name + " not found");
+}
+
 /*
     Test computeTotalLhAtNode()
  */
@@ -356,11 +367,11 @@ TEST(PhyloNode, TestComputeTotalLhAtNode)
     Tree tree(&aln, &model);
     std::unique_ptr<Params> params = ParamsBuilder().build();
     
-    std::unique_ptr<SeqRegions> seqregions1 = aln.data[0]
+    std::unique_ptr<SeqRegions> seqregions1 = getSeq(aln, "431")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions2 = aln.data[10]
+    std::unique_ptr<SeqRegions> seqregions2 = getSeq(aln, "428")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions3 = aln.data[100]
+    std::unique_ptr<SeqRegions> seqregions3 = getSeq(aln, "412")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
     
     // test on a root
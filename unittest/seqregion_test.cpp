@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "../alignment/seqregion.h"
+#include <algorithm>
+#include <thread>
 
 using namespace cmaple;
 
@@ -331,3 +333,46 @@ TEST(SeqRegion, operators)
     (*seqregion11.likelihood)[1] += 2e-50;
     EXPECT_FALSE(seqregion1 == seqregion11);
 }
+
+/*
+ Test the recycling of likelihood arrays
+ */
+TEST(SeqRegion, likelihood_recycling)
+{
+    auto lh1 = cmaple::make_unique<SeqRegion::LHType>();
+    SeqRegion::LHType* const lh1_ptr = lh1.get();
+    lh1.reset();
+    
+    // a freed array is reused (and zero-initialized)
+    auto lh2 = cmaple::make_unique<SeqRegion::LHType>();
+    EXPECT_EQ(lh2.get(), lh1_ptr);
+    for (RealNumType lh : *lh2)
+        EXPECT_EQ(lh, 0);
+    
+    // cloning a region of type O copies its likelihood into a new array
+    (*lh2)[0] = 0.7;
+    SeqRegion seqregion1(TYPE_O, 100, -1, -1, std::move(lh2));
+    SeqRegion seqregion2 = SeqRegion::clone(seqregion1);
+    EXPECT_NE(seqregion2.likelihood.get(), seqregion1.likelihood.get());
+    EXPECT_EQ((*seqregion2.likelihood)[0], 0.7);
+    
+    // arrays freed by another thread (more than its free list keeps, so that
+    // batches go through the shared pool) can be reused by this thread
+    const size_t num_lhs = 1 << 13;
+    std::vector<SeqRegion::LHPtrType> lhs;
+    for (size_t i = 0; i < num_lhs; ++i)
+        lhs.push_back(cmaple::make_unique<SeqRegion::LHType>());
+    std::vector<SeqRegion::LHType*> freed_lhs;
+    for (const auto& lh : lhs)
+        freed_lhs.push_back(lh.get());
+    std::sort(freed_lhs.begin(), freed_lhs.end());
+    std::thread([&lhs]() { lhs.clear(); }).join();
+    size_t num_reused = 0;
+    for (size_t i = 0; i < num_lhs; ++i)
+    {
+        lhs.push_back(cmaple::make_unique<SeqRegion::LHType>());
+        if (std::binary_search(freed_lhs.begin(), freed_lhs.end(), lhs.back().get()))
+            ++num_reused;
+    }
+    EXPECT_GT(num_reused, 0);
+}
@@ -128,6 +128,19 @@ cmaple::Alignment loadAln5K()
     return Alignment(example_dir + "test_5K.maple");
 }
 
+/*
+    Get a sequence of an alignment by its name (the expected values of the
+    tests below were computed for these sequences, whatever their position
+    among the sequences at the same distance from the reference)
+ */
+static cmaple::Sequence& getSeq(cmaple::Alignment& aln, const std::string& name)
+{
+    for (cmaple::Sequence& sequence : aln.data)
+        if (sequence.seq_name == name)
+            return sequence;
+    throw std::invalid_argument("Sequence " + name + " not found");
+}
+
 /*
     Generate testing data (seqregions1, seqregions2)
  */
@@ -138,11 +151,11 @@ void genTestData1(std::unique_ptr<SeqRegions>& seqregions1, std::unique_ptr<SeqR
     std::unique_ptr<Params> params = ParamsBuilder().build();
     Tree tree(&aln, &model);
     
-    std::unique_ptr<SeqRegions> seqregions_1 = aln.data[0]
+    std::unique_ptr<SeqRegions> seqregions_1 = getSeq(aln, "431")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_2 = aln.data[10]
+    std::unique_ptr<SeqRegions> seqregions_2 = getSeq(aln, "428")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_3 = aln.data[100]
+    std::unique_ptr<SeqRegions> seqregions_3 = getSeq(aln, "412")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
     
     seqregions_1->mergeTwoLowers<4>(seqregions1, 1e-5, *seqregions_2, 123e-3,
@@ -287,9 +300,9 @@ TEST(SeqRegions, countSharedSegments)
 TEST(SeqRegions, compareWithSample)
 {
     Alignment aln = loadAln5K();
-    std::unique_ptr<SeqRegions> seqregions1 = aln.data[0]
+    std::unique_ptr<SeqRegions> seqregions1 = getSeq(aln, "431")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions2 = aln.data[10]
+    std::unique_ptr<SeqRegions> seqregions2 = getSeq(aln, "428")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
     std::vector<int> expected_results{1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
     std::vector<int> results(20);
@@ -322,11 +335,11 @@ TEST(SeqRegions, areDiffFrom)
     std::unique_ptr<SeqRegions> seqregions1 = nullptr;
     std::unique_ptr<SeqRegions> seqregions2 = nullptr;
     
-    std::unique_ptr<SeqRegions> seqregions_1 = aln.data[0]
+    std::unique_ptr<SeqRegions> seqregions_1 = getSeq(aln, "431")
         .getLowerLhVector(seq_length, aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_2 = aln.data[10]
+    std::unique_ptr<SeqRegions> seqregions_2 = getSeq(aln, "428")
         .getLowerLhVector(seq_length, aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_3 = aln.data[100]
+    std::unique_ptr<SeqRegions> seqregions_3 = getSeq(aln, "412")
         .getLowerLhVector(seq_length, aln.num_states, aln.getSeqType());
     
     seqregions_1->mergeTwoLowers<4>(seqregions1, 1e-5, *seqregions_2, 123e-3, tree.aln,
@@ -441,11 +454,11 @@ TEST(SeqRegions, computeAbsoluteLhAtRoot)
     // dummy variables
     const PositionType seq_length = aln.ref_seq.size();
     const StateType num_states = aln.num_states;
-    std::unique_ptr<SeqRegions> seqregions_1 = aln.data[0]
+    std::unique_ptr<SeqRegions> seqregions_1 = getSeq(aln, "431")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_2 = aln.data[10]
+    std::unique_ptr<SeqRegions> seqregions_2 = getSeq(aln, "428")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_3 = aln.data[100]
+    std::unique_ptr<SeqRegions> seqregions_3 = getSeq(aln, "412")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
     
     seqregions_1->mergeTwoLowers<4>(seqregions1, 1e-5, *seqregions_2, 123e-3, \
@@ -491,11 +504,11 @@ TEST(SeqRegions, computeTotalLhAtRoot)
     // Generate complex seqregions
     const PositionType seq_length = aln.ref_seq.size();
     const StateType num_states = aln.num_states;
-    std::unique_ptr<SeqRegions> seqregions_1 = aln.data[20]
+    std::unique_ptr<SeqRegions> seqregions_1 = getSeq(aln, "25")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_2 = aln.data[200]
+    std::unique_ptr<SeqRegions> seqregions_2 = getSeq(aln, "642")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
-    std::unique_ptr<SeqRegions> seqregions_3 = aln.data[2000]
+    std::unique_ptr<SeqRegions> seqregions_3 = getSeq(aln, "1056")
         .getLowerLhVector(aln.ref_seq.size(), aln.num_states, aln.getSeqType());
     
     seqregions_1->mergeTwoLowers<4>(seqregions1, 1073e-6, *seqregions_2, 13e-8,
@@ -2604,12 +2617,18 @@ void genTestData(std::unique_ptr<SeqRegions>& seqregions1,
     const StateType num_states = tree.aln->num_states;
     
     // pick a few sequences
+    const std::string names_1[] = {"432", "433", "427", "429", "430",
+        "423", "418", "438", "424", "428"};
+    const std::string names_2[] = {"428", "25", "3533", "7", "15",
+        "27", "390", "4789", "843", "412"};
+    const std::string names_3[] = {"412", "642", "4766", "687", "906",
+        "894", "694", "752", "2539", "2972"};
     std::unique_ptr<SeqRegions> seqregions_1 =
-    tree.aln->data[test_case].getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
+    getSeq(*tree.aln, names_1[test_case - 1]).getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
     std::unique_ptr<SeqRegions> seqregions_2 =
-    tree.aln->data[test_case * 10].getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
+    getSeq(*tree.aln, names_2[test_case - 1]).getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
     std::unique_ptr<SeqRegions> seqregions_3 =
-    tree.aln->data[test_case * 100].getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
+    getSeq(*tree.aln, names_3[test_case - 1]).getLowerLhVector(seq_length, num_states, tree.aln->getSeqType());
     
     // compute the output regions
     seqregions_1->mergeTwoLowers<4>(seqregions1, 1e-5,
@@ -5319,3 +5338,58 @@ TEST(SeqRegions, mergeTwoLowers)
     EXPECT_EQ(merged_regions_ptr->size(), 11);
     // ----- Test 10 -----*/
 }
+
+/*
+ Test CumulativeBase
+ */
+TEST(SeqRegions, cumulativeBase)
+{
+    CumulativeBase cumulative_base;
+    EXPECT_TRUE(cumulative_base.empty());
+    
+    const std::vector<StateType> ref_seq{0, 2, 2, 3, 1, 0, 2};
+    cumulative_base.compute(ref_seq, 4);
+    EXPECT_FALSE(cumulative_base.empty());
+    for (StateType state = 0; state < 4; ++state)
+        EXPECT_EQ(cumulative_base.count(0, state), 0);
+    EXPECT_EQ(cumulative_base.count(1, 0), 1);
+    EXPECT_EQ(cumulative_base.count(3, 2), 2);
+    EXPECT_EQ(cumulative_base.count(3, 3), 0);
+    
+    const PositionType* const counts = cumulative_base.getCounts(7);
+    EXPECT_EQ(counts[0], 2);
+    EXPECT_EQ(counts[1], 1);
+    EXPECT_EQ(counts[2], 3);
+    EXPECT_EQ(counts[3], 1);
+}
+
+/*
+ Test the release of the likelihood arrays of destroyed regions
+ */
+TEST(SeqRegions, likelihoodRelease)
+{
+    std::vector<SeqRegion::LHType*> freed_lhs;
+    {
+        SeqRegions seqregions;
+        seqregions.emplace_back(TYPE_R, 99);
+        for (PositionType pos = 100; pos < 110; ++pos)
+        {
+            seqregions.emplace_back(TYPE_O, pos, 0, -1,
+                                    SeqRegion::LHType{0.1, 0.3, 0.2, 0.4});
+            freed_lhs.push_back(seqregions.back().likelihood.get());
+        }
+        seqregions.emplace_back(TYPE_N, 3000);
+    }
+    std::sort(freed_lhs.begin(), freed_lhs.end());
+    
+    // the arrays of all O regions are reused by the next allocations
+    std::vector<SeqRegion::LHPtrType> lhs;
+    std::vector<SeqRegion::LHType*> reused_lhs;
+    for (size_t i = 0; i < freed_lhs.size(); ++i)
+    {
+        lhs.push_back(cmaple::make_unique<SeqRegion::LHType>());
+        reused_lhs.push_back(lhs.back().get());
+    }
+    std::sort(reused_lhs.begin(), reused_lhs.end());
+    EXPECT_EQ(reused_lhs, freed_lhs);
+}
@@ -65,7 +65,7 @@ TEST(Sequence, operators)
     EXPECT_EQ(sequence2.seq_name, "sequence name 1");
     EXPECT_EQ(sequence2.size(), 6);
     EXPECT_EQ(sequence2[0].type, 1);
-    EXPECT_EQ(sequence2[2].position, 3036);
+    EXPECT_EQ(sequence2[2].position, 11189);
     EXPECT_EQ(sequence2[4].getLength(), 1);
     
     Sequence sequence3 = std::move(sequence2);
@@ -74,7 +74,7 @@ TEST(Sequence, operators)
     EXPECT_EQ(sequence3.seq_name, "sequence name 1");
     EXPECT_EQ(sequence3.size(), 6);
     EXPECT_EQ(sequence3[0].type, 1);
-    EXPECT_EQ(sequence3[2].position, 3036);
+    EXPECT_EQ(sequence3[2].position, 11189);
     EXPECT_EQ(sequence3[4].getLength(), 1);
 }
 
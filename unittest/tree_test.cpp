@@ -0,0 +1,357 @@
+#include "gtest/gtest.h"
+#include "../tree/tree.h"
+#include <algorithm>
+using namespace cmaple;
+
+namespace {
+/*
+ Get the (sorted) names of the leaves of a tree in Newick format
+ */
+std::vector<std::string> getLeafNames(const std::string& newick)
+{
+    std::vector<std::string> names;
+    for (std::string::size_type pos = 0; pos < newick.length(); ++pos)
+    {
+        // a leaf name follows an opening parenthesis or a comma
+        if (newick[pos] != '(' && newick[pos] != ',')
+            continue;
+        const std::string::size_type end = newick.find_first_of(":,()", pos + 1);
+        if (end != pos + 1 && newick[pos + 1] != '(')
+            names.push_back(newick.substr(pos + 1, end - pos - 1));
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+/*
+ Place all samples of an alignment with a window of speculative placements
+ */
+std::string doPlacementWindow(Alignment& aln, const int window,
+                              const int num_threads)
+{
+    std::unique_ptr<Params> params = ParamsBuilder().build();
+    params->placement_window = window;
+    params->num_threads = num_threads;
+    // each tree has its own model since the pseudo counts of the model are
+    // updated during the placement
+    Model model(ModelBase::GTR);
+    Tree tree(&aln, &model, "", false, std::move(params));
+    tree.doPlacement();
+    EXPECT_TRUE(std::isfinite(tree.computeLh()));
+    return tree.exportNewick(Tree::MUL_TREE, false);
+}
+}
+
+/*
+ Test doPlacement() with a window of speculative placements
+ */
+TEST(Tree, doPlacementWindow)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    
+    // sequential placement
+    const std::string newick1 = doPlacementWindow(aln, 1, 1);
+    
+    // all samples must be placed
+    std::vector<std::string> seq_names;
+    for (const Sequence& sequence : aln.data)
+        seq_names.push_back(sequence.seq_name);
+    std::sort(seq_names.begin(), seq_names.end());
+    EXPECT_EQ(getLeafNames(newick1), seq_names);
+    
+    // a placement is searched again if an earlier commit of its window
+    // updated any node read by its search, so windows of 8 samples give the
+    // sequential tree, regardless of the number of threads
+    EXPECT_EQ(doPlacementWindow(aln, 8, 1), newick1);
+    EXPECT_EQ(doPlacementWindow(aln, 8, 4), newick1);
+}
+
+/*
+ Test doPlacement() with the placement index
+ */
+TEST(Tree, doPlacementIndex)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    // the index is only built once the tree has enough nodes
+    Alignment aln(example_dir + "test_5K.maple");
+    
+    // placement searched from the root
+    Model model1(ModelBase::GTR);
+    Tree tree1(&aln, &model1);
+    tree1.doPlacement();
+    const RealNumType lh1 = tree1.computeLh();
+    EXPECT_TRUE(std::isfinite(lh1));
+    
+    // placement searched from the clades proposed by the index
+    std::unique_ptr<Params> params = ParamsBuilder().build();
+    params->placement_index = true;
+    Model model2(ModelBase::GTR);
+    Tree tree2(&aln, &model2, "", false, std::move(params));
+    tree2.doPlacement();
+    const RealNumType lh2 = tree2.computeLh();
+    EXPECT_TRUE(std::isfinite(lh2));
+    EXPECT_NEAR(lh1, lh2, fabs(lh1) * 0.01);
+    
+    // all samples must be placed
+    std::vector<std::string> seq_names;
+    for (const Sequence& sequence : aln.data)
+        seq_names.push_back(sequence.seq_name);
+    std::sort(seq_names.begin(), seq_names.end());
+    EXPECT_EQ(getLeafNames(tree2.exportNewick(Tree::MUL_TREE, false)),
+              seq_names);
+}
+
+namespace {
+/*
+ Infer a tree with a window of concurrent SPR searches
+ */
+std::unique_ptr<Tree> inferWithSPRWindow(Alignment& aln, Model& model,
+                                         const int window,
+                                         const int num_threads)
+{
+    std::unique_ptr<Params> params = ParamsBuilder().build();
+    params->spr_window = window;
+    params->num_threads = num_threads;
+    std::unique_ptr<Tree> tree = std::make_unique<Tree>(&aln, &model, "",
+                                                        false, std::move(params));
+    tree->infer();
+    return tree;
+}
+}
+
+/*
+ Test infer() with a window of concurrent SPR searches
+ */
+TEST(Tree, inferSPRWindow)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    
+    // sequential tree search
+    Model model1(ModelBase::GTR);
+    const RealNumType lh1 = inferWithSPRWindow(aln, model1, 1, 1)->computeLh();
+    
+    // SPR moves searched in windows of 16 disjoint subtrees: the moves are
+    // applied in another order, which barely changes the final tree
+    Model model2(ModelBase::GTR);
+    std::unique_ptr<Tree> tree2 = inferWithSPRWindow(aln, model2, 16, 1);
+    const RealNumType lh2 = tree2->computeLh();
+    EXPECT_TRUE(std::isfinite(lh2));
+    EXPECT_NEAR(lh1, lh2, fabs(lh1) * 1e-6);
+    
+    // the result does not depend on the number of threads
+    Model model3(ModelBase::GTR);
+    EXPECT_EQ(inferWithSPRWindow(aln, model3, 16, 4)
+                  ->exportNewick(Tree::BIN_TREE, false),
+              tree2->exportNewick(Tree::BIN_TREE, false));
+}
+
+/*
+ Test computeBranchSupport() with branches distributed among threads
+ */
+TEST(Tree, computeBranchSupport)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    
+    Model model1(ModelBase::GTR);
+    Tree tree1(&aln, &model1, "", false,
+               ParamsBuilder().withRandomSeed(1).build());
+    tree1.infer();
+    tree1.computeBranchSupport(1, 100, 0.1, false);
+    const std::string newick1 = tree1.exportNewick(Tree::BIN_TREE, true);
+    
+    // supports are non-negative
+    EXPECT_EQ(newick1.find(")-"), std::string::npos);
+    
+    // the supports only depend on the random seed, not on the number of
+    // threads among which the branches are distributed (all the cores, as
+    // computeBranchSupport() doesn't accept more threads than cores)
+    if (countPhysicalCPUCores() < 2)
+        GTEST_SKIP() << "Only one CPU core to distribute the branches among";
+    Model model2(ModelBase::GTR);
+    Tree tree2(&aln, &model2, "", false,
+               ParamsBuilder().withRandomSeed(1).build());
+    tree2.infer();
+    tree2.computeBranchSupport(countPhysicalCPUCores(), 100, 0.1, false);
+    EXPECT_EQ(tree2.exportNewick(Tree::BIN_TREE, true), newick1);
+}
+
+/*
+ Test load() with deep, multifurcating and commented trees
+ */
+TEST(Tree, loadNewick)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    Model model(ModelBase::GTR);
+    
+    // a caterpillar tree (as deep as possible), with comments and line breaks
+    std::string caterpillar = aln.data[0].seq_name + ":0.001";
+    for (std::vector<Sequence>::size_type i = 1; i < aln.data.size(); ++i)
+        caterpillar = "(" + caterpillar + ",[comment; with a semi-colon]\n"
+            + aln.data[i].seq_name + ":0.002):0.001";
+    std::istringstream caterpillar_stream(caterpillar + ";");
+    Tree tree1(&aln, &model, caterpillar_stream, true);
+    const std::string newick1 = tree1.exportNewick(Tree::MUL_TREE, false);
+    for (const Sequence& sequence : aln.data)
+        EXPECT_NE(newick1.find(sequence.seq_name + ":"), std::string::npos);
+    
+    // a multifurcating tree without branch lengths -> bifurcating
+    std::string star = "(";
+    for (std::vector<Sequence>::size_type i = 0; i < 10; ++i)
+        star += (i ? "," : "") + aln.data[i].seq_name;
+    std::istringstream star_stream(star + ");");
+    Tree tree2(&aln, &model, star_stream);
+    const std::string newick2 = tree2.exportNewick(Tree::BIN_TREE, false);
+    EXPECT_EQ(std::count(newick2.begin(), newick2.end(), '('), 9);
+    for (std::vector<Sequence>::size_type i = 0; i < 10; ++i)
+        EXPECT_NE(newick2.find(aln.data[i].seq_name + ":"), std::string::npos);
+    
+    // incorrect trees
+    std::istringstream no_semicolon(star + ")");
+    EXPECT_THROW(Tree(&aln, &model, no_semicolon), std::invalid_argument);
+    std::istringstream no_bracket(star + ";");
+    EXPECT_THROW(Tree(&aln, &model, no_bracket), std::invalid_argument);
+    std::istringstream unknown_leaf("(" + aln.data[0].seq_name + ",unknown);");
+    EXPECT_THROW(Tree(&aln, &model, unknown_leaf), std::invalid_argument);
+}
+
+/*
+ Test exportNewick() to a stream
+ */
+TEST(Tree, exportNewickStream)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    Model model(ModelBase::GTR);
+    Tree tree(&aln, &model);
+    tree.doPlacement();
+    
+    for (const Tree::TreeType tree_type : {Tree::BIN_TREE, Tree::MUL_TREE})
+    {
+        std::ostringstream out_stream;
+        tree.exportNewick(out_stream, tree_type, false);
+        const std::string newick = tree.exportNewick(tree_type, false);
+        EXPECT_EQ(out_stream.str(), newick);
+        EXPECT_EQ(newick.back(), ';');
+        for (const Sequence& sequence : aln.data)
+            EXPECT_NE(newick.find(sequence.seq_name + ":"), std::string::npos);
+    }
+    
+    std::ostringstream out_stream;
+    EXPECT_THROW(tree.exportNewick(out_stream, Tree::UNKNOWN_TREE),
+                 std::invalid_argument);
+}
+
+/*
+ Test saveCheckpoint() and loadCheckpoint()
+ */
+TEST(Tree, checkpoint)
+{
+    // detect the path to the example directory
+    std::string example_dir = "../../example/";
+    if (!fileExists(example_dir + "example.maple"))
+        example_dir = "../example/";
+    
+    Alignment aln(example_dir + "test_100.maple");
+    const std::string checkpoint_file = "tree_test.ckp";
+    
+    // save a checkpoint after the placement
+    Model model1(ModelBase::GTR);
+    Tree tree1(&aln, &model1);
+    tree1.doPlacement();
+    tree1.saveCheckpoint(checkpoint_file);
+    
+    // restore it into a new tree -> same tree, likelihood and model
+    Model model2(ModelBase::GTR);
+    Tree tree2(&aln, &model2);
+    tree2.loadCheckpoint(checkpoint_file);
+    EXPECT_EQ(tree2.exportNewick(Tree::BIN_TREE, false),
+              tree1.exportNewick(Tree::BIN_TREE, false));
+    EXPECT_EQ(tree2.computeLh(), tree1.computeLh());
+    EXPECT_EQ(model2.getParams().mut_rates, model1.getParams().mut_rates);
+    
+    // both trees continue the same way
+    tree1.applySPR(Tree::NORMAL_TREE_SEARCH, false);
+    tree2.applySPR(Tree::NORMAL_TREE_SEARCH, false);
+    EXPECT_EQ(tree2.exportNewick(Tree::BIN_TREE, false),
+              tree1.exportNewick(Tree::BIN_TREE, false));
+    
+    // a truncated checkpoint
+    std::string content;
+    {
+        std::ifstream in(checkpoint_file, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(checkpoint_file, std::ios::binary | std::ios::trunc);
+        out.write(content.data(),
+                  static_cast<std::streamsize>(content.size() / 2));
+    }
+    Model model3(ModelBase::GTR);
+    Tree tree3(&aln, &model3);
+    EXPECT_THROW(tree3.loadCheckpoint(checkpoint_file), std::logic_error);
+    
+    // a checkpoint of another alignment
+    Alignment aln2(example_dir + "test_5K.maple");
+    Model model4(ModelBase::GTR);
+    Tree tree4(&aln2, &model4);
+    {
+        std::ofstream out(checkpoint_file, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    EXPECT_THROW(tree4.loadCheckpoint(checkpoint_file), std::invalid_argument);
+    
+    // a checkpoint of an alignment with the same sequence names but another
+    // mutation
+    std::string aln_content;
+    {
+        std::ifstream in(example_dir + "test_100.maple");
+        aln_content.assign(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+    }
+    const std::string mutation = "\nt\t16\n";
+    const std::string::size_type mutation_pos = aln_content.find(mutation);
+    ASSERT_NE(mutation_pos, std::string::npos);
+    aln_content.replace(mutation_pos, mutation.size(), "\nt\t17\n");
+    const std::string aln_file = "tree_test.maple";
+    {
+        std::ofstream out(aln_file);
+        out << aln_content;
+    }
+    Alignment aln3(aln_file);
+    std::remove(aln_file.c_str());
+    Model model5(ModelBase::GTR);
+    Tree tree5(&aln3, &model5);
+    EXPECT_THROW(tree5.loadCheckpoint(checkpoint_file), std::invalid_argument);
+    
+    std::remove(checkpoint_file.c_str());
+    EXPECT_THROW(tree4.loadCheckpoint(checkpoint_file), std::invalid_argument);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace cmaple {
+/**
+ Append an integer of num_bytes bytes (little-endian)
+ */
+inline void putFixed(std::string& out, uint64_t value, const int num_bytes) {
+  for (int i = 0; i < num_bytes; ++i, value >>= 8) {
+    out.push_back(static_cast<char>(value & 0xFF));
+  }
+}
+
+/**
+ Append a floating-point number (its IEEE 754 bits, little-endian)
+ */
+template <typename RealType>
+inline void putReal(std::string& out, const RealType value) {
+  static_assert(sizeof(RealType) == 4 || sizeof(RealType) == 8,
+                "Only float and double are supported");
+  using BitsType =
+      std::conditional_t<sizeof(RealType) == 4, uint32_t, uint64_t>;
+  BitsType bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putFixed(out, bits, sizeof(bits));
+}
+
+/**
+ Append an integer as a varint (7 bits per byte, least significant first)
+ */
+inline void putVarint(std::string& out, uint64_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/**
+ Append a signed integer as a zigzag varint
+ */
+inline void putZigzag(std::string& out, const int64_t value) {
+  putVarint(out, (static_cast<uint64_t>(value) << 1) ^
+                     static_cast<uint64_t>(value >> 63));
+}
+
+/**
+ Read the values written by putFixed(), putReal(), putVarint() and
+ putZigzag() from a buffer, checking that they are within the buffer
+ */
+class BinaryReader {
+ public:
+  /**
+   @param[in] begin, end The buffer
+   @param[in] name Name of the content in the error messages
+   */
+  BinaryReader(const char* const begin,
+               const char* const end,
+               const char* const name = "binary alignment")
+      : current_(begin), end_(end), name_(name) {}
+
+  uint64_t getFixed(const int num_bytes) {
+    const unsigned char* const bytes =
+        reinterpret_cast<const unsigned char*>(getBytes(
+            static_cast<size_t>(num_bytes)));
+    uint64_t value = 0;
+    for (int i = num_bytes - 1; i >= 0; --i) {
+      value = (value << 8) | bytes[i];
+    }
+    return value;
+  }
+
+  template <typename RealType>
+  RealType getReal() {
+    using BitsType =
+        std::conditional_t<sizeof(RealType) == 4, uint32_t, uint64_t>;
+    const BitsType bits = static_cast<BitsType>(getFixed(sizeof(BitsType)));
+    RealType value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  uint64_t getVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      const unsigned char byte =
+          static_cast<unsigned char>(*getBytes(1));
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw std::logic_error("Corrupted " + std::string(name_) +
+                           " (invalid varint)!");
+  }
+
+  int64_t getZigzag() {
+    const uint64_t value = getVarint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  const char* getBytes(const size_t num_bytes) {
+    if (static_cast<size_t>(end_ - current_) < num_bytes) {
+      throw std::logic_error("Corrupted " + std::string(name_) +
+                             " (truncated)!");
+    }
+    const char* const bytes = current_;
+    current_ += num_bytes;
+    return bytes;
+  }
+
+ private:
+  const char* current_;
+  const char* const end_;
+  const char* const name_;
+};
+}  // namespace cmaple
@@ -0,0 +1,194 @@
+#include "inputstream.h"
+
+#include <stdexcept>
+
+namespace {
+enum class Compression { NONE, GZIP, ZSTD };
+
+/**
+ Detect the compression of a file from its magic bytes
+ */
+Compression detectCompression(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  unsigned char magic[4] = {0, 0, 0, 0};
+  in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+  const std::streamsize num_read = in.gcount();
+  if (num_read >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::GZIP;
+  }
+  if (num_read >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+      magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::ZSTD;
+  }
+  return Compression::NONE;
+}
+}  // namespace
+
+cmaple::GzipReaderBuf::GzipReaderBuf(const std::string& filename)
+    : filename_(filename), file_(gzopen(filename.c_str(), "rb")) {
+  if (!file_) {
+    throw std::ios_base::failure("Cannot open file " + filename);
+  }
+  gzbuffer(file_, static_cast<unsigned>(BLOCK_SIZE));
+  start();
+}
+
+cmaple::GzipReaderBuf::~GzipReaderBuf() {
+  stop();
+  gzclose(file_);
+}
+
+void cmaple::GzipReaderBuf::start() {
+  finished_ = false;
+  stopping_ = false;
+  corrupted_ = false;
+  consumed_ = 0;
+  current_.clear();
+  setg(nullptr, nullptr, nullptr);
+  thread_ = std::thread(&GzipReaderBuf::decompress, this);
+}
+
+void cmaple::GzipReaderBuf::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  blocks_.clear();
+}
+
+void cmaple::GzipReaderBuf::decompress() {
+  for (;;) {
+    std::vector<char> block(BLOCK_SIZE);
+    const int num_read =
+        gzread(file_, block.data(), static_cast<unsigned>(BLOCK_SIZE));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (num_read <= 0) {
+      // (a truncated file only reports a Z_BUF_ERROR at its end)
+      int error = Z_OK;
+      gzerror(file_, &error);
+      corrupted_ = num_read < 0 || error != Z_OK;
+      finished_ = true;
+      cond_.notify_all();
+      return;
+    }
+    block.resize(static_cast<size_t>(num_read));
+
+    // wait until the reader has room for the block
+    cond_.wait(lock,
+               [this] { return stopping_ || blocks_.size() < MAX_BLOCKS; });
+    if (stopping_) {
+      return;
+    }
+    blocks_.push_back(std::move(block));
+    cond_.notify_all();
+  }
+}
+
+auto cmaple::GzipReaderBuf::underflow() -> int_type {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return finished_ || !blocks_.empty(); });
+  if (blocks_.empty()) {
+    if (corrupted_) {
+      throw std::ios_base::failure("Failed to decompress " + filename_);
+    }
+    return traits_type::eof();
+  }
+
+  consumed_ += static_cast<std::streamoff>(current_.size());
+  current_ = std::move(blocks_.front());
+  blocks_.pop_front();
+  cond_.notify_all();
+
+  setg(current_.data(), current_.data(), current_.data() + current_.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+auto cmaple::GzipReaderBuf::seekoff(const off_type off,
+                                    const std::ios_base::seekdir dir,
+                                    const std::ios_base::openmode which)
+    -> pos_type {
+  if (!(which & std::ios_base::in)) {
+    return pos_type(off_type(-1));
+  }
+  if (dir == std::ios_base::cur && off == 0) {
+    return pos_type(consumed_ + (gptr() - eback()));
+  }
+  if (dir == std::ios_base::beg) {
+    return seekpos(pos_type(off), which);
+  }
+  return pos_type(off_type(-1));
+}
+
+auto cmaple::GzipReaderBuf::seekpos(const pos_type pos,
+                                    const std::ios_base::openmode which)
+    -> pos_type {
+  // only rewinding is supported
+  if (!(which & std::ios_base::in) || pos != pos_type(0)) {
+    return pos_type(off_type(-1));
+  }
+
+  stop();
+  if (gzrewind(file_) != 0) {
+    // the decompression thread is gone: let the next read fail instead of
+    // waiting for blocks that never come
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    corrupted_ = true;
+    current_.clear();
+    setg(nullptr, nullptr, nullptr);
+    return pos_type(off_type(-1));
+  }
+  start();
+  return pos;
+}
+
+cmaple::InputFileStream::InputFileStream() : std::istream(&file_buf_) {}
+
+cmaple::InputFileStream::~InputFileStream() = default;
+
+void cmaple::InputFileStream::open(const std::string& filename) {
+  close();
+
+  bool opened = false;
+  switch (detectCompression(filename)) {
+    case Compression::ZSTD:
+      throw std::invalid_argument(
+          "Zstandard-compressed files are not supported (" + filename +
+          "). Please decompress it or compress it by gzip instead!");
+    case Compression::GZIP:
+      try {
+        gz_buf_ = std::make_unique<GzipReaderBuf>(filename);
+        rdbuf(gz_buf_.get());
+        opened = true;
+      } catch (std::ios_base::failure&) {
+        gz_buf_.reset();
+      }
+      break;
+    case Compression::NONE:
+    default:
+      opened = file_buf_.open(filename, std::ios::in) != nullptr;
+      break;
+  }
+
+  if (!opened) {
+    setstate(std::ios::failbit);
+  }
+}
+
+void cmaple::InputFileStream::close() {
+  // (a closed filebuf only returns EOF)
+  rdbuf(&file_buf_);
+  gz_buf_.reset();
+  if (file_buf_.is_open()) {
+    file_buf_.close();
+  }
+}
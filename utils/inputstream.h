@@ -0,0 +1,136 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cmaple {
+/** A stream buffer that decompresses a gzip file on a background thread. The
+ *  decompressed blocks are passed to the reader through a bounded queue, so
+ *  that decompression overlaps with parsing.
+ *  Only seeking back to the beginning (which restarts the decompression) and
+ *  querying the current position are supported.
+ */
+class GzipReaderBuf : public std::streambuf {
+ public:
+  /**
+   *  Constructor
+   *  @param[in] filename Name of a gzip file
+   *  @throw std::ios\_base::failure if the file cannot be opened
+   */
+  explicit GzipReaderBuf(const std::string& filename);
+
+  /**
+   *  Destructor
+   */
+  ~GzipReaderBuf() override;
+
+  GzipReaderBuf(const GzipReaderBuf&) = delete;
+  GzipReaderBuf& operator=(const GzipReaderBuf&) = delete;
+
+ protected:
+  /**
+   Get the next decompressed block (waiting for it if needed)
+   @throw std::ios\_base::failure if the file is corrupted
+   */
+  int_type underflow() override;
+
+  pos_type seekoff(off_type off,
+                   std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+ private:
+  /**
+   Size of the decompressed blocks
+   */
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+  /**
+   Maximum number of decompressed blocks waiting to be read
+   */
+  static constexpr size_t MAX_BLOCKS = 4;
+
+  const std::string filename_;
+  gzFile file_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::vector<char>> blocks_;
+  bool finished_ = false;
+  bool stopping_ = false;
+  bool corrupted_ = false;
+
+  /**
+   The block being read
+   */
+  std::vector<char> current_;
+
+  /**
+   Number of decompressed bytes before the block being read
+   */
+  std::streamoff consumed_ = 0;
+
+  /**
+   Start decompressing the file from its beginning
+   */
+  void start();
+
+  /**
+   Stop the decompression thread and drop the pending blocks
+   */
+  void stop();
+
+  /**
+   Body of the decompression thread
+   */
+  void decompress();
+};
+
+/** An input file stream that transparently decompresses gzip files (detected
+ *  from their magic bytes); other files are read as with std::ifstream
+ */
+class InputFileStream : public std::istream {
+ public:
+  /**
+   *  Constructor
+   */
+  InputFileStream();
+
+  /**
+   *  Destructor
+   */
+  ~InputFileStream() override;
+
+  /**
+   Open a file; set the failbit (and throw if requested by exceptions()) if
+   the file cannot be opened
+   @throw std::invalid\_argument if the file is compressed in an unsupported
+   format
+   */
+  void open(const std::string& filename);
+
+  /**
+   Close the file
+   */
+  void close();
+
+  /**
+   TRUE if the file is being decompressed
+   */
+  bool isCompressed() const { return gz_buf_ != nullptr; }
+
+ private:
+  std::filebuf file_buf_;
+  std::unique_ptr<GzipReaderBuf> gz_buf_;
+};
+}  // namespace cmaple
@@ -0,0 +1,59 @@
+#include "mappedfile.h"
+
+#include <fstream>
+#include <iterator>
+
+#if !defined(_WIN32) && !defined(WIN32)
+#define CMAPLE_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+cmaple::MappedFile::MappedFile(const std::string& filename) {
+#ifdef CMAPLE_USE_MMAP
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::ios_base::failure("Cannot open file " + filename);
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    throw std::ios_base::failure("Cannot read file " + filename);
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+
+  // mmap() does not accept empty mappings
+  if (size_) {
+    void* const mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::ios_base::failure("Cannot map file " + filename);
+    }
+    // the file is read sequentially (by each thread)
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(mapping);
+    mapped_ = true;
+  }
+  close(fd);
+#else
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    throw std::ios_base::failure("Cannot open file " + filename);
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+}
+
+cmaple::MappedFile::~MappedFile() {
+#ifdef CMAPLE_USE_MMAP
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+namespace cmaple {
+/** A read-only view of the whole content of a file. The file is
+ *  memory-mapped where mmap is available; otherwise (e.g., on Windows), it is
+ *  read into memory.
+ */
+class MappedFile {
+ public:
+  /**
+   *  Constructor
+   *  @param[in] filename Name of the file
+   *  @throw std::ios\_base::failure if the file cannot be opened or mapped
+   */
+  explicit MappedFile(const std::string& filename);
+
+  /**
+   *  Destructor
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   Get the content of the file
+   */
+  const char* data() const { return data_; }
+
+  /**
+   Get the size (in bytes) of the file
+   */
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+  /**
+   The content of the file if it could not be mapped
+   */
+  std::string buffer_;
+
+  /**
+   TRUE if data_ points to a mapping (to be unmapped)
+   */
+  bool mapped_ = false;
+};
+}  // namespace cmaple
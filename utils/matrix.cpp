@@ -0,0 +1,135 @@
+#include "matrix.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CMAPLE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+using namespace cmaple;
+
+namespace {
+
+// Generic version: one (SIMDe-vectorised) dot product per row
+void matVec20Generic(const double* mat, const double* vec, double* result) {
+  for (StateType i = 0; i < 20; ++i, mat += 20)
+    result[i] = dotProduct<20>(vec, mat);
+}
+
+#ifdef CMAPLE_X86_DISPATCH
+// Products of four rows with the vector (in 5 registers), reduced together
+// into one vector of four results
+__attribute__((target("avx2,fma"))) inline __m256d matVec4RowsAVX2(
+    const double* mat,
+    const __m256d* v) {
+  __m256d acc[4];
+  for (int r = 0; r < 4; ++r) {
+    const double* const row = mat + r * 20;
+    __m256d a = _mm256_mul_pd(_mm256_loadu_pd(row), v[0]);
+    a = _mm256_fmadd_pd(_mm256_loadu_pd(row + 4), v[1], a);
+    a = _mm256_fmadd_pd(_mm256_loadu_pd(row + 8), v[2], a);
+    a = _mm256_fmadd_pd(_mm256_loadu_pd(row + 12), v[3], a);
+    acc[r] = _mm256_fmadd_pd(_mm256_loadu_pd(row + 16), v[4], a);
+  }
+
+  // [r0 01, r1 01, r0 23, r1 23] and [r2 01, r3 01, r2 23, r3 23]
+  const __m256d h01 = _mm256_hadd_pd(acc[0], acc[1]);
+  const __m256d h23 = _mm256_hadd_pd(acc[2], acc[3]);
+  const __m256d low = _mm256_permute2f128_pd(h01, h23, 0x20);
+  const __m256d high = _mm256_permute2f128_pd(h01, h23, 0x31);
+  return _mm256_add_pd(low, high);
+}
+
+// AVX2 + FMA version: four rows at a time
+__attribute__((target("avx2,fma"))) void matVec20AVX2(const double* mat,
+                                                      const double* vec,
+                                                      double* result) {
+  const __m256d v[5] = {_mm256_loadu_pd(vec), _mm256_loadu_pd(vec + 4),
+                        _mm256_loadu_pd(vec + 8), _mm256_loadu_pd(vec + 12),
+                        _mm256_loadu_pd(vec + 16)};
+  for (StateType i = 0; i < 20; i += 4, mat += 80) {
+    _mm256_storeu_pd(result + i, matVec4RowsAVX2(mat, v));
+  }
+}
+
+// AVX-512 version: eight rows at a time (each covered by two full registers
+// and a masked one), reduced together by a transposition tree; the last four
+// rows use the AVX2 block
+__attribute__((target("avx512f,avx2,fma"))) void matVec20AVX512(
+    const double* mat,
+    const double* vec,
+    double* result) {
+  constexpr __mmask8 tail_mask = 0x0F;
+  const __m512d v0 = _mm512_loadu_pd(vec);
+  const __m512d v1 = _mm512_loadu_pd(vec + 8);
+  const __m512d v2 = _mm512_maskz_loadu_pd(tail_mask, vec + 16);
+
+  for (StateType i = 0; i < 16; i += 8, mat += 160) {
+    __m512d acc[8];
+    for (int r = 0; r < 8; ++r) {
+      const double* const row = mat + r * 20;
+      __m512d a = _mm512_mul_pd(_mm512_loadu_pd(row), v0);
+      a = _mm512_fmadd_pd(_mm512_loadu_pd(row + 8), v1, a);
+      acc[r] =
+          _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail_mask, row + 16), v2, a);
+    }
+
+    // pairs of rows: [r0 01, r1 01, r0 23, r1 23, ...]
+    __m512d pairs[4];
+    for (int r = 0; r < 4; ++r) {
+      pairs[r] = _mm512_add_pd(_mm512_unpacklo_pd(acc[2 * r], acc[2 * r + 1]),
+                               _mm512_unpackhi_pd(acc[2 * r], acc[2 * r + 1]));
+    }
+    // quads of rows: [r0 0-3, r1 0-3, r0 4-7, r1 4-7, r2 0-3, ...]
+    const __m512d quad0 = _mm512_add_pd(
+        _mm512_shuffle_f64x2(pairs[0], pairs[1], _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm512_shuffle_f64x2(pairs[0], pairs[1], _MM_SHUFFLE(3, 1, 3, 1)));
+    const __m512d quad1 = _mm512_add_pd(
+        _mm512_shuffle_f64x2(pairs[2], pairs[3], _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm512_shuffle_f64x2(pairs[2], pairs[3], _MM_SHUFFLE(3, 1, 3, 1)));
+    // all eight rows
+    _mm512_storeu_pd(
+        result + i,
+        _mm512_add_pd(
+            _mm512_shuffle_f64x2(quad0, quad1, _MM_SHUFFLE(2, 0, 2, 0)),
+            _mm512_shuffle_f64x2(quad0, quad1, _MM_SHUFFLE(3, 1, 3, 1))));
+  }
+
+  const __m256d v[5] = {_mm256_loadu_pd(vec), _mm256_loadu_pd(vec + 4),
+                        _mm256_loadu_pd(vec + 8), _mm256_loadu_pd(vec + 12),
+                        _mm256_loadu_pd(vec + 16)};
+  _mm256_storeu_pd(result + 16, matVec4RowsAVX2(mat, v));
+}
+#endif
+
+}  // namespace
+
+SIMDLevel detectSIMDLevel() {
+#ifdef CMAPLE_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SIMDLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SIMDLevel::AVX2_FMA;
+  }
+#endif
+  return SIMDLevel::GENERIC;
+}
+
+MatVec20Kernel getMatVec20Kernel(const SIMDLevel level) {
+#ifdef CMAPLE_X86_DISPATCH
+  switch (level) {
+    case SIMDLevel::AVX512:
+      return matVec20AVX512;
+    case SIMDLevel::AVX2_FMA:
+      return matVec20AVX2;
+    default:
+      break;
+  }
+#else
+  (void)level;
+#endif
+  return matVec20Generic;
+}
+
+const MatVec20Kernel matVec20 = getMatVec20Kernel(detectSIMDLevel());
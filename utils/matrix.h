@@ -31,11 +31,11 @@
 // let's include some x64 instrinsics from SIMDe; SIMDe will translate to Neon for ARM automatically
 #include <simde/x86/sse2.h>
 #include <simde/x86/sse4.1.h>
-#include <simde/x86/avx.h>
 
 #include "tools.h"
 
 #include <assert.h>
+#include <type_traits>
 #include <vector>
 
 // Multiply 4 floats by another 4 floats.
@@ -49,14 +49,14 @@ inline simde__m128 mul4(const float* p1, const float* p2)
   return simde_mm_mul_ps(a, b);
 }
 
-// Multiply 4 doubles by another 4 doubles.
+// Multiply 2 doubles by another 2 doubles.
 template<int offsetRegs>
-inline simde__m256d mul4(const double* p1, const double* p2)
+inline simde__m128d mul2(const double* p1, const double* p2)
 {
-  constexpr int lanes = offsetRegs * 4;
-  const simde__m256d a = simde_mm256_loadu_pd(p1 + lanes);
-  const simde__m256d b = simde_mm256_loadu_pd(p2 + lanes);
-  return simde_mm256_mul_pd(a, b);
+  constexpr int lanes = offsetRegs * 2;
+  const simde__m128d a = simde_mm_loadu_pd(p1 + lanes);
+  const simde__m128d b = simde_mm_loadu_pd(p2 + lanes);
+  return simde_mm_mul_pd(a, b);
 }
 
 // sum up 4 floats (SSE)
@@ -71,15 +71,10 @@ inline float horiz_sum(simde__m128 v) {
   return simde_mm_cvtss_f32(r1);
 }
 
-// sum up 4 doubles (AVX)
-// see https://stackoverflow.com/a/49943540
-inline double horiz_sum(simde__m256d v) {
-  simde__m128d vlow = simde_mm256_castpd256_pd128(v);
-  simde__m128d vhigh = simde_mm256_extractf128_pd(v, 1); // high 128
-  vlow = simde_mm_add_pd(vlow, vhigh);     // reduce down to 128
-
-  simde__m128d high64 = simde_mm_unpackhi_pd(vlow, vlow);
-  return  simde_mm_cvtsd_f64(simde_mm_add_sd(vlow, high64));  // reduce to scalar
+// sum up 2 doubles (SSE2)
+inline double horiz_sum(simde__m128d v) {
+  simde__m128d high64 = simde_mm_unpackhi_pd(v, v);
+  return  simde_mm_cvtsd_f64(simde_mm_add_sd(v, high64));  // reduce to scalar
 }
 
 
@@ -121,28 +116,90 @@ inline float dotProduct<20>(const float* p1, const float* p2)
 template <>
 inline double dotProduct<20>(const double* p1, const double* p2)
 {
-  // const int count = 20;
-  // const double* const p1End = p1 + count;
-
+  // The 20 values are processed as 5 groups of 4 doubles, each as a low and a
+  // high half of 2 doubles (SSE2). AVX is not enabled for this header (see
+  // CMakeLists.txt), and 256-bit vectors would only be emulated by SIMDe.
   // Process all 20 values. Nothing to add yet, just multiplying.
-  auto dot0 = mul4<0>(p1, p2);
-  auto dot1 = mul4<1>(p1, p2);
-  auto dot2 = mul4<2>(p1, p2);
-  auto dot3 = mul4<3>(p1, p2);
-  auto dot4 = mul4<4>(p1, p2);
+  const auto dot0_low = mul2<0>(p1, p2);
+  const auto dot0_high = mul2<1>(p1, p2);
+  const auto dot1_low = mul2<2>(p1, p2);
+  const auto dot1_high = mul2<3>(p1, p2);
+  const auto dot2_low = mul2<4>(p1, p2);
+  const auto dot2_high = mul2<5>(p1, p2);
+  const auto dot3_low = mul2<6>(p1, p2);
+  const auto dot3_high = mul2<7>(p1, p2);
+  const auto dot4_low = mul2<8>(p1, p2);
+  const auto dot4_high = mul2<9>(p1, p2);
 
   // 20 to 4
-  const auto dot01 = simde_mm256_add_pd(dot0, dot1);
-  const auto dot23 = simde_mm256_add_pd(dot2, dot3);
-  const auto dot401 = simde_mm256_add_pd(dot4, dot01);
-  const auto dot23401 = simde_mm256_add_pd(dot23, dot401);
+  const auto dot01_low = simde_mm_add_pd(dot0_low, dot1_low);
+  const auto dot01_high = simde_mm_add_pd(dot0_high, dot1_high);
+  const auto dot23_low = simde_mm_add_pd(dot2_low, dot3_low);
+  const auto dot23_high = simde_mm_add_pd(dot2_high, dot3_high);
+  const auto dot401_low = simde_mm_add_pd(dot4_low, dot01_low);
+  const auto dot401_high = simde_mm_add_pd(dot4_high, dot01_high);
+  const auto dot23401_low = simde_mm_add_pd(dot23_low, dot401_low);
+  const auto dot23401_high = simde_mm_add_pd(dot23_high, dot401_high);
+
+  // 4 to 2
+  return horiz_sum(simde_mm_add_pd(dot23401_low, dot23401_high));
+}
 
-  return horiz_sum(dot23401);
+// Compute dot product of vectors of different precisions (e.g. a single
+// precision likelihood vector and a double precision matrix row), summing up
+// in double precision
+template <cmaple::StateType length, typename RealType1, typename RealType2>
+inline cmaple::RealNumType dotProduct(const RealType1* p1, const RealType2* p2)
+{
+  cmaple::RealNumType result{ 0 };
+  for (cmaple::StateType j = 0; j < length; ++j)
+  {
+    result += static_cast<cmaple::RealNumType>(p1[j]) * p2[j];
+  }
+  return result;
+}
+
+
+// Instruction sets for which the kernels below have a dedicated version
+enum class SIMDLevel { GENERIC, AVX2_FMA, AVX512 };
+
+// Kernel computing result[i] = dot(mat[i * 20 .. i * 20 + 19], vec) for the
+// 20 rows of a row-major 20x20 matrix
+typedef void (*MatVec20Kernel)(const double* mat, const double* vec,
+                               double* result);
+
+// Detect the best instruction set supported by the running CPU
+SIMDLevel detectSIMDLevel();
+
+// Get the kernel for an instruction set (falls back to a lower level if the
+// requested one was not compiled in)
+MatVec20Kernel getMatVec20Kernel(SIMDLevel level);
+
+// Kernel for the running CPU, selected once at startup so that one binary
+// runs at full speed on SSE, AVX2 and AVX-512 hosts
+extern const MatVec20Kernel matVec20;
+
+// Compute result[i] = dot(row i of mat, vec) for a row-major length x length
+// matrix, using the dispatched kernel for 20 states in double precision
+template <cmaple::StateType length, typename LhType>
+inline void matrixVectorProduct(const cmaple::RealNumType* mat,
+                                const LhType* vec,
+                                cmaple::RealNumType* result)
+{
+  if constexpr (length == 20 && std::is_same_v<LhType, double>)
+  {
+    matVec20(mat, vec, result);
+  }
+  else
+  {
+    for (cmaple::StateType i = 0; i < length; ++i, mat += length)
+      result[i] = dotProduct<length>(vec, mat);
+  }
 }
 
 
-template <cmaple::StateType length>
-cmaple::RealNumType sumMutationByLh(const cmaple::RealNumType* const vec1, const cmaple::RealNumType* const vec2)
+template <cmaple::StateType length, typename LhType1, typename LhType2>
+cmaple::RealNumType sumMutationByLh(const LhType1* const vec1, const LhType2* const vec2)
 {
     cmaple::RealNumType result{0};
     for (cmaple::StateType j = 0; j < length; ++j)
@@ -152,19 +209,21 @@ cmaple::RealNumType sumMutationByLh(const cmaple::RealNumType* const vec1, const
 }
 
 
-template <cmaple::StateType length>
-cmaple::RealNumType matrixEvolve(const cmaple::RealNumType* const vec1,
-                                 const cmaple::RealNumType* const vec2,
+template <cmaple::StateType length, typename LhType1, typename LhType2>
+cmaple::RealNumType matrixEvolve(const LhType1* const vec1,
+                                 const LhType2* const vec2,
                                  const cmaple::RealNumType* mutation_mat_row,
                                  const cmaple::RealNumType total_blength)
 {
     cmaple::RealNumType result{ 0 };
-    for (cmaple::StateType i = 0; i < length; ++i, mutation_mat_row += length)
-  {
     // NHANLT NOTE:
     // tot2: likelihood of i evolves to j
     // tot2 = (1 + mut[i,i] * total_blength) * lh(seq2,i) + mut[i,j] * total_blength * lh(seq2,j)
-      cmaple::RealNumType tot2 = dotProduct<length>(mutation_mat_row, vec2);
+    cmaple::RealNumType tot2s[length];
+    matrixVectorProduct<length>(mutation_mat_row, vec2, tot2s);
+    for (cmaple::StateType i = 0; i < length; ++i)
+  {
+      const cmaple::RealNumType tot2 = tot2s[i];
 
     // NHANLT NOTE:
     // tot = the likelihood of observing i * the likelihood of i evolves to j
@@ -173,8 +232,8 @@ cmaple::RealNumType matrixEvolve(const cmaple::RealNumType* const vec1,
   return result;
 }
 
-template <cmaple::StateType length>
-cmaple::RealNumType matrixEvolveRoot(const cmaple::RealNumType* const vec2,
+template <cmaple::StateType length, typename LhType>
+cmaple::RealNumType matrixEvolveRoot(const LhType* const vec2,
                                      const cmaple::StateType seq1_state,
                                      const cmaple::RealNumType* model_root_freqs,
                                      const cmaple::RealNumType* transposed_mut_mat_row,
@@ -183,7 +242,9 @@ cmaple::RealNumType matrixEvolveRoot(const cmaple::RealNumType* const vec2,
                                      const cmaple::RealNumType seq1_region_plength_observation2node)
 {
     cmaple::RealNumType result{ 0 };
-    for (cmaple::StateType i = 0; i < length; ++i, mutation_mat_row += length)
+    cmaple::RealNumType tot3s[length];
+    matrixVectorProduct<length>(mutation_mat_row, vec2, tot3s);
+    for (cmaple::StateType i = 0; i < length; ++i)
   {
     // NHANLT NOTE: UNSURE
     // tot2: likelihood that we can observe seq1_state elvoving from i (from root)
@@ -201,43 +262,65 @@ cmaple::RealNumType matrixEvolveRoot(const cmaple::RealNumType* const vec2,
     // NHANLT NOTE:
     // tot3: likelihood of i evolves to j
     // tot3 = (1 + mut[i,i] * total_blength) * lh(seq2,i) + mut[i,j] * total_blength * lh(seq2,j)
-      cmaple::RealNumType tot3 = dotProduct<length>(mutation_mat_row, vec2);
+      const cmaple::RealNumType tot3 = tot3s[i];
     result += tot2 * (vec2[i] + total_blength * tot3);
   }
   return result;
 }
 
-template <cmaple::StateType length>
-cmaple::RealNumType updateVecWithState(cmaple::RealNumType* const update_vec, const cmaple::StateType seq1_state,
-                               const cmaple::RealNumType* const vec,
+/**
+    Treat an unnormalized likelihood vector whose sum fell below the carry-over
+    of its entry type as underflowed. Single-precision entries (-sp build)
+    become denormal long before the double sum reaches zero, so normalizing
+    them would yield an inaccurate vector; instead they are zeroed and 0 is
+    returned, the same as when the double build underflows. No-op for double.
+    @return sum_lh, or 0 if the vector underflowed
+ */
+template <cmaple::StateType length, typename LhType>
+cmaple::RealNumType checkLhUnderflow(LhType* const vec,
+                                     const cmaple::RealNumType sum_lh)
+{
+  if (std::is_same<LhType, float>::value &&
+      sum_lh < cmaple::getMinCarryOver<float>())
+  {
+    for (cmaple::StateType i = 0; i < length; ++i)
+      vec[i] = 0;
+    return 0;
+  }
+  return sum_lh;
+}
+
+template <cmaple::StateType length, typename LhType, typename RealType>
+cmaple::RealNumType updateVecWithState(LhType* const update_vec, const cmaple::StateType seq1_state,
+                               const RealType* const vec,
                                const cmaple::RealNumType factor)
 {
     cmaple::RealNumType result{0};
     for (cmaple::StateType i = 0; i < length; ++i)
   {
     if (i == seq1_state)
-      update_vec[i] *= (1.0 + vec[i] * factor);
+      update_vec[i] = static_cast<LhType>(update_vec[i] * (1.0 + vec[i] * factor));
     else
-      update_vec[i] *= vec[i] * factor;
+      update_vec[i] = static_cast<LhType>(update_vec[i] * (vec[i] * factor));
     result += update_vec[i];
   }
-  return result;
+  return checkLhUnderflow<length>(update_vec, result);
 }
 
-template <cmaple::StateType length>
-void setVecWithState(cmaple::RealNumType* const set_vec, const cmaple::StateType seq1_state,
-  const cmaple::RealNumType* const vec,
+template <cmaple::StateType length, typename LhType, typename RealType>
+void setVecWithState(LhType* const set_vec, const cmaple::StateType seq1_state,
+  const RealType* const vec,
   const cmaple::RealNumType factor)
 {
   for (cmaple::StateType i = 0; i < length; ++i)
-    set_vec[i] = vec[i] * factor;
+    set_vec[i] = static_cast<LhType>(vec[i] * factor);
 
-    set_vec[seq1_state] += 1.0;
+    set_vec[seq1_state] += 1;
 }
 
-template <cmaple::StateType length>
+template <cmaple::StateType length, typename LhType>
 void updateCoeffs(cmaple::RealNumType* const root_freqs,
-        cmaple::RealNumType* const transposed_mut_mat_row, cmaple::RealNumType* const likelihood,
+        cmaple::RealNumType* const transposed_mut_mat_row, LhType* const likelihood,
         cmaple::RealNumType* const mutation_mat_row, const cmaple::RealNumType factor,
         cmaple::RealNumType& coeff0, cmaple::RealNumType& coeff1)
 {
@@ -248,29 +331,30 @@ void updateCoeffs(cmaple::RealNumType* const root_freqs,
     }
 }
 
-template <cmaple::StateType length>
-void setVecByProduct(cmaple::RealNumType* const set_vec,
-    const cmaple::RealNumType* const vec1, const cmaple::RealNumType* const vec2)
+template <cmaple::StateType length, typename LhType, typename LhType1,
+          typename LhType2>
+void setVecByProduct(LhType* const set_vec,
+    const LhType1* const vec1, const LhType2* const vec2)
 {
     for (cmaple::StateType j = 0; j < length; ++j)
-        set_vec[j] = vec1[j] * vec2[j];
+        set_vec[j] = static_cast<LhType>(vec1[j] * vec2[j]);
 }
 
 /* NHANLT: I'm not sure if there is an AVX instruction to reset all entries of a vector to zero */
-template <cmaple::StateType length>
-void resetVec(cmaple::RealNumType* const set_vec)
+template <cmaple::StateType length, typename LhType>
+void resetVec(LhType* const set_vec)
 {
     for (cmaple::StateType i = 0; i < length; ++i)
         set_vec[i] = 0;
 }
 
-template <cmaple::StateType length>
-cmaple::RealNumType resetLhVecExceptState(cmaple::RealNumType* const set_vec,
+template <cmaple::StateType length, typename LhType>
+cmaple::RealNumType resetLhVecExceptState(LhType* const set_vec,
         const cmaple::StateType state, const cmaple::RealNumType state_lh)
 {
     resetVec<length>(set_vec);
     
-    set_vec[state] = state_lh;
+    set_vec[state] = static_cast<LhType>(state_lh);
     
     return state_lh;
 }
@@ -0,0 +1,34 @@
+#include "outputstream.h"
+
+#include <zlib.h>
+
+#include <ios>
+
+void cmaple::appendGzipMember(const char* const data,
+                              const size_t size,
+                              std::string& out) {
+  z_stream stream{};
+  // 16 + 15: a gzip wrapper with the default (32 KiB) window
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::ios_base::failure("Cannot initialize the gzip compression");
+  }
+
+  const size_t start = out.size();
+  out.resize(start + deflateBound(&stream, static_cast<uLong>(size)));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out = reinterpret_cast<Bytef*>(&out[start]);
+  stream.avail_out = static_cast<uInt>(out.size() - start);
+  const int status = deflate(&stream, Z_FINISH);
+  out.resize(start + stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    throw std::ios_base::failure("Failed to compress the output");
+  }
+}
+
+bool cmaple::isGzipFilename(const std::string& filename) {
+  return filename.size() > 3 &&
+         filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
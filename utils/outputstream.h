@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+namespace cmaple {
+/**
+ Compress a block of data into a complete gzip member, appended to out.
+ Concatenated members form a valid gzip file, so that blocks can be
+ compressed independently (e.g. in parallel) and written in order
+ @param[in] data The data to compress
+ @param[in] size The number of bytes of data
+ @param[in,out] out The string to append the gzip member to
+ @throw std::ios\_base::failure if the data cannot be compressed
+ */
+void appendGzipMember(const char* data, size_t size, std::string& out);
+
+/**
+ TRUE if a filename ends with ".gz" (i.e., the output should be compressed)
+ */
+bool isGzipFilename(const std::string& filename);
+}  // namespace cmaple
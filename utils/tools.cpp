@@ -561,6 +561,12 @@ cmaple::Params::Params() {
   overwrite_output = false;
   threshold_prob = 1e-8;
   mutation_update_period = 25;
+  placement_window = 1;
+  placement_index = false;
+  spr_window = 1;
+  checkpoint_file = "";
+  checkpoint_interval = 0;
+  resume = false;
   failure_limit_sample = 5;
   failure_limit_subtree = 4;
   failure_limit_subtree_short_search = 1;
@@ -778,7 +784,7 @@ void cmaple::parseArg(int argc, char* argv[], Params& params) {
           if (cnt >= argc || argv[cnt][0] == '-') {
             outError(
                 "Use -out-format <ALN_FORMAT>. Note <ALN_FORMAT> "
-                "could be MAPLE, PHYLIP, or FASTA");
+                "could be MAPLE, PHYLIP, FASTA, or BINARY");
           }
 
           // parse inputs
@@ -824,7 +830,7 @@ void cmaple::parseArg(int argc, char* argv[], Params& params) {
           strcmp(argv[cnt], "--aln-format") == 0) {
         cnt++;
         if (cnt >= argc) {
-          outError("Use -format MAPLE, PHYLIP, FASTA, or AUTO");
+          outError("Use -format MAPLE, PHYLIP, FASTA, BINARY, or AUTO");
         }
         params.aln_format_str = argv[cnt];
 
@@ -1003,6 +1009,85 @@ void cmaple::parseArg(int argc, char* argv[], Params& params) {
 
         continue;
       }
+      if (strcmp(argv[cnt], "--placement-window") == 0 ||
+          strcmp(argv[cnt], "-place-win") == 0) {
+        ++cnt;
+        if (cnt >= argc || argv[cnt][0] == '-') {
+          outError("Use -place-win <NUMBER>");
+        }
+
+        try {
+          params.placement_window = convert_int(argv[cnt]);
+        } catch (std::invalid_argument e) {
+          outError(e.what());
+        }
+
+        if (params.placement_window <= 0) {
+          outError("<NUMBER> must be positive!");
+        }
+
+        continue;
+      }
+      if (strcmp(argv[cnt], "--placement-index") == 0 ||
+          strcmp(argv[cnt], "-place-idx") == 0) {
+        params.placement_index = true;
+        continue;
+      }
+      if (strcmp(argv[cnt], "--spr-window") == 0 ||
+          strcmp(argv[cnt], "-spr-win") == 0) {
+        ++cnt;
+        if (cnt >= argc || argv[cnt][0] == '-') {
+          outError("Use -spr-win <NUMBER>");
+        }
+
+        try {
+          params.spr_window = convert_int(argv[cnt]);
+        } catch (std::invalid_argument e) {
+          outError(e.what());
+        }
+
+        if (params.spr_window <= 0) {
+          outError("<NUMBER> must be positive!");
+        }
+
+        continue;
+      }
+      if (strcmp(argv[cnt], "--checkpoint") == 0 ||
+          strcmp(argv[cnt], "-ckp") == 0) {
+        ++cnt;
+        if (cnt >= argc || argv[cnt][0] == '-') {
+          outError("Use -ckp <FILE>");
+        }
+
+        params.checkpoint_file = argv[cnt];
+
+        continue;
+      }
+      if (strcmp(argv[cnt], "--checkpoint-interval") == 0 ||
+          strcmp(argv[cnt], "-ckp-interval") == 0) {
+        ++cnt;
+        if (cnt >= argc || argv[cnt][0] == '-') {
+          outError("Use -ckp-interval <SECONDS>");
+        }
+
+        try {
+          params.checkpoint_interval = convert_real_number(argv[cnt]);
+        } catch (std::invalid_argument e) {
+          outError(e.what());
+        }
+
+        if (params.checkpoint_interval < 0) {
+          outError("<SECONDS> must be non-negative!");
+        }
+
+        continue;
+      }
+      if (strcmp(argv[cnt], "--resume") == 0 ||
+          strcmp(argv[cnt], "-resume") == 0) {
+        params.resume = true;
+
+        continue;
+      }
       if (strcmp(argv[cnt], "--failure-limit") == 0 ||
           strcmp(argv[cnt], "-fail-limit") == 0) {
         ++cnt;
@@ -1218,10 +1303,12 @@ void cmaple::usage_cmaple() {
       << "  -aln <ALIGNMENT>     Specify an input alignment file in PHYLIP, "
          "FASTA,"
       << endl
-      << "                       or MAPLE format." << endl
+      << "                       MAPLE, or BINARY format (gzipped or not)."
+      << endl
       << "  -m <MODEL>           Specify a model name." << endl
       << "  -st <SEQ_TYPE>       Specify a sequence type (DNA/AA)." << endl
-      << "  -format <FORMAT>     Set the alignment format (PHYLIP/FASTA/MAPLE)."
+      << "  -format <FORMAT>     Set the alignment format "
+         "(PHYLIP/FASTA/MAPLE/BINARY)."
       << endl
       << "  -t <TREE_FILE>       Specify a starting tree for tree search."
       << endl
@@ -1238,7 +1325,10 @@ void cmaple::usage_cmaple() {
       << "                       branch supports (aLRT-SH)." << endl
       << "  -nt <NUM_THREADS>    Set the number of threads for computing"
       << endl
-      << "                       branch supports. Use `-nt AUTO` " << endl
+      << "                       branch supports, placements and SPR moves"
+      << endl
+      << "                       (see -place-win, -spr-win). Use `-nt AUTO` "
+      << endl
       << "                       to employ all available CPU cores." << endl
       << "  -pre <PREFIX>        Specify a prefix for all output files." << endl
       << "  -rep-tree            Allow CMAPLE to replace the input tree" << endl
@@ -1248,8 +1338,13 @@ void cmaple::usage_cmaple() {
       << "  -overwrite           Overwrite output files if existing." << endl
       << "  -ref <FILE>,<SEQ>    Specify the reference genome." << endl
       << "  -out-aln <FILE>      Write the input alignment to a file in " << endl
-      << "                       MAPLE (default), PHYLIP, or FASTA format." << endl
-      << "  -out-format <FORMAT> Specify the format (MAPLE/PHYLIP/FASTA) " << endl
+      << "                       MAPLE (default), PHYLIP, FASTA, or BINARY"
+      << endl
+      << "                       (compact, faster to load) format." << endl
+      << "                       Compressed with gzip if <FILE> ends with .gz."
+      << endl
+      << "  -out-format <FORMAT> Specify the format (MAPLE/PHYLIP/FASTA/BINARY)"
+      << endl
       << "                       to output the alignment with `-out-aln`." << endl
       << "  -min-bl <NUM>        Set the minimum branch length." << endl
       << "  -thresh-prob <NUM>   Specify a parameter for approximations."
@@ -1257,6 +1352,43 @@ void cmaple::usage_cmaple() {
       << "  -mut-update <NUM>    Set the period to update the substitution "
          "rates."
       << endl
+      << "  -place-win <NUM>     Set the number of samples whose placements"
+      << endl
+      << "                       are searched in parallel. Samples whose"
+      << endl
+      << "                       search read a node updated by an earlier"
+      << endl
+      << "                       placement of the window are searched again"
+      << endl
+      << "                       sequentially, which limits the speedup to"
+      << endl
+      << "                       about 2x. Default: 1." << endl
+      << "  -place-idx           Start the search for the placement of each"
+      << endl
+      << "                       sample at the clade proposed by an index of"
+      << endl
+      << "                       the mutations defining the clades of the tree."
+      << endl
+      << "  -spr-win <NUM>       Set the number of subtrees whose SPR moves"
+      << endl
+      << "                       are searched in parallel. Samples whose"
+      << endl
+      << "                       search read a node updated by an earlier"
+      << endl
+      << "                       placement of the window are searched again"
+      << endl
+      << "                       sequentially, which limits the speedup to"
+      << endl
+      << "                       about 2x. Default: 1." << endl
+      << "  -ckp <FILE>          Save checkpoints of the inference to a file."
+      << endl
+      << "  -ckp-interval <NUM>  Also save a checkpoint every <NUM> seconds"
+      << endl
+      << "                       during the placement and the tree search."
+      << endl
+      << "  -resume              Resume the inference from the checkpoint file"
+      << endl
+      << "                       (specified by -ckp), if existing." << endl
       << "  -max-subs <NUM>      Specify the maximum #substitutions per site" << endl
       << "                       that CMAPLE is effective. Default: 0.067."
       << endl
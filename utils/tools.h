@@ -515,6 +515,53 @@ class Params {
    */
   PositionType mutation_update_period;
 
+  /**
+   * The number of samples whose placements are searched concurrently against
+   * the same tree before being committed one by one. A sample is re-searched
+   * (sequentially) at commit time if the root changed or an earlier placement
+   * in the same window updated any node read by its search, so that the tree
+   * is the same as with sequential placement. As most placements update the
+   * nodes near the root, which most searches read, many samples are
+   * re-searched (about half of them on a 5K-sample dataset with a window of
+   * 8), which bounds the speedup to about 2x. Default: 1 (i.e., strictly
+   * sequential placement)
+   */
+  PositionType placement_window;
+
+  /**
+   * TRUE to start the search for the placement of each sample at the clade
+   * proposed by an inverted index from the defining mutations of the clades
+   * of the tree (falling back to the root if the index is inconclusive)
+   * instead of always at the root. Default: FALSE
+   */
+  bool placement_index;
+
+  /**
+   * The number of subtrees for which SPR moves are searched concurrently
+   * against the same tree before being applied one by one. A move is searched
+   * again if an earlier move in the same window updated any node read by its
+   * search. Default: 1 (i.e., strictly sequential tree search)
+   */
+  PositionType spr_window;
+
+  /**
+   * Path to a checkpoint file. If specified, the state of the tree is saved
+   * to this file after each phase of the inference (and periodically, see
+   * checkpoint_interval). Default: "" (no checkpoint)
+   */
+  std::string checkpoint_file;
+
+  /**
+   * The period (in seconds) to save a checkpoint during the placement and the
+   * tree search. Default: 0 (only at the end of each phase)
+   */
+  RealNumType checkpoint_interval;
+
+  /**
+   * TRUE to resume the inference from the checkpoint file (if existing)
+   */
+  bool resume;
+
   /**
   *  Name of the output alignment
   */
@@ -967,7 +1014,8 @@ void normalize_frequencies_from_index(RealNumType* freqs,
     @param num_entries the number of entries
     @param sum_entries Precomputed sum of all original state frequencies
  */
-inline void normalize_arr(RealNumType* const entries,
+template <typename RealType>
+inline void normalize_arr(RealType* const entries,
                           const int num_entries,
                           RealNumType sum_entries) {
   assert(num_entries > 0);
@@ -979,7 +1027,7 @@ inline void normalize_arr(RealNumType* const entries,
 
   sum_entries = 1.0 / sum_entries;
   for (int i = 0; i < num_entries; ++i)
-    entries[i] *= sum_entries;
+    entries[i] = static_cast<RealType>(entries[i] * sum_entries);
     // entries[i] /= sum_entries;
 }
 
@@ -988,7 +1036,8 @@ inline void normalize_arr(RealNumType* const entries,
     @param entries original entries
     @param num_entries the number of entries
  */
-inline void normalize_arr(RealNumType* const entries, const int num_entries) {
+template <typename RealType>
+inline void normalize_arr(RealType* const entries, const int num_entries) {
   RealNumType sum_entries = 0;
   for (int i = 0; i < num_entries; ++i)
     sum_entries += entries[i];